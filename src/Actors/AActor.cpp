@@ -31,7 +31,7 @@ AActor::AActor(const std::string& name, const std::weak_ptr<ACamera> currentCame
 }
 
 
-std::vector<float> AActor::GetVertices() const
+ArrayView<float> AActor::GetVertices() const
 {
 	if (!meshComponent)
 	{
@@ -156,16 +156,27 @@ void AActor::SetWorldRotation(const glm::mat4& worldRotationMatrix)
 
 }
 
-void AActor::SetupMeshComponent(EShaderOption e_shaderOption, const std::vector<float>& model_vertices,
-                                const std::vector<float>& model_normals, const std::vector<unsigned int>& model_indices, const std::vector<float>& model_colors)
+void AActor::SetupMeshComponent(EShaderOption e_shaderOption, SharedMeshData meshData)
 {
 	//Create mesh and attach mesh component
-	meshComponent = std::make_shared<UMeshComponent>(model_vertices, model_normals, model_indices, model_colors, shared_from_this());
+	meshComponent = std::make_shared<UMeshComponent>(std::move(meshData), shared_from_this());
 
 	meshComponent->Init(e_shaderOption);
 
 }
 
+void AActor::SetupMeshComponent(EShaderOption e_shaderOption, std::vector<float> model_vertices,
+                                std::vector<float> model_normals, std::vector<unsigned int> model_indices, std::vector<float> model_colors)
+{
+	std::shared_ptr<MeshData> meshData = std::make_shared<MeshData>();
+	meshData->vertices = std::move(model_vertices);
+	meshData->normals = std::move(model_normals);
+	meshData->indices = std::move(model_indices);
+	meshData->colors = std::move(model_colors);
+
+	SetupMeshComponent(e_shaderOption, std::move(meshData));
+}
+
 void AActor::SetupSDFComponent()
 {
 	sdfComponent = std::make_shared<USDFComponent>(shared_from_this());
@@ -7,6 +7,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "Helpers/MeshData.h"
+
 class USDFComponent;
 enum class EShaderOption;
 class Shader;
@@ -31,7 +33,7 @@ public:
 	const glm::vec3 GetWorldPosition() const { return m_worldPosition; }
 	const glm::vec3 GetWorldScale() const { return m_worldScale; }
 
-	std::vector<float> GetVertices() const;
+	ArrayView<float> GetVertices() const;
 	glm::mat4 GetModelMatrix() const;
 
 	//COMPONENT GETTERS
@@ -39,7 +41,9 @@ public:
 	std::weak_ptr<UMeshComponent> GetMeshComponent(); 
 
 	//Creates and sets shaders, and buffers for mesh component
-	void SetupMeshComponent(EShaderOption e_shaderOption, const std::vector<float>& model_vertices, const std::vector<float>& model_normals, const std::vector<unsigned int>& model_indices, const std::vector<float>& model_colors = std::vector<float>{});
+	void SetupMeshComponent(EShaderOption e_shaderOption, SharedMeshData meshData);
+	//Moves the arrays into a new mesh, pass them with std::move to avoid copying
+	void SetupMeshComponent(EShaderOption e_shaderOption, std::vector<float> model_vertices, std::vector<float> model_normals, std::vector<unsigned int> model_indices, std::vector<float> model_colors = std::vector<float>{});
 	//Add the SDF component 
 	void SetupSDFComponent();
 
@@ -5,12 +5,16 @@
 #include "app.h"
 
 #include <iostream>
+#include <unordered_map>
 #include <glad/glad.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "../Helpers/Shader.h"
 #include "Actors/ACamera.h"
+#include "Helpers/BackgroundMesher.h"
 #include "Helpers/DualContouring.h"
+#include "Helpers/ChunkResidencyCache.h"
+#include "Helpers/TerrainChunkManager.h"
 
 
 //IMGUI INCLUDES
@@ -22,7 +26,9 @@
 #include "Helpers/imgui/imgui.h"
 #include "Helpers/imgui/imgui_impl_glfw.h"
 #include "Helpers/imgui/imgui_impl_opengl3.h"
+#include "Helpers/Math/QEFSolver.h"
 #include "Helpers/SDFs/BoxSDF.h"
+#include "Helpers/SDFs/CSGNode.h"
 #include "Helpers/SDFs/SphereSDF.h"
 
 App::App(int windowWidth, int windowHeight)
@@ -113,13 +119,25 @@ void App::init()
 		terrainSDFComponent.lock()->AddSDF<SphereSDF>(glm::vec3(0.0f, -0.4f, 1.74f), 2.78f);
 	}
 
-	// Setup dual contouring grid
-	std::vector<float> terrainVertices, terrainNormals, terrainDebugColors;
-	std::vector<unsigned int> terrainIndices;
-
-	const int gridSize = 15;
-
-	DualContouring dualContouring(gridSize, gridSize, gridSize, 0.25f);
+	// Setup the terrain chunks
+	//Actor drawing each chunk's mesh, a chunk's mesh is replaced at the start of a frame once the background mesher finished a newer one
+	std::unordered_map<ChunkKey, std::shared_ptr<AActor>, ChunkKeyHash> terrainChunkActors;
+
+	//3 LOD levels of 12 voxel chunks around the camera, the finest one covers an 18 units cube with 0.25 unit voxels
+	const int chunkVoxelCount = 12;
+	const float voxelSize = 0.25f;
+	const int lodLevelCount = 3;
+	const int ringChunkCount = 1;
+
+	TerrainChunkManager terrainChunks(chunkVoxelCount, voxelSize, glm::vec3(0.f), lodLevelCount, ringChunkCount);
+	//Chunk the clipmap was last centred on, it is re-centred once the camera leaves it
+	glm::ivec3 terrainViewChunk = terrainChunks.GetChunkCoord(m_currentCamera->GetCameraWorldPosition(), 0);
+	terrainChunks.SetViewCenter(m_currentCamera->GetCameraWorldPosition());
+	//Chunk the camera was predicted to reach when the last prefetch was requested, and its position last frame
+	glm::ivec3 terrainPrefetchChunk = terrainViewChunk;
+	glm::vec3 lastCameraPosition = m_currentCamera->GetCameraWorldPosition();
+	//Owns the only task that touches the chunks after this point, declared after them so it is finished first
+	BackgroundMesher backgroundMesher(terrainChunks, terrainSDFComponent);
 
 	//Create the user-brush depth plane
 	m_userBrushDepthPlane = std::make_shared<AActor>("User-brush Depth Plane", m_currentCamera, m_currentCamera->GetCameraWorldPosition(), glm::vec3(6.0), glm::vec3(90, 0, 0));
@@ -149,7 +167,7 @@ void App::init()
 			1, 3, 2
 		};
 
-		m_userBrushDepthPlane->SetupMeshComponent(EShaderOption::unlit, planeVertices, planeNormals, planeIndices);
+		m_userBrushDepthPlane->SetupMeshComponent(EShaderOption::unlit, std::move(planeVertices), std::move(planeNormals), std::move(planeIndices));
 		m_userBrushDepthPlane->GetMeshComponent().lock()->SetObjectColor(glm::vec4(1.0f, 1.0f, 1.0f, 0.3f));
 	}
 
@@ -171,7 +189,7 @@ void App::init()
 
 		SphereBrush::GenerateSphereMesh(vertices, normals, indices, sphereBrushRadius);
 
-		userBrushSphere->SetupMeshComponent(EShaderOption::lit, vertices, normals, indices);
+		userBrushSphere->SetupMeshComponent(EShaderOption::lit, std::move(vertices), std::move(normals), std::move(indices));
 		userBrushSphere->GetMeshComponent().lock()->SetObjectColor(glm::vec3(0.5f, 0.5f, 1.0f));
 	}
 
@@ -214,6 +232,34 @@ void App::init()
 					terrainSDFComponent.lock()->SetShouldRegenerateMesh(true);
 				}
 				//ImGui::Checkbox("Enable SDF Mesh Rendering", &settings.bViewMesh);
+
+				//0 uses all hardware threads
+				ImGui::SliderInt("Meshing Threads", &settings.meshingThreadCount, 0, 32);
+				ImGui::Checkbox("Incremental Remesh", &settings.bUseIncrementalRemesh);
+
+				//Changing the octree settings regenerates the mesh
+				bool bOctreeSettingsChanged = ImGui::Checkbox("Octree Simplification", &settings.bUseOctreeSimplification);
+				if (settings.bUseOctreeSimplification)
+					bOctreeSettingsChanged |= ImGui::InputFloat("Octree Error Tolerance", &settings.octreeErrorTolerance, 0.0005f, 0.01f, "%.4f");
+
+				if (bOctreeSettingsChanged && !terrainSDFComponent.expired())
+					terrainSDFComponent.lock()->SetShouldRegenerateMesh(true);
+
+				//Solver fallbacks of the last meshing pass, summed over its chunks
+				const QEFSolverStats qefStats = QEFSolver::GetStats();
+				ImGui::Text("QEF Truncated Solves: %u", qefStats.truncatedSolves);
+				ImGui::Text("QEF Mass Point Fallbacks: %u", qefStats.massPointFallbacks);
+
+				//Chunk lattices kept outside the clipmap and how often the camera had to wait for one
+				ImGui::SliderInt("Chunk Cache Budget (MB)", &settings.chunkCacheBudgetMB, 16, 4096);
+				ImGui::SliderFloat("Chunk Prefetch Lookahead (s)", &settings.chunkPrefetchSeconds, 0.f, 5.f);
+				ImGui::SliderInt("Chunk Prefetch Limit", &settings.chunkPrefetchLimit, 0, 512);
+				const ChunkResidencyStats residencyStats = terrainChunks.GetResidencyStats();
+				ImGui::Text("Chunk Cache: %zu in memory (%.1f MB), %zu on disk", residencyStats.residentChunks, residencyStats.residentBytes / (1024.0 * 1024.0), residencyStats.diskChunks);
+				ImGui::Text("Chunk Hits: %llu memory, %llu disk, %llu misses", static_cast<unsigned long long>(residencyStats.memoryHits),
+					static_cast<unsigned long long>(residencyStats.diskHits), static_cast<unsigned long long>(residencyStats.misses));
+				ImGui::Text("Chunk Evictions: %llu, Prefetches: %llu", static_cast<unsigned long long>(residencyStats.evictions), static_cast<unsigned long long>(residencyStats.prefetches));
+				ImGui::Text("Chunk Stalls: %llu (%.1f ms)", static_cast<unsigned long long>(residencyStats.stalledChunks), residencyStats.stallMilliseconds);
 			}
 
 
@@ -224,9 +270,10 @@ void App::init()
 				{
 					bool bSDFChanged = false;
 
-					std::vector<std::shared_ptr<ISignedDistanceField>> sdfList = terrainSDFComponent.lock()->GetSDFList();
+					const std::shared_ptr<USDFComponent> sdfComponent = terrainSDFComponent.lock();
 
 					//Lambda function that returns an Input::Float and sets the sdf changed flag if any change occurs
+					//The background mesher meshes a snapshot of the SDF, so the primitives are edited in place
 					auto SDFInputVector3WithCallback = [](const char* label, float* v, float v_step, float v_speedStep, const char* format, bool& bSDFChanged)
 						{
 							float original_value = *v;
@@ -242,59 +289,80 @@ void App::init()
 							return false;
 						};
 
-					for(size_t sdfIndex = 0; sdfIndex < sdfList.size(); ++sdfIndex)
+					//Primitives are edited in place in their per-type arrays, ids keep the ImGui labels unique
+					for (size_t boxIndex = 0; boxIndex < sdfComponent->GetBoxes().Size(); ++boxIndex)
 					{
-						const std::shared_ptr<ISignedDistanceField> sdfElement = sdfList[sdfIndex];
+						BoxSDF* boxSDF = &sdfComponent->GetBoxes()[boxIndex];
+						const uint32_t sdfId = sdfComponent->GetBoxes().GetId(boxIndex);
 
-						switch (sdfElement->GetType())
-						{
-							case SDFType::Box:
-							{
-								ImGui::Text("Box Center:");
-								ImGui::Spacing();
+						ImGui::Text("Box Center:");
+						ImGui::Spacing();
+
+						//IMPORTANT: The complement strings are something needed for ImGUI to have UNIQUE IDs for components as I create them in a for loop
+						std::string centerComplement = "##center" + std::to_string(sdfId);
+						SDFInputVector3WithCallback(("X"+centerComplement).c_str(), &boxSDF->center.x, 0.01f, 1.0f, "%.3f", bSDFChanged);
+						SDFInputVector3WithCallback(("Y" + centerComplement).c_str(), &boxSDF->center.y, 0.01f, 1.0f, "%.3f", bSDFChanged);
+						SDFInputVector3WithCallback(("Z" + centerComplement).c_str(), &boxSDF->center.z, 0.01f, 1.0f, "%.3f", bSDFChanged);
 
-								std::shared_ptr<BoxSDF> boxSDF = std::dynamic_pointer_cast<BoxSDF>(sdfElement);
+						ImGui::Text("Half-Extents:");
+						ImGui::Spacing();
 
-								//IMPORTANT: The complement strings are something needed for ImGUI to have UNIQUE IDs for components as I create them in a for loop
-								std::string centerComplement = "##center" + std::to_string(sdfIndex);
-;								SDFInputVector3WithCallback(("X"+centerComplement).c_str(), &boxSDF->center.x, 0.01f, 1.0f, "%.3f", bSDFChanged);
-								SDFInputVector3WithCallback(("Y" + centerComplement).c_str(), &boxSDF->center.y, 0.01f, 1.0f, "%.3f", bSDFChanged);
-								SDFInputVector3WithCallback(("Z" + centerComplement).c_str(), &boxSDF->center.z, 0.01f, 1.0f, "%.3f", bSDFChanged);
+						std::string halfExtentComplement = "##halfExtent" + std::to_string(sdfId);
+						SDFInputVector3WithCallback(("X" + halfExtentComplement).c_str(), &boxSDF->halfExtents.x, 0.01f, 1.0f, "%.3f", bSDFChanged);
+						SDFInputVector3WithCallback(("Y" + halfExtentComplement).c_str(), &boxSDF->halfExtents.y, 0.01f, 1.0f, "%.3f", bSDFChanged);
+						SDFInputVector3WithCallback(("Z" + halfExtentComplement).c_str(), &boxSDF->halfExtents.z, 0.01f, 1.0f, "%.3f", bSDFChanged);
+					}
 
-								ImGui::Text("Half-Extents:");
-								ImGui::Spacing();
+					for (size_t sphereIndex = 0; sphereIndex < sdfComponent->GetSpheres().Size(); ++sphereIndex)
+					{
+						SphereSDF* sphereSDF = &sdfComponent->GetSpheres()[sphereIndex];
+						const uint32_t sdfId = sdfComponent->GetSpheres().GetId(sphereIndex);
 
-								std::string halfExtentComplement = "##halfExtent" + std::to_string(sdfIndex);
-								SDFInputVector3WithCallback(("X" + halfExtentComplement).c_str(), &boxSDF->halfExtents.x, 0.01f, 1.0f, "%.3f", bSDFChanged);
-								SDFInputVector3WithCallback(("Y" + halfExtentComplement).c_str(), &boxSDF->halfExtents.y, 0.01f, 1.0f, "%.3f", bSDFChanged);
-								SDFInputVector3WithCallback(("Z" + halfExtentComplement).c_str(), &boxSDF->halfExtents.z, 0.01f, 1.0f, "%.3f", bSDFChanged);
+						ImGui::Text("Sphere Center");
+						ImGui::Spacing();
 
-								break;
-							}
-							case SDFType::Sphere:
-							{
-								ImGui::Text("Sphere Center");
-								ImGui::Spacing();
+						std::string centerComplement = "##s_center" + std::to_string(sdfId);
+						SDFInputVector3WithCallback(("X" + centerComplement).c_str(), &sphereSDF->center.x, 0.01f, 1.0f, "%.3f", bSDFChanged);
+						SDFInputVector3WithCallback(("Y" + centerComplement).c_str(), &sphereSDF->center.y, 0.01f, 1.0f, "%.3f", bSDFChanged);
+						SDFInputVector3WithCallback(("Z" + centerComplement).c_str(), &sphereSDF->center.z, 0.01f, 1.0f, "%.3f", bSDFChanged);
 
-								std::shared_ptr<SphereSDF> sphereSDF = std::dynamic_pointer_cast<SphereSDF>(sdfElement);
-								std::string centerComplement = "##s_center" + std::to_string(sdfIndex);								SDFInputVector3WithCallback(("X" + centerComplement).c_str(), &sphereSDF->center.x, 0.01f, 1.0f, "%.3f", bSDFChanged);
-								SDFInputVector3WithCallback(("Y" + centerComplement).c_str(), &sphereSDF->center.y, 0.01f, 1.0f, "%.3f", bSDFChanged);
-								SDFInputVector3WithCallback(("Z" + centerComplement).c_str(), &sphereSDF->center.z, 0.01f, 1.0f, "%.3f", bSDFChanged);
+						ImGui::Spacing();
+						SDFInputVector3WithCallback(("Sphere Radius##s_radius" + std::to_string(sdfId)).c_str(), &sphereSDF->radius, 0.01f, 1.0f, "%.3f", bSDFChanged);
+					}
 
-								ImGui::Spacing();
-								SDFInputVector3WithCallback("Sphere Radius", &sphereSDF->radius, 0.01f, 1.0f, "%.3f", bSDFChanged);
+					ImGui::Separator();
 
-								break;
-							}
-							default:
-							{
-									
-							}
+					//Without a CSG tree the terrain is the union of all SDFs
+					if (ImGui::Button("Build CSG Union"))
+					{
+						std::vector<std::shared_ptr<CSGNode>> primitiveNodes;
+						for (size_t slot = 0; slot < sdfComponent->GetSpheres().Size(); ++slot)
+						{
+							primitiveNodes.push_back(CSGNode::MakePrimitive(SDFHandle{ SDFType::Sphere, sdfComponent->GetSpheres().GetId(slot) }));
+						}
+						for (size_t slot = 0; slot < sdfComponent->GetBoxes().Size(); ++slot)
+						{
+							primitiveNodes.push_back(CSGNode::MakePrimitive(SDFHandle{ SDFType::Box, sdfComponent->GetBoxes().GetId(slot) }));
+						}
+
+						sdfComponent->SetCSGRoot(CSGNode::MakeOperation(ECSGOperation::Union, primitiveNodes));
+					}
+
+					if (sdfComponent->GetCSGRoot())
+					{
+						ImGui::SameLine();
+						if (ImGui::Button("Clear CSG Tree"))
+						{
+							sdfComponent->SetCSGRoot(nullptr);
+						}
+						else
+						{
+							DrawCSGNodeSettings(*sdfComponent->GetCSGRoot(), "##csg", bSDFChanged);
 						}
 					}
 
 					//If SDF changed at any value, set flag to regenerate mesh
-					if (bSDFChanged) terrainSDFComponent.lock()->SetShouldRegenerateMesh(true);
+					if (bSDFChanged) sdfComponent->NotifySDFsEdited();
 				}
 
 			}
@@ -322,7 +390,7 @@ void App::init()
 
 					SphereBrush::GenerateSphereMesh(vertices, normals, indices, sphereBrushRadius);
 
-					userBrushSphere->SetupMeshComponent(EShaderOption::lit, vertices, normals, indices);
+					userBrushSphere->SetupMeshComponent(EShaderOption::lit, std::move(vertices), std::move(normals), std::move(indices));
 					userBrushSphere->GetMeshComponent().lock()->SetObjectColor(glm::vec3(0.5f, 0.5f, 1.0f));
 				}
 
@@ -367,6 +435,18 @@ void App::init()
 						m_brushType = EBrushType::HardBrushAdd;
 					}
 				}
+
+				//Sculpted terrain is kept in a world file, loading it needs the SDF the world was sculpted from
+				ImGui::Spacing();
+				ImGui::Spacing();
+				ImGui::Text("World File");
+				static char worldFilePath[256] = "Terrain.dcworld";
+				ImGui::InputText("##WorldFile", worldFilePath, sizeof(worldFilePath));
+				if (ImGui::Button("Save World"))
+					backgroundMesher.RequestSaveWorld(worldFilePath);
+				ImGui::SameLine();
+				if (ImGui::Button("Load World"))
+					backgroundMesher.RequestLoadWorld(worldFilePath, settings);
 			}
 
 
@@ -378,8 +458,48 @@ void App::init()
 
 		//Render the terrain
 		{
+			//Re-centre the terrain clipmap on the camera, chunks keep their meshes until the new ones are swapped in. Chunks
+			//ahead of the camera are prefetched whenever the chunk it is heading for changes too.
+			const glm::vec3 cameraPosition = m_currentCamera->GetCameraWorldPosition();
+			const glm::vec3 cameraVelocity = deltaTime > 0.f ? (cameraPosition - lastCameraPosition) / deltaTime : glm::vec3(0.f);
+			lastCameraPosition = cameraPosition;
+
+			const glm::ivec3 cameraChunk = terrainChunks.GetChunkCoord(cameraPosition, 0);
+			const glm::ivec3 predictedChunk = terrainChunks.GetChunkCoord(cameraPosition + cameraVelocity * settings.chunkPrefetchSeconds, 0);
+			if (cameraChunk != terrainViewChunk || predictedChunk != terrainPrefetchChunk)
+			{
+				terrainViewChunk = cameraChunk;
+				terrainPrefetchChunk = predictedChunk;
+				backgroundMesher.RequestViewCenter(cameraPosition, cameraVelocity, settings);
+			}
+
+			//Swap in the chunk meshes finished by the background mesher since the last frame
+			BackgroundMesher::MeshResult finishedMesh;
+			if (backgroundMesher.TakeFinishedMesh(finishedMesh))
+			{
+				for (const ChunkMesh& chunkMesh : finishedMesh.chunkMeshes)
+				{
+					//The chunk left the clipmap
+					if (!chunkMesh.mesh)
+					{
+						terrainChunkActors.erase(chunkMesh.key);
+						continue;
+					}
+
+					std::shared_ptr<AActor>& chunkActor = terrainChunkActors[chunkMesh.key];
+					if (!chunkActor)
+						chunkActor = std::make_shared<AActor>("Terrain Chunk", m_currentCamera);
+
+					//Set up the mesh component with the shading mode the mesh was built with
+					chunkActor->SetupMeshComponent((chunkMesh.bIsFlatShaded ? EShaderOption::flat_shade : EShaderOption::lit), chunkMesh.mesh);
+					//Set object color
+					chunkActor->GetMeshComponent().lock()->SetObjectColor(glm::vec3(0.5f, 1.0f, 0.75f));
+				}
+			}
+
 			//Render dual contouring vertices
-			dualContouring.DebugDrawVertices(m_terrainActor->GetVertices(), m_currentCamera, settings);
+			for (const auto& chunkActor : terrainChunkActors)
+				DualContouring::DebugDrawVertices(chunkActor.second->GetVertices(), m_currentCamera, settings);
 
 			//Regenerate mesh behavior based on app state
 			if (m_currentAppState == EAppState::Modelling)
@@ -387,20 +507,16 @@ void App::init()
 				//If any changes occur in the SDF, regenerate the mesh
 				if (!terrainSDFComponent.expired() && terrainSDFComponent.lock()->GetShouldRegenerateMesh())
 				{
-					//Generate the mesh based on the new SDF
-					dualContouring.InitGenerateMesh(terrainVertices, terrainNormals, terrainIndices, terrainDebugColors, terrainSDFComponent, settings);
-
-					//Set up the mesh component after generating the mesh
-					m_terrainActor->SetupMeshComponent((settings.bShouldFlatShade ? EShaderOption::flat_shade : EShaderOption::lit), terrainVertices, terrainNormals, terrainIndices, terrainDebugColors);
-					//Set object color
-					m_terrainActor->GetMeshComponent().lock()->SetObjectColor(glm::vec3(0.5f, 1.0f, 0.75f));
+					//Generate the mesh based on the new SDF, it is swapped in once finished
+					backgroundMesher.RequestGenerate(settings);
 
 					//Unset flag to regenerate mesh
 					terrainSDFComponent.lock()->SetShouldRegenerateMesh(false);
 				}
 
-				//Render the terrain mesh
-				m_terrainActor->Render();
+				//Render the terrain chunks, a chunk is not drawn until its first mesh finished
+				for (const auto& chunkActor : terrainChunkActors)
+					chunkActor.second->Render();
 
 			} else if (m_currentAppState == EAppState::Editing)
 			{
@@ -450,29 +566,15 @@ void App::init()
 						{
 							m_sphereBrush.bUpdateSDF = false;
 
-							//Update voxel field based on brush
-							dualContouring.ApplyBrushToVoxels(sphereBrushRadius, userBrushSphere->GetWorldPosition(), m_brushType);
-
-							//Update the mesh based on the updated field
-							dualContouring.UpdateMesh(terrainVertices, terrainNormals, terrainIndices, terrainDebugColors, settings);
-
-							//Set up the mesh component after generating the mesh
-							m_terrainActor->SetupMeshComponent((settings.bShouldFlatShade ? EShaderOption::flat_shade : EShaderOption::lit), terrainVertices, terrainNormals, terrainIndices, terrainDebugColors);
-							//Set object color
-							m_terrainActor->GetMeshComponent().lock()->SetObjectColor(glm::vec3(0.5f, 1.0f, 0.75f));
+							//Update voxel field based on brush and remesh it in the background
+							backgroundMesher.RequestBrush(sphereBrushRadius, userBrushSphere->GetWorldPosition(), m_brushType, settings);
 						}
 
 						//Otherwise, if any changes occur in the regenerate the mesh (such as switching between shading model)
 						if (!terrainSDFComponent.expired() && terrainSDFComponent.lock()->GetShouldRegenerateMesh())
 						{
 							//Update the mesh based on the updated field
-							dualContouring.UpdateMesh(terrainVertices, terrainNormals, terrainIndices, terrainDebugColors, settings);
-
-							//Set up the mesh component after generating the mesh
-							m_terrainActor->SetupMeshComponent((settings.bShouldFlatShade ? EShaderOption::flat_shade : EShaderOption::lit), terrainVertices, terrainNormals, terrainIndices, terrainDebugColors);
-							//Set object color
-							m_terrainActor->GetMeshComponent().lock()->SetObjectColor(glm::vec3(0.5f, 1.0f, 0.75f));
-
+							backgroundMesher.RequestUpdate(settings);
 
 							//Unset flag to regenerate mesh
 							terrainSDFComponent.lock()->SetShouldRegenerateMesh(false);
@@ -481,8 +583,9 @@ void App::init()
 
 				}
 
-				//Render the terrain mesh
-				m_terrainActor->Render();
+				//Render the terrain chunks
+				for (const auto& chunkActor : terrainChunkActors)
+					chunkActor.second->Render();
 				//Render transparent object last
 				if (settings.bIsEditingEnabled)
 					m_userBrushDepthPlane->Render();
@@ -562,6 +665,48 @@ RayCastResult App::RaycastForBrushPlane(double xPos, double yPos)
 	return hitResult;
 }
 
+void App::DrawCSGNodeSettings(CSGNode& node, const std::string& idComplement, bool& bSDFChanged)
+{
+	if (node.operation == ECSGOperation::Primitive)
+	{
+		ImGui::BulletText("%s %u", node.primitive.type == SDFType::Sphere ? "Sphere" : "Box", node.primitive.id);
+		return;
+	}
+
+	static const char* operationNames[] = { "Primitive", "Union", "Subtract", "Intersect", "Smooth Union", "Transform" };
+	if (!ImGui::TreeNode(("CSG " + std::string(operationNames[static_cast<int>(node.operation)]) + idComplement).c_str()))
+		return;
+
+	//Primitive is left out of the combo, leaves are created from the SDF list
+	//The background mesher meshes a copy of the tree, so the node is edited in place
+	int operationIndex = static_cast<int>(node.operation) - 1;
+	if (ImGui::Combo(("Operation" + idComplement).c_str(), &operationIndex, &operationNames[1], 5))
+	{
+		node.operation = static_cast<ECSGOperation>(operationIndex + 1);
+		bSDFChanged = true;
+	}
+
+	if (node.operation == ECSGOperation::SmoothUnion)
+	{
+		bSDFChanged |= ImGui::InputFloat(("Smoothness" + idComplement).c_str(), &node.smoothness, 0.05f, 0.5f, "%.3f");
+	}
+
+	if (node.operation == ECSGOperation::Transform)
+	{
+		bSDFChanged |= ImGui::InputFloat3(("Translation" + idComplement).c_str(), &node.translation.x, "%.3f");
+		bSDFChanged |= ImGui::InputFloat3(("Rotation" + idComplement).c_str(), &node.rotationDegrees.x, "%.1f");
+		bSDFChanged |= ImGui::InputFloat(("Scale" + idComplement).c_str(), &node.scale, 0.05f, 0.5f, "%.3f");
+	}
+
+	for (size_t childIndex = 0; childIndex < node.children.size(); ++childIndex)
+	{
+		if (node.children[childIndex])
+			DrawCSGNodeSettings(*node.children[childIndex], idComplement + "_" + std::to_string(childIndex), bSDFChanged);
+	}
+
+	ImGui::TreePop();
+}
+
 void App::PollSettings(GLFWwindow* window) const
 {
 	glfwSetInputMode(window, GLFW_CURSOR, settings.bIsCursorEnabled ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
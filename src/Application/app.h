@@ -2,6 +2,7 @@
 
 
 #include <memory>
+#include <string>
 #include <glm/glm.hpp>
 #include <GLFW/glfw3.h>
 #include "Helpers/Settings.h"
@@ -11,6 +12,7 @@
 class ACamera;
 class AActor;
 class Settings;
+struct CSGNode;
 
 
 struct RayCastResult
@@ -67,6 +69,8 @@ private:
 	static void MouseClickCallback(GLFWwindow* window, int button, int action, int mods);
 	static void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 	static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	//Draws the settings of a CSG node and its children, sets bSDFChanged if anything was edited
+	static void DrawCSGNodeSettings(CSGNode& node, const std::string& idComplement, bool& bSDFChanged);
 
 	//Initially, the app state is modelling 
 	EAppState m_currentAppState = EAppState::Modelling;
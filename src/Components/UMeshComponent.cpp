@@ -5,18 +5,15 @@
 #include "Helpers/Shader.h"
 
 
-UMeshComponent::UMeshComponent(const std::vector<float>& vertices, const std::vector<float>& normals,
-                               const std::vector<unsigned int>& indices, const std::vector<float>& colors, const std::weak_ptr<const AActor>  owningActor) : UActorComponent(owningActor)
+UMeshComponent::UMeshComponent(SharedMeshData meshData, const std::weak_ptr<const AActor>  owningActor) : UActorComponent(owningActor)
 {
-	this->vertices = vertices;
-	this->normals = normals;
-	this->indices = indices;
-	this->colors = colors;
+	//The mesh is shared with whoever generated it, a missing mesh is drawn as an empty one
+	this->meshData = meshData ? std::move(meshData) : std::make_shared<const MeshData>();
 }
 
-std::vector<float> UMeshComponent::GetVertices() const
+ArrayView<float> UMeshComponent::GetVertices() const
 {
-	return this->vertices;
+	return ArrayView<float>(this->meshData->vertices);
 }
 
 void UMeshComponent::Init(EShaderOption shaderOption)
@@ -42,7 +39,8 @@ void UMeshComponent::Render()
 	//Activate VAO
 	glBindVertexArray(VAO);
 
-	bool bShouldDrawEBO = !(this->indices.empty());
+	const MeshData& mesh = *this->meshData;
+	bool bShouldDrawEBO = !(mesh.indices.empty());
 
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL); // Normal shading
 
@@ -52,12 +50,12 @@ void UMeshComponent::Render()
 	if (bShouldDrawEBO)
 	{
 
-		glDrawElements(GL_TRIANGLES, static_cast<int>(indices.size()), GL_UNSIGNED_INT, 0);
+		glDrawElements(GL_TRIANGLES, static_cast<int>(mesh.indices.size()), GL_UNSIGNED_INT, 0);
 
 	}
 	else
 	{
-		glDrawArrays(GL_TRIANGLES, 0, static_cast<int>(vertices.size() / 3));
+		glDrawArrays(GL_TRIANGLES, 0, static_cast<int>(mesh.vertices.size() / 3));
 	}
 }
 
@@ -70,9 +68,10 @@ void UMeshComponent::SetupBuffers()
 	glDeleteBuffers(1, &colors_VBO);
 
 
-	bool bShouldSetupEBO = !(this->indices.empty());
-	bool bShouldBindNormals = !(this->normals.empty());
-	bool bShouldBindColors = !(this->colors.empty());
+	const MeshData& mesh = *this->meshData;
+	bool bShouldSetupEBO = !(mesh.indices.empty());
+	bool bShouldBindNormals = !(mesh.normals.empty());
+	bool bShouldBindColors = !(mesh.colors.empty());
 
 	//Generate Vertex Array Object
 	glGenVertexArrays(1, &VAO);
@@ -90,12 +89,12 @@ void UMeshComponent::SetupBuffers()
 	//Binds a buffer object to the current buffer type, only 1 can be set at one time
 	glBindBuffer(GL_ARRAY_BUFFER, vertices_VBO);
 	//Copy data to the buffer
-	glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(float), this->vertices.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
 	// 1. Copy index array in an element buffer for OpenGL to use.
 	if (bShouldSetupEBO)
 	{
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(unsigned int), this->indices.data(), GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
 	}
 
 	// 2. then set the vertex attributes pointers
@@ -107,7 +106,7 @@ void UMeshComponent::SetupBuffers()
 		//Copy normal array in a buffer
 		glBindBuffer(GL_ARRAY_BUFFER, normal_VBO);
 		//Copy data to the buffer
-		glBufferData(GL_ARRAY_BUFFER, this->normals.size() * sizeof(float), this->normals.data(), GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, mesh.normals.size() * sizeof(float), mesh.normals.data(), GL_STATIC_DRAW);
 		// 2. then set the vertex attributes pointers
 		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 		glEnableVertexAttribArray(1);
@@ -118,7 +117,7 @@ void UMeshComponent::SetupBuffers()
 		//Copy normal array in a buffer
 		glBindBuffer(GL_ARRAY_BUFFER, colors_VBO);
 		//Copy data to the buffer
-		glBufferData(GL_ARRAY_BUFFER, this->colors.size() * sizeof(float), this->colors.data(), GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, mesh.colors.size() * sizeof(float), mesh.colors.data(), GL_STATIC_DRAW);
 		// 2. then set the vertex attributes pointers
 		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 		glEnableVertexAttribArray(2);
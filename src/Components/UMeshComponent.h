@@ -7,6 +7,7 @@
 #include <glm/vec4.hpp>
 
 #include "UActorComponent.h"
+#include "Helpers/MeshData.h"
 
 class AActor;
 class Shader;
@@ -15,12 +16,14 @@ class UMeshComponent : public UActorComponent
 {
 public:
 
-	UMeshComponent(const std::vector<float>& vertices, const std::vector<float>& normals, const std::vector<unsigned int>& indices, const std::vector<float>& colors, const std::weak_ptr<const AActor> owningActor);
+	UMeshComponent(SharedMeshData meshData, const std::weak_ptr<const AActor> owningActor);
 	~UMeshComponent() override;
 
 public:
 
-	std::vector<float> GetVertices() const;
+	//View into the shared mesh, valid as long as this component holds it
+	ArrayView<float> GetVertices() const;
+	SharedMeshData GetMeshData() const { return meshData; }
 
 	//IMP!! This is called from AActor when AActor::Init() is called | Sets up buffers and shaders
 	void Init(EShaderOption shaderOption);
@@ -38,10 +41,7 @@ protected:
 	unsigned int EBO;
 
 	// MESH DETAILS
-	std::vector<float> vertices;
-	std::vector<float> normals;
-	std::vector<float> colors;
-	std::vector<unsigned int> indices;
+	SharedMeshData meshData;
 	//By default, the object color is white
 	glm::vec4 objectColor = glm::vec4(1.f);
 
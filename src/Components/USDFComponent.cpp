@@ -0,0 +1,285 @@
+#include "USDFComponent.h"
+
+#include <algorithm>
+
+namespace
+{
+	//Per-thread scratch for one primitive's batch results, grown on demand and reused
+	struct BatchScratch
+	{
+		std::vector<float> distances;
+		std::vector<float> gradientX;
+		std::vector<float> gradientY;
+		std::vector<float> gradientZ;
+	};
+
+	BatchScratch& GetBatchScratch(const int count, const bool bWithGradients)
+	{
+		static thread_local BatchScratch scratch;
+
+		const size_t requiredSize = static_cast<size_t>(count);
+		if (scratch.distances.size() < requiredSize)
+			scratch.distances.resize(requiredSize);
+
+		if (bWithGradients && scratch.gradientX.size() < requiredSize)
+		{
+			scratch.gradientX.resize(requiredSize);
+			scratch.gradientY.resize(requiredSize);
+			scratch.gradientZ.resize(requiredSize);
+		}
+
+		return scratch;
+	}
+
+	//FNV-1a over the bytes of a value
+	template<typename T>
+	void HashValue(uint64_t& hash, const T& value)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		for (size_t i = 0; i < sizeof(T); ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	}
+}
+
+bool USDFComponent::RemoveSDF(const SDFHandle handle)
+{
+	bool bRemoved = false;
+	switch (handle.type)
+	{
+		case SDFType::Sphere: bRemoved = spheres.Remove(handle.id); break;
+		case SDFType::Box: bRemoved = boxes.Remove(handle.id); break;
+		default: break;
+	}
+
+	//Set flag to regenerate the mesh
+	if (bRemoved)
+	{
+		bShouldRegenerateMesh = true;
+		bBVHNeedsRebuild = true;
+		bCSGNeedsCompile = true;
+	}
+
+	return bRemoved;
+}
+
+ISignedDistanceField* USDFComponent::GetSDF(const SDFHandle handle)
+{
+	switch (handle.type)
+	{
+		case SDFType::Sphere: return spheres.Get(handle.id);
+		case SDFType::Box: return boxes.Get(handle.id);
+		default: return nullptr;
+	}
+}
+
+void USDFComponent::NotifySDFsEdited()
+{
+	bShouldRegenerateMesh = true;
+	bBVHNeedsRefit = true;
+	bCSGNeedsCompile = true;
+}
+
+void USDFComponent::SetCSGRoot(const std::shared_ptr<CSGNode>& root)
+{
+	csgRoot = root;
+	bCSGNeedsCompile = true;
+	bShouldRegenerateMesh = true;
+}
+
+std::shared_ptr<USDFComponent> USDFComponent::CreateSnapshot() const
+{
+	std::shared_ptr<USDFComponent> snapshot = std::make_shared<USDFComponent>(owningActor);
+	snapshot->spheres = spheres;
+	snapshot->boxes = boxes;
+	//The nodes are edited in place by the settings UI, so the tree is copied too
+	snapshot->csgRoot = csgRoot ? csgRoot->Clone() : nullptr;
+	snapshot->bCSGNeedsCompile = true;
+	snapshot->bBVHNeedsRebuild = true;
+	return snapshot;
+}
+
+void USDFComponent::PrepareForEvaluation()
+{
+	//Primitive parameters are baked into the program, so any edit to them recompiles it. The regenerate flag is not
+	//used here, it belongs to the render thread while meshing runs in the background.
+	//Nothing is written unless something is stale, so grids meshed in parallel can all call this on the same component
+	if (bCSGNeedsCompile)
+	{
+		if (!csgRoot)
+			csgProgram.Clear();
+		else if (!csgProgram.Compile(*csgRoot, spheres, boxes))
+			std::cout << "\nCould not compile the CSG tree, evaluating the union of all SDFs instead";
+
+		bCSGNeedsCompile = false;
+	}
+
+	if (bBVHNeedsRebuild)
+	{
+		GatherBVHBounds();
+		bvh.Build(bvhPrimitives, bvhBoundsMin, bvhBoundsMax);
+		bBVHNeedsRebuild = false;
+		bBVHNeedsRefit = false;
+	}
+	else if (bBVHNeedsRefit)
+	{
+		//Same primitives in the same slots, only their bounds moved
+		GatherBVHBounds();
+		bvh.Refit(bvhBoundsMin, bvhBoundsMax);
+		bBVHNeedsRefit = false;
+	}
+}
+
+uint64_t USDFComponent::CalculateFingerprint() const
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	HashValue(hash, static_cast<uint64_t>(spheres.Size()));
+	for (const SphereSDF& sphere : spheres)
+	{
+		HashValue(hash, sphere.center);
+		HashValue(hash, sphere.radius);
+	}
+
+	HashValue(hash, static_cast<uint64_t>(boxes.Size()));
+	for (const BoxSDF& box : boxes)
+	{
+		HashValue(hash, box.center);
+		HashValue(hash, box.halfExtents);
+	}
+
+	//Members one by one, the padding of an instruction isn't initialized
+	const bool bUsesCSGProgram = ShouldUseCSGProgram();
+	HashValue(hash, bUsesCSGProgram);
+	if (bUsesCSGProgram)
+	{
+		for (const CSGInstruction& instruction : csgProgram.GetInstructions())
+		{
+			HashValue(hash, instruction.opCode);
+			HashValue(hash, instruction.destination);
+			HashValue(hash, instruction.operand);
+			HashValue(hash, instruction.points);
+			HashValue(hash, instruction.destinationPoints);
+			HashValue(hash, instruction.constants);
+		}
+	}
+
+	return hash;
+}
+
+void USDFComponent::GatherBVHBounds()
+{
+	bvhPrimitives.clear();
+	bvhBoundsMin.clear();
+	bvhBoundsMax.clear();
+
+	auto gatherBounds = [&](const auto& primitives)
+	{
+		for (size_t slot = 0; slot < primitives.Size(); ++slot)
+		{
+			glm::vec3 boundsMin, boundsMax;
+			primitives[slot].GetBounds(boundsMin, boundsMax);
+
+			bvhPrimitives.push_back(SDFPrimitiveRef{ primitives[slot].GetType(), static_cast<uint32_t>(slot) });
+			bvhBoundsMin.push_back(boundsMin);
+			bvhBoundsMax.push_back(boundsMax);
+		}
+	};
+
+	gatherBounds(spheres);
+	gatherBounds(boxes);
+}
+
+void USDFComponent::EvaluateSDFBatch(const SDFBatchPoints& points, float* outDistances) const
+{
+	if (GetSDFCount() == 0)
+	{
+		std::cout << "\nCould not evaluate SDF for this batch. The sdf list was empty";
+		std::fill(outDistances, outDistances + points.count, std::numeric_limits<float>::max());
+		return;
+	}
+
+	if (ShouldUseCSGProgram())
+	{
+		csgProgram.Execute(points, outDistances, nullptr);
+		return;
+	}
+
+	//Large scenes cull per point with the BVH, which beats evaluating every primitive across the batch
+	if (ShouldUseBVH())
+	{
+		for (int i = 0; i < points.count; ++i)
+		{
+			outDistances[i] = EvaluateSDF(glm::vec3(points.x[i], points.y[i], points.z[i]));
+		}
+		return;
+	}
+
+	//The first SDF writes straight into the output, the rest are unioned in
+	BatchScratch& scratch = GetBatchScratch(points.count, false);
+	bool bHasResult = false;
+	auto unionBatch = [&](const auto& primitive)
+	{
+		primitive.EvaluateBatch(points, bHasResult ? scratch.distances.data() : outDistances);
+		if (bHasResult)
+			SDFBatch::UnionMin(scratch.distances.data(), outDistances, points.count);
+		bHasResult = true;
+	};
+
+	for (const SphereSDF& sphere : spheres) unionBatch(sphere);
+	for (const BoxSDF& box : boxes) unionBatch(box);
+}
+
+void USDFComponent::EvaluateSDFWithGradientBatch(const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients& outGradients) const
+{
+	if (GetSDFCount() == 0)
+	{
+		std::cout << "\nCould not evaluate SDF for this batch. The sdf list was empty";
+		std::fill(outDistances, outDistances + points.count, std::numeric_limits<float>::max());
+		std::fill(outGradients.x, outGradients.x + points.count, 0.f);
+		std::fill(outGradients.y, outGradients.y + points.count, 1.f);
+		std::fill(outGradients.z, outGradients.z + points.count, 0.f);
+		return;
+	}
+
+	if (ShouldUseCSGProgram())
+	{
+		csgProgram.Execute(points, outDistances, &outGradients);
+		return;
+	}
+
+	if (ShouldUseBVH())
+	{
+		for (int i = 0; i < points.count; ++i)
+		{
+			glm::vec3 gradient;
+			outDistances[i] = EvaluateSDFWithGradient(glm::vec3(points.x[i], points.y[i], points.z[i]), gradient);
+			outGradients.x[i] = gradient.x;
+			outGradients.y[i] = gradient.y;
+			outGradients.z[i] = gradient.z;
+		}
+		return;
+	}
+
+	//The first SDF writes straight into the output, the rest are unioned in keeping the gradient of the closest one
+	BatchScratch& scratch = GetBatchScratch(points.count, true);
+	const SDFBatchGradients scratchGradients{ scratch.gradientX.data(), scratch.gradientY.data(), scratch.gradientZ.data() };
+	bool bHasResult = false;
+	auto unionBatch = [&](const auto& primitive)
+	{
+		if (!bHasResult)
+		{
+			primitive.EvaluateWithGradientBatch(points, outDistances, outGradients);
+			bHasResult = true;
+			return;
+		}
+
+		primitive.EvaluateWithGradientBatch(points, scratch.distances.data(), scratchGradients);
+		SDFBatch::UnionMinWithGradient(scratch.distances.data(), scratchGradients, outDistances, outGradients, points.count);
+	};
+
+	for (const SphereSDF& sphere : spheres) unionBatch(sphere);
+	for (const BoxSDF& box : boxes) unionBatch(box);
+}
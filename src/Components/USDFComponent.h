@@ -1,50 +1,138 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <vector>
 
 #include "UActorComponent.h"
 #include "Helpers/SDFs/ISignedDistanceField.h"
+#include "Helpers/SDFs/CSGNode.h"
+#include "Helpers/SDFs/CSGProgram.h"
+#include "Helpers/SDFs/SDFBoundingVolumeHierarchy.h"
+#include "Helpers/SDFs/SDFPrimitiveArray.h"
+#include "Helpers/SDFs/BoxSDF.h"
+#include "Helpers/SDFs/SphereSDF.h"
 
 
 class USDFComponent : public UActorComponent
 {
+	//Below this many primitives a linear (SIMD batched) pass is cheaper than walking the BVH
+	static constexpr size_t BVH_MIN_PRIMITIVE_COUNT = 16;
 
 public:
 
 	USDFComponent(std::weak_ptr<const AActor> owningActor) : UActorComponent(owningActor) {}
 	~USDFComponent() override = default;
 
-	//Add an SDF
+	//Add an SDF, the returned handle stays valid until the SDF is removed
 	template<typename T, typename... Args>
-	void AddSDF(Args&&... args)
+	SDFHandle AddSDF(Args&&... args)
 	{
 		//Set flag to regenerate the mesh
 		bShouldRegenerateMesh = true;
+		bBVHNeedsRebuild = true;
+		bCSGNeedsCompile = true;
 
-		sdfList.push_back(std::make_shared<T>(std::forward<Args>(args)...));
+		const SDFHandle handle{ T::StaticType(), GetPrimitiveArray(static_cast<const T*>(nullptr)).Add(T(std::forward<Args>(args)...)) };
 
 		std::cout << "\nAdded an SDF to the list";
+
+		return handle;
 	}
 
+	bool RemoveSDF(const SDFHandle handle);
+	//Returns nullptr if the handle was removed
+	ISignedDistanceField* GetSDF(const SDFHandle handle);
+	//Call after editing primitives or the CSG tree in place. The edits reach the mesh through the snapshot taken by the
+	//next generate request, like any other change to this component.
+	void NotifySDFsEdited();
+	//Rebuilds or refits the BVH and recompiles the CSG program if anything changed, call before evaluating from multiple threads
+	void PrepareForEvaluation();
+
+	//Copy of the primitives and the CSG tree that the background mesher evaluates, so this component can be edited while
+	//it meshes. The copy is prepared on first use, like a component that was just filled.
+	std::shared_ptr<USDFComponent> CreateSnapshot() const;
+
+	//Hash of everything the field depends on, the primitives and the compiled CSG program. Call after PrepareForEvaluation.
+	uint64_t CalculateFingerprint() const;
+
+	//Evaluate this CSG tree instead of the union of all primitives, nullptr goes back to the union
+	void SetCSGRoot(const std::shared_ptr<CSGNode>& root);
+	std::shared_ptr<CSGNode> GetCSGRoot() const { return csgRoot; }
+
 	float EvaluateSDF(const glm::vec3& queryPoint) const
 	{
 		float result = std::numeric_limits<float>::max();
 
-		if (sdfList.empty())
+		if (GetSDFCount() == 0)
 		{
 			std::cout << "\nCould not evaluate SDF for this query point. The sdf list was empty";
 			return result;
 		}
 
-		for (const auto& sdf : sdfList)
+		if (ShouldUseCSGProgram())
+			return csgProgram.Execute(queryPoint, nullptr);
+
+		//Only evaluate primitives whose bounds could beat the closest distance so far
+		if (ShouldUseBVH())
 		{
-			result = std::min(result, sdf->EvaluateSDF(queryPoint));
+			return bvh.QueryMin(queryPoint,
+				[&](const SDFPrimitiveRef& primitive) { return EvaluatePrimitive(primitive, queryPoint); },
+				[](const SDFPrimitiveRef&, float) {});
 		}
 
+		//Min-reduction over each type's array, calls are not virtual
+		UnionPrimitives(spheres, queryPoint, result);
+		UnionPrimitives(boxes, queryPoint, result);
+
 		return result;
 	}
 
-	std::vector<std::shared_ptr<ISignedDistanceField>> GetSDFList() { return sdfList; }
+	//Evaluates the union and the gradient of the closest SDF in one pass
+	float EvaluateSDFWithGradient(const glm::vec3& queryPoint, glm::vec3& outGradient) const
+	{
+		float result = std::numeric_limits<float>::max();
+		outGradient = glm::vec3(0.f, 1.f, 0.f);
+
+		if (GetSDFCount() == 0)
+		{
+			std::cout << "\nCould not evaluate SDF for this query point. The sdf list was empty";
+			return result;
+		}
+
+		if (ShouldUseCSGProgram())
+			return csgProgram.Execute(queryPoint, &outGradient);
+
+		if (ShouldUseBVH())
+		{
+			//Only the closest primitive's gradient is needed, evaluate it once at the end
+			SDFPrimitiveRef closestPrimitive{ SDFType::Sphere, 0 };
+			result = bvh.QueryMin(queryPoint,
+				[&](const SDFPrimitiveRef& primitive) { return EvaluatePrimitive(primitive, queryPoint); },
+				[&](const SDFPrimitiveRef& primitive, float) { closestPrimitive = primitive; });
+
+			EvaluatePrimitiveWithGradient(closestPrimitive, queryPoint, outGradient);
+			return result;
+		}
+
+		UnionPrimitivesWithGradient(spheres, queryPoint, result, outGradient);
+		UnionPrimitivesWithGradient(boxes, queryPoint, result, outGradient);
+
+		return result;
+	}
+
+	//Evaluates the union for a batch of points
+	void EvaluateSDFBatch(const SDFBatchPoints& points, float* outDistances) const;
+	//Evaluates the union and the gradient of the closest SDF for a batch of points
+	void EvaluateSDFWithGradientBatch(const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients& outGradients) const;
+
+	//Primitives of each type, edited in place (no copies). Only the thread that owns the component may edit them,
+	//meshing evaluates a snapshot (see CreateSnapshot).
+	SDFPrimitiveArray<SphereSDF>& GetSpheres() { return spheres; }
+	SDFPrimitiveArray<BoxSDF>& GetBoxes() { return boxes; }
+	size_t GetSDFCount() const { return spheres.Size() + boxes.Size(); }
 
 	bool GetShouldRegenerateMesh() const { return bShouldRegenerateMesh; }
 	void SetShouldRegenerateMesh(bool bRegenerate) { bShouldRegenerateMesh = bRegenerate; }
@@ -55,7 +143,68 @@ private:
 
 	bool bShouldRegenerateMesh = true;
 
-	//Stores all the sdf objects
-	std::vector<std::shared_ptr<ISignedDistanceField>> sdfList;
+	//Stores all the sdf objects, one contiguous array per type
+	SDFPrimitiveArray<SphereSDF> spheres;
+	SDFPrimitiveArray<BoxSDF> boxes;
+
+	//Hierarchy over the bounds of all primitives, used once there are enough primitives for culling to pay off
+	SDFBoundingVolumeHierarchy bvh;
+	bool bBVHNeedsRebuild = true;
+	bool bBVHNeedsRefit = false;
+	//Primitive references and bounds the BVH was built from
+	std::vector<SDFPrimitiveRef> bvhPrimitives;
+	std::vector<glm::vec3> bvhBoundsMin;
+	std::vector<glm::vec3> bvhBoundsMax;
+
+	//CSG tree being edited and the program it compiles to, recompiled when the mesh is regenerated
+	std::shared_ptr<CSGNode> csgRoot;
+	CSGProgram csgProgram;
+	bool bCSGNeedsCompile = false;
+
+	//Falls back to the union of all primitives if the tree failed to compile
+	bool ShouldUseCSGProgram() const { return csgRoot && !bCSGNeedsCompile && !csgProgram.Empty(); }
+
+	//The BVH is only used while it is up to date, otherwise evaluation falls back to the linear path
+	bool ShouldUseBVH() const { return !bBVHNeedsRebuild && !bBVHNeedsRefit && GetSDFCount() >= BVH_MIN_PRIMITIVE_COUNT; }
+	void GatherBVHBounds();
+
+	float EvaluatePrimitive(const SDFPrimitiveRef& primitive, const glm::vec3& queryPoint) const
+	{
+		return primitive.type == SDFType::Sphere ? spheres[primitive.slot].EvaluateSDF(queryPoint) : boxes[primitive.slot].EvaluateSDF(queryPoint);
+	}
+
+	float EvaluatePrimitiveWithGradient(const SDFPrimitiveRef& primitive, const glm::vec3& queryPoint, glm::vec3& outGradient) const
+	{
+		return primitive.type == SDFType::Sphere ? spheres[primitive.slot].EvaluateWithGradient(queryPoint, outGradient) : boxes[primitive.slot].EvaluateWithGradient(queryPoint, outGradient);
+	}
+
+	SDFPrimitiveArray<SphereSDF>& GetPrimitiveArray(const SphereSDF*) { return spheres; }
+	SDFPrimitiveArray<BoxSDF>& GetPrimitiveArray(const BoxSDF*) { return boxes; }
+
+	template<typename T>
+	static void UnionPrimitives(const SDFPrimitiveArray<T>& primitives, const glm::vec3& queryPoint, float& result)
+	{
+		for (const T& primitive : primitives)
+		{
+			result = std::min(result, primitive.EvaluateSDF(queryPoint));
+		}
+	}
+
+	template<typename T>
+	static void UnionPrimitivesWithGradient(const SDFPrimitiveArray<T>& primitives, const glm::vec3& queryPoint, float& result, glm::vec3& outGradient)
+	{
+		for (const T& primitive : primitives)
+		{
+			glm::vec3 gradient;
+			const float distance = primitive.EvaluateWithGradient(queryPoint, gradient);
+
+			//The gradient of a min-union is the gradient of the argmin
+			if (distance < result)
+			{
+				result = distance;
+				outGradient = gradient;
+			}
+		}
+	}
 
 };
@@ -0,0 +1,345 @@
+#include "BackgroundMesher.h"
+
+#include <algorithm>
+
+#include "TerrainChunkManager.h"
+#include "Components/USDFComponent.h"
+
+BackgroundMesher::BackgroundMesher(TerrainChunkManager& chunkManager, const std::weak_ptr<USDFComponent> sdfComponent)
+	: m_chunkManager(chunkManager), m_sdfComponent(sdfComponent), m_meshingTask{ this }
+{
+}
+
+BackgroundMesher::~BackgroundMesher()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bShuttingDown = true;
+	}
+
+	//Finishes the running request, pending ones are dropped
+	JobSystem::GetShared().Wait(m_meshingTaskGroup);
+}
+
+void BackgroundMesher::RequestGenerate(const Settings& settings)
+{
+	//Edits made after this request reach the meshing task with the next one
+	std::shared_ptr<USDFComponent> sdfSnapshot = TakeSDFSnapshot();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingSettings = settings;
+		m_pendingSDF.swap(sdfSnapshot);
+		//Regenerating resamples the whole field, strokes queued before it would be lost anyway unless a save wants them
+		DropStrokesBeforeRegenerate();
+		m_bGenerateRequested = true;
+		m_bLoadRequested = false;
+		m_generation.fetch_add(1);
+		m_requestCount.fetch_add(1);
+	}
+	StartMeshingTask();
+}
+
+void BackgroundMesher::RequestLoadWorld(const std::string& path, const Settings& settings)
+{
+	//The world file has to match the SDF as it is now
+	std::shared_ptr<USDFComponent> sdfSnapshot = TakeSDFSnapshot();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingSettings = settings;
+		m_pendingSDF.swap(sdfSnapshot);
+		//The loaded lattices replace the whole field, like a generation
+		DropStrokesBeforeRegenerate();
+		m_pendingLoadPath = path;
+		m_bLoadRequested = true;
+		m_bGenerateRequested = false;
+		m_generation.fetch_add(1);
+		m_requestCount.fetch_add(1);
+	}
+	StartMeshingTask();
+}
+
+void BackgroundMesher::RequestSaveWorld(const std::string& path)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingSavePath = path;
+		m_bSaveRequested = true;
+		m_pendingSaveStrokeCount = m_pendingStrokes.size();
+		m_bSaveBeforeRegenerate = false;
+		m_requestCount.fetch_add(1);
+	}
+	StartMeshingTask();
+}
+
+void BackgroundMesher::RequestBrush(const float sphereRadius, const glm::vec3& sphereCenter, const EBrushType brushType, const Settings& settings)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingSettings = settings;
+		m_pendingStrokes.push_back(BrushStroke{ sphereRadius, sphereCenter, brushType });
+		m_requestCount.fetch_add(1);
+	}
+	StartMeshingTask();
+}
+
+void BackgroundMesher::RequestUpdate(const Settings& settings)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingSettings = settings;
+		m_bUpdateRequested = true;
+		m_requestCount.fetch_add(1);
+	}
+	StartMeshingTask();
+}
+
+void BackgroundMesher::RequestViewCenter(const glm::vec3& viewPosition, const glm::vec3& viewVelocity, const Settings& settings)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingSettings = settings;
+		m_pendingViewCenter = viewPosition;
+		m_pendingViewVelocity = viewVelocity;
+		m_bViewCenterRequested = true;
+		m_bPrefetchRequested = true;
+		m_requestCount.fetch_add(1);
+	}
+	StartMeshingTask();
+}
+
+bool BackgroundMesher::TakeFinishedMesh(MeshResult& outResult)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_bHasFinishedMesh)
+		return false;
+
+	//Hand the back buffer to the render thread, the meshing task fills a new one next time
+	outResult.chunkMeshes.clear();
+	outResult.chunkMeshes.swap(m_finishedMesh.chunkMeshes);
+	m_bHasFinishedMesh = false;
+	return true;
+}
+
+bool BackgroundMesher::IsBusy() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_bIsWorking || HasPendingRequest();
+}
+
+void BackgroundMesher::DropStrokesBeforeRegenerate()
+{
+	//A pending save that was requested before any pending generate or load runs first and keeps the strokes requested
+	//before it, otherwise it saves the regenerated terrain
+	if (m_bSaveRequested && (m_bSaveBeforeRegenerate || (!m_bGenerateRequested && !m_bLoadRequested)))
+	{
+		m_pendingStrokes.resize(std::min(m_pendingStrokes.size(), m_pendingSaveStrokeCount));
+		m_bSaveBeforeRegenerate = true;
+		return;
+	}
+
+	m_pendingStrokes.clear();
+	m_pendingSaveStrokeCount = 0;
+}
+
+std::shared_ptr<USDFComponent> BackgroundMesher::TakeSDFSnapshot() const
+{
+	const std::shared_ptr<USDFComponent> sdfComponent = m_sdfComponent.lock();
+	return sdfComponent ? sdfComponent->CreateSnapshot() : nullptr;
+}
+
+bool BackgroundMesher::HasPendingRequest() const
+{
+	return m_bGenerateRequested || m_bUpdateRequested || m_bViewCenterRequested || m_bLoadRequested || m_bSaveRequested || !m_pendingStrokes.empty();
+}
+
+void BackgroundMesher::StartMeshingTask()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_bIsWorking || m_bShuttingDown)
+			return;
+
+		//Only one meshing task runs at a time, it picks up requests made while it is running
+		m_bIsWorking = true;
+	}
+
+	JobSystem::GetShared().Spawn(m_meshingTaskGroup, m_meshingTask);
+}
+
+void BackgroundMesher::RunPendingRequests()
+{
+	std::vector<BrushStroke>& strokes = m_runningStrokes;
+
+	while (true)
+	{
+		Settings settings;
+		bool bGenerate = false;
+		bool bUpdate = false;
+		bool bMoveView = false;
+		bool bPrefetch = false;
+		bool bLoad = false;
+		bool bSave = false;
+		std::string loadPath;
+		std::string savePath;
+		std::shared_ptr<USDFComponent> sdfSnapshot;
+		size_t saveStrokeCount = 0;
+		bool bSaveBeforeRegenerate = false;
+		glm::vec3 viewCenter;
+		glm::vec3 viewVelocity;
+		uint64_t generation = 0;
+		uint64_t requestCount = 0;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_bShuttingDown || (!HasPendingRequest() && !m_bPrefetchRequested))
+			{
+				m_bIsWorking = false;
+				return;
+			}
+
+			settings = m_pendingSettings;
+			viewCenter = m_pendingViewCenter;
+			if (!HasPendingRequest())
+			{
+				//Nothing left to mesh, load the chunks ahead of the view until the next request
+				viewVelocity = m_pendingViewVelocity;
+				m_bPrefetchRequested = false;
+				bPrefetch = true;
+				generation = m_generation.load();
+				requestCount = m_requestCount.load();
+			}
+			else
+			{
+				//Take everything requested so far as one job
+				bGenerate = m_bGenerateRequested;
+				bUpdate = m_bUpdateRequested;
+				bMoveView = m_bViewCenterRequested;
+				bLoad = m_bLoadRequested;
+				bSave = m_bSaveRequested;
+				saveStrokeCount = m_pendingSaveStrokeCount;
+				bSaveBeforeRegenerate = m_bSaveBeforeRegenerate;
+				loadPath.swap(m_pendingLoadPath);
+				savePath.swap(m_pendingSavePath);
+				sdfSnapshot.swap(m_pendingSDF);
+				strokes.swap(m_pendingStrokes);
+				m_pendingStrokes.clear();
+				m_bGenerateRequested = false;
+				m_bUpdateRequested = false;
+				m_bViewCenterRequested = false;
+				m_bLoadRequested = false;
+				m_bSaveRequested = false;
+				m_pendingSaveStrokeCount = 0;
+				m_bSaveBeforeRegenerate = false;
+				generation = m_generation.load();
+			}
+		}
+
+		if (bPrefetch)
+		{
+			//Resumed after the request that interrupted it, unless the SDF is about to change
+			if (!m_chunkManager.PrefetchChunks(viewCenter, viewVelocity, settings, CancellationToken(m_requestCount, requestCount)))
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_bPrefetchRequested = m_bPrefetchRequested || m_generation.load() == generation;
+			}
+			continue;
+		}
+
+		const CancellationToken cancellation(m_generation, generation);
+		std::vector<ChunkMesh>& chunkMeshes = m_passChunkMeshes;
+
+		//Moved before generating, so a generation doesn't mesh chunks that are about to leave the clipmap
+		const bool bChunksChanged = bMoveView && m_chunkManager.SetViewCenter(viewCenter);
+
+		//A save requested before the generate or load writes the terrain they replace
+		if (bSave && bSaveBeforeRegenerate)
+		{
+			const size_t savedStrokeCount = std::min(saveStrokeCount, strokes.size());
+			for (size_t strokeIndex = 0; strokeIndex < savedStrokeCount; ++strokeIndex)
+				m_chunkManager.ApplyBrush(strokes[strokeIndex].sphereRadius, strokes[strokeIndex].sphereCenter, strokes[strokeIndex].brushType);
+			m_chunkManager.SaveWorld(savePath);
+
+			strokes.erase(strokes.begin(), strokes.begin() + savedStrokeCount);
+			bSave = false;
+		}
+
+		//Chunks finished before a cancellation are published too, they won't be meshed again. A world file that can't be
+		//read leaves the terrain as it was.
+		bool bIsRegenerated = false;
+		bool bIsCancelled = false;
+		if (bLoad)
+		{
+			bIsRegenerated = m_chunkManager.LoadWorld(loadPath, sdfSnapshot, settings, chunkMeshes, cancellation);
+			bIsCancelled = !bIsRegenerated && cancellation.IsCancelled();
+		}
+		else if (bGenerate)
+		{
+			bIsRegenerated = m_chunkManager.GenerateMesh(sdfSnapshot, settings, chunkMeshes, cancellation);
+			bIsCancelled = !bIsRegenerated;
+		}
+		PublishChunkMeshes(chunkMeshes);
+
+		if (bIsCancelled)
+		{
+			//The request that cancelled this one is picked up next. This job's save was requested before it, so it runs
+			//first with the strokes it came after, like a save that was still pending.
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (bSave && !m_bSaveRequested)
+			{
+				m_pendingSavePath.swap(savePath);
+				m_bSaveRequested = true;
+				m_pendingSaveStrokeCount = 0;
+				m_bSaveBeforeRegenerate = m_bGenerateRequested || m_bLoadRequested;
+				strokes.resize(std::min(strokes.size(), saveStrokeCount));
+			}
+			//A save that runs before the cancelling request still wants this job's strokes, they came before it
+			if (m_bSaveBeforeRegenerate)
+			{
+				m_pendingStrokes.insert(m_pendingStrokes.begin(), strokes.begin(), strokes.end());
+				m_pendingSaveStrokeCount += strokes.size();
+			}
+			continue;
+		}
+
+		//Strokes change the lattices right away, so the save sees the ones requested before it without meshing them
+		const size_t savedStrokeCount = bSave ? std::min(saveStrokeCount, strokes.size()) : strokes.size();
+		for (size_t strokeIndex = 0; strokeIndex < strokes.size(); ++strokeIndex)
+		{
+			if (strokeIndex == savedStrokeCount)
+				m_chunkManager.SaveWorld(savePath);
+
+			const BrushStroke& stroke = strokes[strokeIndex];
+			m_chunkManager.ApplyBrush(stroke.sphereRadius, stroke.sphereCenter, stroke.brushType);
+		}
+		if (bSave && savedStrokeCount == strokes.size())
+			m_chunkManager.SaveWorld(savePath);
+
+		//Strokes and view moves only mesh the chunks they touched, an update request remeshes all of them
+		if (!strokes.empty() || (!bIsRegenerated && (bUpdate || bChunksChanged)))
+		{
+			m_chunkManager.UpdateMesh(settings, bUpdate && !bIsRegenerated, chunkMeshes, cancellation);
+			PublishChunkMeshes(chunkMeshes);
+		}
+	}
+}
+
+void BackgroundMesher::PublishChunkMeshes(std::vector<ChunkMesh>& chunkMeshes)
+{
+	if (chunkMeshes.empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<ChunkMesh>& finishedMeshes = m_finishedMesh.chunkMeshes;
+	for (ChunkMesh& chunkMesh : chunkMeshes)
+	{
+		//A mesh of the same chunk the render thread has not taken yet is replaced
+		const auto finishedMesh = std::find_if(finishedMeshes.begin(), finishedMeshes.end(), [&](const ChunkMesh& other) { return other.key == chunkMesh.key; });
+		if (finishedMesh != finishedMeshes.end())
+			*finishedMesh = std::move(chunkMesh);
+		else
+			finishedMeshes.push_back(std::move(chunkMesh));
+	}
+
+	chunkMeshes.clear();
+	m_bHasFinishedMesh = true;
+}
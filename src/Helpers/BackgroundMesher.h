@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Enums/AppEnums.h"
+#include "JobSystem.h"
+#include "MeshData.h"
+#include "Settings.h"
+#include "TerrainChunkManager.h"
+
+class USDFComponent;
+
+//Runs the meshing of the terrain chunks as a task on the shared job system, so the render thread never waits for a remesh.
+//Finished chunk meshes are kept in a back buffer until the render thread takes them at a frame boundary, until then it
+//keeps drawing the last meshes it took. Meshing reads a snapshot of the SDF taken by the last generate or load request,
+//so the render thread edits the SDF component freely and never waits for the meshing task.
+class BackgroundMesher
+{
+public:
+	//Chunks remeshed since the render thread last took a result, at most one mesh per chunk
+	struct MeshResult
+	{
+		std::vector<ChunkMesh> chunkMeshes;
+	};
+
+	BackgroundMesher(TerrainChunkManager& chunkManager, const std::weak_ptr<USDFComponent> sdfComponent);
+	~BackgroundMesher();
+
+	BackgroundMesher(const BackgroundMesher&) = delete;
+	BackgroundMesher& operator=(const BackgroundMesher&) = delete;
+
+	//Regenerates every chunk from the SDF as it is now. Meshing still running for an older request is cancelled at its
+	//next checkpoint, its result would be replaced right away.
+	void RequestGenerate(const Settings& settings);
+	//Replaces the terrain with a world file and meshes it, like a generate request. Strokes requested after it are
+	//applied to the loaded world. The terrain is kept if the file can't be read.
+	void RequestLoadWorld(const std::string& path, const Settings& settings);
+	//Saves the terrain to a world file as it is after the requests made before it. A newer save request replaces a
+	//pending one.
+	void RequestSaveWorld(const std::string& path);
+	//Applies a brush to the chunks it overlaps and remeshes them. Strokes requested while the worker is busy are applied together before one remesh.
+	void RequestBrush(const float sphereRadius, const glm::vec3& sphereCenter, const EBrushType brushType, const Settings& settings);
+	//Remeshes every chunk from its current voxel field, e.g. after the shading mode changed
+	void RequestUpdate(const Settings& settings);
+	//Re-centres the chunk clipmap and meshes the chunks entering it. Running meshing is not cancelled, the latest view
+	//center is applied once it finished. Once no other request is pending, the chunks ahead of the view's velocity are
+	//prefetched until the next request arrives.
+	void RequestViewCenter(const glm::vec3& viewPosition, const glm::vec3& viewVelocity, const Settings& settings);
+
+	//Takes the chunk meshes finished since the last call, returns false if there are none
+	bool TakeFinishedMesh(MeshResult& outResult);
+	//True while a request is pending or running
+	bool IsBusy() const;
+
+private:
+	//Task that runs requests until none are pending
+	struct MeshingTask
+	{
+		BackgroundMesher* mesher;
+		void operator()(int) const { mesher->RunPendingRequests(); }
+	};
+
+	void RunPendingRequests();
+	//Starts the meshing task unless it is already running
+	void StartMeshingTask();
+	bool HasPendingRequest() const;
+	//Drops the pending strokes a generate or load request makes stale. Expects m_mutex to be held.
+	void DropStrokesBeforeRegenerate();
+	//Copy of the SDF component for the meshing task, nullptr if it was destroyed
+	std::shared_ptr<USDFComponent> TakeSDFSnapshot() const;
+	//Moves the chunk meshes of a pass into the back buffer, replacing older meshes of the same chunks
+	void PublishChunkMeshes(std::vector<ChunkMesh>& chunkMeshes);
+
+private:
+	TerrainChunkManager& m_chunkManager;
+	//Edited by the render thread, only read by the requests that snapshot it
+	std::weak_ptr<USDFComponent> m_sdfComponent;
+
+	MeshingTask m_meshingTask;
+	TaskGroup m_meshingTaskGroup;
+	mutable std::mutex m_mutex;
+
+	//Pending requests, guarded by m_mutex. The settings of the latest request are used.
+	Settings m_pendingSettings;
+	std::vector<BrushStroke> m_pendingStrokes;
+	//Strokes the meshing task is applying, swapped with the pending ones so both keep their capacity
+	std::vector<BrushStroke> m_runningStrokes;
+	//Chunk meshes of the running pass, only touched by the meshing task
+	std::vector<ChunkMesh> m_passChunkMeshes;
+	glm::vec3 m_pendingViewCenter = glm::vec3(0.f);
+	glm::vec3 m_pendingViewVelocity = glm::vec3(0.f);
+	bool m_bViewCenterRequested = false;
+	//Set by view requests, the meshing task prefetches once it ran out of other requests
+	bool m_bPrefetchRequested = false;
+	bool m_bGenerateRequested = false;
+	bool m_bUpdateRequested = false;
+	std::string m_pendingLoadPath;
+	bool m_bLoadRequested = false;
+	//Snapshot of the SDF taken by the pending generate or load request
+	std::shared_ptr<USDFComponent> m_pendingSDF;
+	std::string m_pendingSavePath;
+	bool m_bSaveRequested = false;
+	//Pending strokes requested before the save, the others are applied after it
+	size_t m_pendingSaveStrokeCount = 0;
+	//Set if a generate or load was requested after the save, the save then runs before it
+	bool m_bSaveBeforeRegenerate = false;
+	bool m_bIsWorking = false;
+	bool m_bShuttingDown = false;
+
+	//Bumped by the generate and load requests, which hand over a new SDF snapshot. Running meshing of an older snapshot
+	//is cancelled once it changes, the request itself never waits for it.
+	std::atomic<uint64_t> m_generation{ 0 };
+	//Bumped by every request, running prefetching is cancelled once it changes so requests never wait for it
+	std::atomic<uint64_t> m_requestCount{ 0 };
+
+	//Back buffer, guarded by m_mutex
+	MeshResult m_finishedMesh;
+	bool m_bHasFinishedMesh = false;
+};
@@ -22,20 +22,11 @@ public:
 
 	static glm::vec3 CalculateSurfaceNormal(const glm::vec3& intersectionPos, glm::vec3 brushCenter, float brushRadius)
 	{
-		//Perform Finite Sum Difference
-		const float h = 0.001f;
-
-		const float dx =
-			EvaluateBrushSDF(intersectionPos + glm::vec3(h, 0.f, 0.f), brushCenter, brushRadius) -
-			EvaluateBrushSDF(intersectionPos - glm::vec3(h, 0.f, 0.f), brushCenter, brushRadius);
-		const float dy =
-			EvaluateBrushSDF(intersectionPos + glm::vec3(0.f, h, 0.f), brushCenter, brushRadius) -
-			EvaluateBrushSDF(intersectionPos - glm::vec3(0.f, h, 0.f), brushCenter, brushRadius);
-		const float dz =
-			EvaluateBrushSDF(intersectionPos + glm::vec3(0.f, 0.f, h), brushCenter, brushRadius) -
-			EvaluateBrushSDF(intersectionPos - glm::vec3(0.f, 0.f, h), brushCenter, brushRadius);
-
-		return glm::normalize(glm::vec3(dx, dy, dz));
+		//Exact gradient of the sphere distance, no finite differences needed
+		const glm::vec3 offset = intersectionPos - brushCenter;
+		const float offsetLength = glm::length(offset);
+
+		return offsetLength > 0.f ? offset / offsetLength : glm::vec3(0.f, 1.f, 0.f);
 	}
 
 	static float EvaluateBrushSDF(const glm::vec3 queryPoint, glm::vec3 brushCenter, float brushRadius)
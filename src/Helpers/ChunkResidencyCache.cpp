@@ -0,0 +1,312 @@
+#include "ChunkResidencyCache.h"
+
+#include <cstdio>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+ChunkResidencyCache::ChunkResidencyCache(const std::string& swapFilePath, const VoxelWorldLayout& layout, const size_t memoryBudgetBytes)
+	: m_swapFilePath(swapFilePath)
+	, m_layout(layout)
+	, m_memoryBudgetBytes(memoryBudgetBytes)
+{
+}
+
+ChunkResidencyCache::~ChunkResidencyCache()
+{
+	Clear();
+}
+
+void ChunkResidencyCache::SetMemoryBudget(const size_t memoryBudgetBytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_memoryBudgetBytes = memoryBudgetBytes;
+	EvictToBudget();
+}
+
+void ChunkResidencyCache::Store(const ChunkKey& key, LatticeSnapshot& snapshot, const size_t strokeCount)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//A newer lattice of the same chunk replaces the old one
+	const auto latticeIt = m_lattices.find(key);
+	if (latticeIt != m_lattices.end() && latticeIt->second.location == ELatticeLocation::Memory)
+		RemoveResident(latticeIt->second);
+	else if (latticeIt != m_lattices.end())
+		RemoveFromDisk(key, latticeIt->second);
+
+	CachedLattice& lattice = m_lattices[key];
+
+	lattice.snapshot.distances.swap(snapshot.distances);
+	lattice.snapshot.normals.swap(snapshot.normals);
+	lattice.snapshot.blockStates.swap(snapshot.blockStates);
+	lattice.snapshot.blockDistanceBounds.swap(snapshot.blockDistanceBounds);
+	lattice.strokeCount = strokeCount;
+	lattice.location = ELatticeLocation::Memory;
+
+	m_recentChunks.push_front(key);
+	lattice.recentPosition = m_recentChunks.begin();
+	m_residentBytes += lattice.snapshot.GetByteSize();
+
+	EvictToBudget();
+}
+
+bool ChunkResidencyCache::Take(const ChunkKey& key, LatticeSnapshot& outSnapshot, size_t& outStrokeCount)
+{
+	ELatticeLocation location;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		const auto latticeIt = m_lattices.find(key);
+		if (latticeIt == m_lattices.end())
+		{
+			m_stats.misses++;
+			return false;
+		}
+
+		CachedLattice& lattice = latticeIt->second;
+		outStrokeCount = lattice.strokeCount;
+		location = lattice.location;
+		if (location == ELatticeLocation::Memory)
+		{
+			outSnapshot = std::move(lattice.snapshot);
+			m_residentBytes -= outSnapshot.GetByteSize();
+			m_recentChunks.erase(lattice.recentPosition);
+			m_lattices.erase(latticeIt);
+			m_stats.memoryHits++;
+			return true;
+		}
+
+		//The file is read and decompressed without holding the lock, other chunks of the pass keep going meanwhile
+		m_lattices.erase(latticeIt);
+	}
+
+	const bool bIsRead = ReadLattice(key, location, outSnapshot);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (bIsRead)
+		m_stats.diskHits++;
+	else
+		m_stats.misses++;
+	return bIsRead;
+}
+
+bool ChunkResidencyCache::Prefetch(const ChunkKey& key, size_t& outByteSize)
+{
+	ELatticeLocation location;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const auto latticeIt = m_lattices.find(key);
+		if (latticeIt == m_lattices.end() || latticeIt->second.location == ELatticeLocation::Memory)
+			return false;
+		location = latticeIt->second.location;
+	}
+
+	LatticeSnapshot snapshot;
+	if (!ReadLattice(key, location, snapshot))
+		return false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//Skip it if the lattice was taken or replaced while the file was read
+	const auto latticeIt = m_lattices.find(key);
+	if (latticeIt == m_lattices.end() || latticeIt->second.location != location)
+		return false;
+
+	CachedLattice& lattice = latticeIt->second;
+	lattice.snapshot = std::move(snapshot);
+	lattice.location = ELatticeLocation::Memory;
+	m_recentChunks.push_front(key);
+	lattice.recentPosition = m_recentChunks.begin();
+	outByteSize = lattice.snapshot.GetByteSize();
+	m_residentBytes += outByteSize;
+
+	EvictToBudget();
+	return true;
+}
+
+bool ChunkResidencyCache::Contains(const ChunkKey& key) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_lattices.find(key) != m_lattices.end();
+}
+
+bool ChunkResidencyCache::IsOnDisk(const ChunkKey& key) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const auto latticeIt = m_lattices.find(key);
+	return latticeIt != m_lattices.end() && latticeIt->second.location != ELatticeLocation::Memory;
+}
+
+void ChunkResidencyCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_lattices.clear();
+	m_recentChunks.clear();
+	m_residentBytes = 0;
+
+	m_worldFile.reset();
+	if (m_swapFile.IsOpen())
+	{
+		m_swapFile.Close();
+		std::remove(m_swapFilePath.c_str());
+	}
+}
+
+bool ChunkResidencyCache::OpenWorldFile(const std::string& path, const uint64_t sdfFingerprint, std::vector<BrushStroke>& outBrushStrokes)
+{
+	std::unique_ptr<VoxelWorldFile> worldFile(new VoxelWorldFile());
+	if (!worldFile->Open(path, m_layout, sdfFingerprint))
+		return false;
+
+	Clear();
+	outBrushStrokes = worldFile->GetBrushStrokes();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const VoxelChunkInfo& chunk : worldFile->GetChunks())
+	{
+		CachedLattice& lattice = m_lattices[chunk.key];
+		lattice.strokeCount = chunk.strokeCount;
+		lattice.location = ELatticeLocation::WorldFile;
+	}
+	m_worldFile = std::move(worldFile);
+	return true;
+}
+
+bool ChunkResidencyCache::ExportLattices(VoxelWorldFile& targetFile) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	bool bIsExported = true;
+	for (const auto& lattice : m_lattices)
+	{
+		switch (lattice.second.location)
+		{
+		case ELatticeLocation::Memory:
+			bIsExported &= targetFile.WriteChunk(lattice.first, lattice.second.snapshot, lattice.second.strokeCount);
+			break;
+		case ELatticeLocation::SwapFile:
+			bIsExported &= targetFile.CopyChunk(m_swapFile, lattice.first);
+			break;
+		case ELatticeLocation::WorldFile:
+			bIsExported &= targetFile.CopyChunk(*m_worldFile, lattice.first);
+			break;
+		}
+	}
+	return bIsExported;
+}
+
+bool ChunkResidencyCache::ReplaceFile(const std::string& sourcePath, const std::string& targetPath)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const bool bIsWorldFile = m_worldFile && m_worldFile->GetPath() == targetPath;
+	if (bIsWorldFile)
+		m_worldFile->Close();
+
+	//Replaced in one step, so a failed move leaves the old file in place. std::rename can't replace an existing file on
+	//Windows. The paths are narrow strings like the ones the files were opened with, hence the ANSI variant.
+#ifdef _WIN32
+	const bool bIsMoved = MoveFileExA(sourcePath.c_str(), targetPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	const bool bIsMoved = std::rename(sourcePath.c_str(), targetPath.c_str()) == 0;
+#endif
+	if (!bIsMoved)
+		std::cout << "CHUNK_RESIDENCY_CACHE::ERROR::FILE_NOT_REPLACED: " << targetPath << '\n';
+
+	if (bIsWorldFile && !m_worldFile->Open(targetPath, m_layout, m_worldFile->GetSDFFingerprint()))
+	{
+		//The chunks that were read from it are sampled from the SDF again
+		for (auto latticeIt = m_lattices.begin(); latticeIt != m_lattices.end();)
+		{
+			if (latticeIt->second.location == ELatticeLocation::WorldFile)
+				latticeIt = m_lattices.erase(latticeIt);
+			else
+				++latticeIt;
+		}
+		m_worldFile.reset();
+	}
+	return bIsMoved;
+}
+
+void ChunkResidencyCache::RecordPrefetch()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.prefetches++;
+}
+
+void ChunkResidencyCache::RecordStall(const double milliseconds)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.stalledChunks++;
+	m_stats.stallMilliseconds += milliseconds;
+}
+
+ChunkResidencyStats ChunkResidencyCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	ChunkResidencyStats stats = m_stats;
+	stats.residentBytes = m_residentBytes;
+	stats.residentChunks = m_recentChunks.size();
+	stats.diskChunks = m_lattices.size() - m_recentChunks.size();
+	return stats;
+}
+
+bool ChunkResidencyCache::ReadLattice(const ChunkKey& key, const ELatticeLocation location, LatticeSnapshot& outSnapshot) const
+{
+	size_t strokeCount = 0;
+	if (location == ELatticeLocation::WorldFile)
+		return m_worldFile->ReadChunk(key, outSnapshot, strokeCount);
+
+	const bool bIsRead = m_swapFile.ReadChunk(key, outSnapshot, strokeCount);
+	m_swapFile.RemoveChunk(key);
+	return bIsRead;
+}
+
+void ChunkResidencyCache::RemoveFromDisk(const ChunkKey& key, const CachedLattice& lattice)
+{
+	//The world file is only read, its chunks stay in it
+	if (lattice.location == ELatticeLocation::SwapFile)
+		m_swapFile.RemoveChunk(key);
+}
+
+void ChunkResidencyCache::EvictToBudget()
+{
+	while (m_residentBytes > m_memoryBudgetBytes && !m_recentChunks.empty())
+	{
+		const ChunkKey key = m_recentChunks.back();
+		CachedLattice& lattice = m_lattices[key];
+
+		//Written while holding the lock, eviction only happens when the view moves or the budget shrinks
+		//Only this cache reads the swap file back, and it is dropped along with the lattices when the SDF changes
+		if (!m_swapFile.IsOpen())
+			m_swapFile.Create(m_swapFilePath, m_layout, 0);
+		const bool bIsWritten = m_swapFile.IsOpen() && m_swapFile.WriteChunk(key, lattice.snapshot, lattice.strokeCount);
+		RemoveResident(lattice);
+
+		if (bIsWritten)
+		{
+			lattice.location = ELatticeLocation::SwapFile;
+			m_stats.evictions++;
+		}
+		else
+		{
+			//The chunk is sampled from the SDF again once it comes back
+			m_lattices.erase(key);
+		}
+	}
+}
+
+void ChunkResidencyCache::RemoveResident(CachedLattice& lattice)
+{
+	m_residentBytes -= lattice.snapshot.GetByteSize();
+	m_recentChunks.erase(lattice.recentPosition);
+	//Releases the buffers, clear() would keep their capacity
+	lattice.snapshot = LatticeSnapshot();
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DualContouring.h"
+#include "TerrainChunkManager.h"
+#include "VoxelWorldFile.h"
+
+struct ChunkResidencyStats
+{
+	//Chunks entering the clipmap whose lattice was still in memory
+	uint64_t memoryHits = 0;
+	//Chunks entering the clipmap whose lattice was read back from disk
+	uint64_t diskHits = 0;
+	//Chunks entering the clipmap that had to be sampled from the SDF
+	uint64_t misses = 0;
+	//Lattices written to disk to stay within the memory budget
+	uint64_t evictions = 0;
+	//Lattices loaded or sampled ahead of the camera
+	uint64_t prefetches = 0;
+	//Chunks a pass had to wait for, read from disk or sampled, and the time it waited
+	uint64_t stalledChunks = 0;
+	double stallMilliseconds = 0.0;
+	size_t residentBytes = 0;
+	size_t residentChunks = 0;
+	size_t diskChunks = 0;
+};
+
+//Keeps the sampled lattices of chunks that left the clipmap, so a chunk coming back restores its lattice instead of
+//sampling the SDF again. Lattices are held in memory up to a budget, beyond it the least recently used ones are written
+//to a swap file and read back when needed. A world file opened by OpenWorldFile is another source of lattices on disk,
+//its chunks are only read once they are needed.
+//Each lattice remembers how many strokes of the chunk manager's log it already contains, the rest are replayed on it.
+//Safe to call from several threads, the meshing passes take lattices in parallel.
+class ChunkResidencyCache
+{
+public:
+	//The swap file is created at swapFilePath once the first lattice is swapped out
+	ChunkResidencyCache(const std::string& swapFilePath, const VoxelWorldLayout& layout, const size_t memoryBudgetBytes);
+	//Deletes the swap file
+	~ChunkResidencyCache();
+
+	ChunkResidencyCache(const ChunkResidencyCache&) = delete;
+	ChunkResidencyCache& operator=(const ChunkResidencyCache&) = delete;
+
+	//Evicts lattices right away if the new budget is smaller
+	void SetMemoryBudget(const size_t memoryBudgetBytes);
+	//Keeps a chunk's lattice, taking over the snapshot's buffers
+	void Store(const ChunkKey& key, LatticeSnapshot& snapshot, const size_t strokeCount);
+	//Removes a chunk's lattice from the cache, reading it from disk if needed. Returns false on a miss.
+	bool Take(const ChunkKey& key, LatticeSnapshot& outSnapshot, size_t& outStrokeCount);
+	//Reads a lattice on disk into memory ahead of time, returns false if it isn't on disk
+	bool Prefetch(const ChunkKey& key, size_t& outByteSize);
+	bool Contains(const ChunkKey& key) const;
+	bool IsOnDisk(const ChunkKey& key) const;
+	//Drops every lattice and closes the world file, e.g. once the SDF changed
+	void Clear();
+
+	//Replaces the cached lattices with the chunks of a world file, which stays open to read them from. Returns false and
+	//keeps the cache as it is if the file can't be opened or was written for another SDF. The strokes the chunks' stroke
+	//counts refer to are returned.
+	bool OpenWorldFile(const std::string& path, const uint64_t sdfFingerprint, std::vector<BrushStroke>& outBrushStrokes);
+	//Writes every cached lattice to another file, lattices on disk are copied without decoding them
+	bool ExportLattices(VoxelWorldFile& targetFile) const;
+	//Moves a finished file over targetPath, if that fails the old file is kept. If that is the open world file it is
+	//reopened, so the chunks still read from it must be in the new file too.
+	bool ReplaceFile(const std::string& sourcePath, const std::string& targetPath);
+
+	void RecordPrefetch();
+	void RecordStall(const double milliseconds);
+	ChunkResidencyStats GetStats() const;
+
+private:
+	enum class ELatticeLocation : uint8_t
+	{
+		Memory,
+		SwapFile,
+		WorldFile
+	};
+
+	struct CachedLattice
+	{
+		LatticeSnapshot snapshot;
+		size_t strokeCount = 0;
+		ELatticeLocation location = ELatticeLocation::Memory;
+		//Position in m_recentChunks while in memory
+		std::list<ChunkKey>::iterator recentPosition;
+	};
+
+	//Reads a lattice from the file it is in, a swap file extent is freed for reuse
+	bool ReadLattice(const ChunkKey& key, const ELatticeLocation location, LatticeSnapshot& outSnapshot) const;
+	//Drops a lattice's copy on disk, if any. Expects m_mutex to be held.
+	void RemoveFromDisk(const ChunkKey& key, const CachedLattice& lattice);
+	//Swaps out the least recently used lattices until the resident ones fit the budget. Expects m_mutex to be held.
+	void EvictToBudget();
+	//Expects m_mutex to be held
+	void RemoveResident(CachedLattice& lattice);
+
+private:
+	std::string m_swapFilePath;
+	VoxelWorldLayout m_layout;
+	size_t m_memoryBudgetBytes = 0;
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<ChunkKey, CachedLattice, ChunkKeyHash> m_lattices;
+	//Keys of the lattices in memory, most recently used first
+	std::list<ChunkKey> m_recentChunks;
+	size_t m_residentBytes = 0;
+	ChunkResidencyStats m_stats;
+
+	//Both files guard themselves, reading them doesn't need m_mutex
+	mutable VoxelWorldFile m_swapFile;
+	std::unique_ptr<VoxelWorldFile> m_worldFile;
+};
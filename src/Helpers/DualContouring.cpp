@@ -1,27 +1,149 @@
 #include "DualContouring.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <iostream>
-#include <unordered_map>
+#include <limits>
 #include <glad/glad.h>
 #include <Helpers/Settings.h>
 #include <Actors/ACamera.h>
 #include "Shader.h"
+#include "DualContouringOctree.h"
 #include "Brushes/SphereBrush.h"
 #include "Components/USDFComponent.h"
 #include "Enums/AppEnums.h"
 #include "Math/QEFSolver.h"
 #include "Math/RNG.h"
-#include "Math/SDF.h"
+#include "Math/SDFBatch.h"
+#include "JobSystem.h"
+
+//A quad (2 triangles) takes 6 indices, or 6 duplicated vertices/colors of 3 floats each in flat shade mode
+static constexpr size_t QUAD_INDEX_COUNT = 6;
+static constexpr size_t QUAD_FLOAT_COUNT = 18;
+//Extra lattice points (in voxels) visited around a hard brush
+static constexpr float HARD_BRUSH_MARGIN_VOXELS = 2.f;
+//Voxels per axis of a lattice block, blocks the surface cannot cross are not sampled
+static constexpr int LATTICE_BLOCK_SIZE = 8;
+//Slack (in voxels) on the block pruning test for float error in the SDF evaluation
+static constexpr float LATTICE_BLOCK_PRUNE_SLACK_VOXELS = 0.01f;
+
+//Blocks sharing a lattice coordinate along one axis (the same block twice unless the coordinate is on a block boundary)
+static void GetLatticeCoordinateBlocks(const int latticeCoordinate, const int blockCount, int& outLowBlock, int& outHighBlock)
+{
+	outHighBlock = std::min(latticeCoordinate / LATTICE_BLOCK_SIZE, blockCount - 1);
+	outLowBlock = (latticeCoordinate % LATTICE_BLOCK_SIZE == 0 && latticeCoordinate > 0) ? latticeCoordinate / LATTICE_BLOCK_SIZE - 1 : outHighBlock;
+}
+
+
+struct DualContouring::LiveSDFSampleSource
+{
+	const USDFComponent& sdfComponent;
+
+	void GetEdgeCrossing(const DualContouring& dualContouring, const int latticeIndex1, const int latticeIndex2, const glm::vec3& cornerPos1, const glm::vec3& cornerPos2, glm::vec3& outPosition, glm::vec3& outNormal) const
+	{
+		const float interpolateFactor = dualContouring.GetLatticeEdgeInterpolation(latticeIndex1, latticeIndex2);
+		outPosition = cornerPos1 + ((cornerPos2 - cornerPos1) * interpolateFactor);
+
+		//Calculate normal from the analytic gradient
+		glm::vec3 gradient(0.f);
+		sdfComponent.EvaluateSDFWithGradient(outPosition, gradient);
+		outNormal = glm::normalize(gradient);
+	}
+};
+
+struct DualContouring::LatticeSampleSource
+{
+	void GetEdgeCrossing(const DualContouring& dualContouring, const int latticeIndex1, const int latticeIndex2, const glm::vec3& cornerPos1, const glm::vec3& cornerPos2, glm::vec3& outPosition, glm::vec3& outNormal) const
+	{
+		dualContouring.GetLatticeEdgeCrossing(latticeIndex1, latticeIndex2, cornerPos1, cornerPos2, outPosition, outNormal);
+	}
+};
+
+//Triangle vertex indices are float offsets into the mesh vertices
+struct DualContouring::IndexedOutput
+{
+	static constexpr bool bFlatShade = false;
+
+	static void EmitTriangle(const int vertexIndex1, const int vertexIndex2, const int vertexIndex3, const std::vector<float>& /*meshVertices*/, MeshBuffers& outBuffers)
+	{
+		outBuffers.indices.push_back(static_cast<unsigned int>(vertexIndex1 / 3));
+		outBuffers.indices.push_back(static_cast<unsigned int>(vertexIndex2 / 3));
+		outBuffers.indices.push_back(static_cast<unsigned int>(vertexIndex3 / 3));
+	}
+};
+
+//Used for glDrawArrays rather than glDrawElements, every triangle gets its own vertices and a random color
+struct DualContouring::FlatOutput
+{
+	static constexpr bool bFlatShade = true;
+
+	static void EmitTriangle(const int vertexIndex1, const int vertexIndex2, const int vertexIndex3, const std::vector<float>& meshVertices, MeshBuffers& outBuffers)
+	{
+		for (const int vertexIndex : { vertexIndex1, vertexIndex2, vertexIndex3 })
+		{
+			//Pos (pairs of 3 floats i.e. a 3D vector)
+			outBuffers.duplicateVertices.push_back(meshVertices[vertexIndex]);
+			outBuffers.duplicateVertices.push_back(meshVertices[vertexIndex + 1]);
+			outBuffers.duplicateVertices.push_back(meshVertices[vertexIndex + 2]);
+		}
+
+		//Triangle Color
+		const float triangleColorR = RNG::GetRandomFloatNumber(0.0f, 1.0f);
+		const float triangleColorG = RNG::GetRandomFloatNumber(0.0f, 1.0f);
+		const float triangleColorB = RNG::GetRandomFloatNumber(0.0f, 1.0f);
+		//Push 3 floats (vec3 color) per vertex i.e. 3 vertices
+		for (int i = 0; i < 3; ++i)
+		{
+			outBuffers.vertexColors.push_back(triangleColorR);
+			outBuffers.vertexColors.push_back(triangleColorG);
+			outBuffers.vertexColors.push_back(triangleColorB);
+		}
+	}
+};
 
 
 DualContouring::DualContouring(const unsigned int& gridWidth, const unsigned int& gridHeight,
 	const unsigned int& gridDepth, const float& voxelSize)
+	: DualContouring(glm::ivec3(static_cast<int>(static_cast<float>(gridWidth) * (1 / voxelSize)), static_cast<int>(static_cast<float>(gridHeight) * (1 / voxelSize)),
+		static_cast<int>(static_cast<float>(gridDepth) * (1 / voxelSize))), voxelSize,
+		-glm::vec3(gridWidth / 2, gridHeight / 2, gridDepth / 2), glm::ivec3(0), false)
+{
+}
+
+DualContouring::DualContouring(const glm::ivec3& voxelCount, const float& voxelSize, const glm::vec3& worldOrigin, const glm::ivec3& latticeOrigin, const bool bAlwaysUseLatticeNormals)
 {
-	this->m_gridWidth = gridWidth;
-	this->m_gridHeight= gridHeight;
-	this->m_gridDepth = gridDepth;
 	this->m_voxelResolution = voxelSize;
+	this->m_worldOrigin = worldOrigin;
+	this->m_latticeOrigin = latticeOrigin;
+	this->m_bAlwaysUseLatticeNormals = bAlwaysUseLatticeNormals;
+
+	this->m_expandedGridWidth = voxelCount.x;
+	this->m_expandedGridHeight = voxelCount.y;
+	this->m_expandedGridDepth = voxelCount.z;
+	this->m_faceVoxelMax = voxelCount - glm::ivec3(1);
+
+	//Allocate the corner lattice and dense voxel storage once, every pass afterwards only overwrites it
+	const size_t totalLatticePoints = static_cast<size_t>(m_expandedGridWidth + 1) * (m_expandedGridHeight + 1) * (m_expandedGridDepth + 1);
+	latticeDistances.assign(totalLatticePoints, 0.f);
+	latticeNormals.assign(totalLatticePoints, glm::vec3(1.f, 0.f, 0.f));
+
+	//The last block of an axis may be smaller
+	m_latticeBlockCount = glm::ivec3((m_expandedGridWidth + LATTICE_BLOCK_SIZE - 1) / LATTICE_BLOCK_SIZE,
+		(m_expandedGridHeight + LATTICE_BLOCK_SIZE - 1) / LATTICE_BLOCK_SIZE, (m_expandedGridDepth + LATTICE_BLOCK_SIZE - 1) / LATTICE_BLOCK_SIZE);
+	const size_t totalLatticeBlocks = static_cast<size_t>(m_latticeBlockCount.x) * m_latticeBlockCount.y * m_latticeBlockCount.z;
+	latticeBlockStates.assign(totalLatticeBlocks, ELatticeBlockState::Sampled);
+	latticeBlockDistanceBounds.assign(totalLatticeBlocks, 0.f);
+
+	for (int i = 0; i < 8; ++i)
+	{
+		latticeCornerOffsets[i] = GetLatticeIndex(static_cast<int>(voxelCornerOffsets[i].x), static_cast<int>(voxelCornerOffsets[i].y), static_cast<int>(voxelCornerOffsets[i].z));
+	}
+
+	const size_t totalVoxels = static_cast<size_t>(m_expandedGridWidth) * m_expandedGridHeight * m_expandedGridDepth;
+	voxelEdgeCrossings.assign(totalVoxels, VoxelEdgeCrossings{ 0, 0 });
+	voxelVertexIndices.assign(totalVoxels, -1);
+	voxelEdgeQuadSlots.assign(totalVoxels * 3, -1);
 }
 
 DualContouring::~DualContouring()
@@ -120,23 +242,14 @@ const glm::vec3 DualContouring::GetIntersectionPoint(const glm::vec3& firstPosit
 
 const glm::vec3 DualContouring::CalculateSurfaceNormal(const glm::vec3& intersectionPos, const std::weak_ptr<USDFComponent> actorSdfComponent)
 {
-	//Perform Finite Sum Difference
-	const float h = 0.001f;
-
-	const float dx =
-		actorSdfComponent.lock()->EvaluateSDF(intersectionPos + glm::vec3(h, 0.f, 0.f)) -
-		actorSdfComponent.lock()->EvaluateSDF(intersectionPos - glm::vec3(h, 0.f, 0.f));
-	const float dy =
-		actorSdfComponent.lock()->EvaluateSDF(intersectionPos + glm::vec3(0.f, h, 0.f)) -
-		actorSdfComponent.lock()->EvaluateSDF(intersectionPos - glm::vec3(0.f, h, 0.f));
-	const float dz =
-		actorSdfComponent.lock()->EvaluateSDF(intersectionPos + glm::vec3(0.f, 0.f, h)) -
-		actorSdfComponent.lock()->EvaluateSDF(intersectionPos - glm::vec3(0.f, 0.f, h));
-
-	return glm::normalize(glm::vec3(dx, dy, dz));
+	//Use the analytic gradient of the SDF, a single evaluation pass
+	glm::vec3 gradient(0.f);
+	actorSdfComponent.lock()->EvaluateSDFWithGradient(intersectionPos, gradient);
+
+	return glm::normalize(gradient);
 }
 
-void DualContouring::DebugDrawVertices(const std::vector<float>& vertices, std::weak_ptr<ACamera> curCamera, const Settings& settings)
+void DualContouring::DebugDrawVertices(const ArrayView<float> vertices, std::weak_ptr<ACamera> curCamera, const Settings& settings)
 {
 	//DEBUG: Spawn cube at vertex positions
 	if (settings.bIsDebugEnabled)
@@ -232,1259 +345,1460 @@ void DualContouring::DebugDrawVertices(const std::vector<float>& vertices, std::
 	}
 }
 
-void DualContouring::InitGenerateMesh(std::vector<float>& vertices, std::vector<float>& normals,
-	std::vector<unsigned int>& indices, std::vector<float>& colors, const std::weak_ptr<USDFComponent> actorSdfComponent, const Settings& settings)
+SharedMeshData DualContouring::InitGenerateMesh(const std::weak_ptr<USDFComponent> actorSdfComponent, const Settings& settings, const CancellationToken& cancellation)
 {
-	//Clear any index mapping data before generating mesh in case already generated the mesh
-	ClearHashMapData();
+	m_cancellation = cancellation;
 
+	const std::shared_ptr<USDFComponent> sdfComponent = actorSdfComponent.lock();
+	if (!SampleLatticeFromSDF(sdfComponent, settings))
+		return AbortCancelledMesh();
 
-	std::vector<float> modelVertices;
-	std::vector<float> modelNormals;
-	std::vector<unsigned int> modelIndices;
-	std::vector<float> modelVertexColors;
+	if (settings.bUseOctreeSimplification)
+		BuildOctreeMesh(settings);
+	else if (m_bAlwaysUseLatticeNormals)
+		GenerateMesh(LatticeSampleSource(), settings);
+	else
+		//Normals come from the SDF gradient at each crossing
+		GenerateMesh(LiveSDFSampleSource{ *sdfComponent }, settings);
 
-	std::vector<float> modelDuplicateVertices;
-	std::vector<float> modelDuplicateNormals;
+	if (IsCancelled())
+		return AbortCancelledMesh();
 
-	int expandedGridWidth = static_cast<int>(static_cast<float>(this->m_gridWidth) * (1 / this->m_voxelResolution));
-	int expandedGridHeight = static_cast<int>(static_cast<float>(this->m_gridHeight) * (1 / this->m_voxelResolution));
-	int expandedGridDepth = static_cast<int>(static_cast<float>(this->m_gridDepth) * (1 / this->m_voxelResolution));
+	//Finally assign the mesh details
+	return BuildMeshOutput(settings);
+}
 
+bool DualContouring::InitSampleLattice(const std::weak_ptr<USDFComponent> actorSdfComponent, const Settings& settings, const CancellationToken& cancellation)
+{
+	m_cancellation = cancellation;
+	const bool bIsSampled = SampleLatticeFromSDF(actorSdfComponent.lock(), settings);
+	m_cancellation = CancellationToken();
+
+	//Whatever mesh the grid held belongs to the previous lattice
+	m_bIsMeshValid = false;
+	m_bHasDirtyRegion = false;
+	return bIsSampled;
+}
 
-	glm::vec3 gridPosition(0.f, 0.f, 0.f);
+bool DualContouring::SampleLatticeFromSDF(const std::shared_ptr<USDFComponent>& sdfComponent, const Settings& settings)
+{
+	//Creates the thread pool used by the sampling passes
+	PrepareMeshSlabs(settings);
 
-	glm::mat4 gridModelMatrix(1.f);
-	gridModelMatrix = glm::translate(gridModelMatrix, gridPosition);
+	//Bring the primitive BVH and CSG program up to date before the passes below query them from multiple threads
+	sdfComponent->PrepareForEvaluation();
 
-	glm::vec3 gridCenter((this->m_gridWidth) / 2, (this->m_gridHeight) / 2, (this->m_gridDepth) / 2);
+	m_sdfComponent = sdfComponent;
+	m_bIsLatticeValid = false;
 
-	//Generate vertex positions
-	for (int x = 0; x < expandedGridWidth; x++)
-	{
-		for (int y = 0; y < expandedGridHeight; y++)
-		{
-			for (int z = 0; z < expandedGridDepth; z++)
-			{
-				//Get relative position to grid position
-				glm::vec3 relativePos((static_cast<float>(x) * this->m_voxelResolution), (static_cast<float>(y) * this->m_voxelResolution), (static_cast<float>(z) * this->m_voxelResolution));
+	//Only blocks the surface may cross are sampled and triangulated
+	ClassifyLatticeBlocks(*sdfComponent);
 
-				//Relative to grid center
-				relativePos -= gridCenter;
+	//Sample the SDF once per lattice point, voxels read their 8 corners from the shared lattice
+	SampleLattice(*sdfComponent);
 
-				//Relative to grid position
-				relativePos += gridPosition;
+	if (IsCancelled())
+		return false;
+	m_bIsLatticeValid = true;
+	return true;
+}
 
-				HermiteData defaultHermiteData{ glm::vec3(0), glm::vec3(1, 0, 0), std::numeric_limits<float>::min(), false };
+bool DualContouring::SaveLattice(LatticeSnapshot& outSnapshot) const
+{
+	if (!m_bIsLatticeValid)
+		return false;
+
+	outSnapshot.distances = latticeDistances;
+	outSnapshot.normals = latticeNormals;
+	outSnapshot.blockStates = latticeBlockStates;
+	outSnapshot.blockDistanceBounds = latticeBlockDistanceBounds;
+	return true;
+}
 
-				//Array describing hermite data for 8 corners per voxel
-				std::array<HermiteData, 8> voxelCornersHermiteData
-				{
-					{
-						defaultHermiteData,
-						defaultHermiteData,
-						defaultHermiteData,
-						defaultHermiteData,
-						defaultHermiteData,
-						defaultHermiteData,
-						defaultHermiteData,
-						defaultHermiteData,
-					}
-				};
+bool DualContouring::RestoreLattice(LatticeSnapshot& snapshot, const std::weak_ptr<USDFComponent> actorSdfComponent)
+{
+	if (snapshot.distances.size() != latticeDistances.size() || snapshot.normals.size() != latticeNormals.size()
+		|| snapshot.blockStates.size() != latticeBlockStates.size() || snapshot.blockDistanceBounds.size() != latticeBlockDistanceBounds.size())
+		return false;
+
+	//Swapping keeps the snapshot from being copied, it is left with the grid's old buffers
+	latticeDistances.swap(snapshot.distances);
+	latticeNormals.swap(snapshot.normals);
+	latticeBlockStates.swap(snapshot.blockStates);
+	latticeBlockDistanceBounds.swap(snapshot.blockDistanceBounds);
+
+	//Pruned blocks are still sampled from the SDF once a brush reaches them
+	m_sdfComponent = actorSdfComponent;
+	m_bIsLatticeValid = true;
+	m_bIsMeshValid = false;
+	m_bHasDirtyRegion = false;
+	return true;
+}
 
-				//Go over each corner
-				{
-					int cornersToConsider = 0;
-					std::array<float, 8> cornerSDFValues;
+SharedMeshData DualContouring::UpdateMesh(const Settings& settings, const CancellationToken& cancellation)
+{
+	//A cancelled generation left the lattice partially sampled, only the SDF can restore it
+	if (!m_bIsLatticeValid)
+		return m_sdfComponent.expired() ? nullptr : InitGenerateMesh(m_sdfComponent, settings, cancellation);
 
-					for (int i = 0; i < 8; ++i)
-					{
-						//Get current corner's position in world space
-						glm::vec3 currentCornerPos = (voxelCornerOffsets[i] * this->m_voxelResolution) + relativePos;
+	m_cancellation = cancellation;
 
-						//Calculate signed distance of current corner
-						float distanceValue = actorSdfComponent.lock()->EvaluateSDF(currentCornerPos);
-						cornerSDFValues[i] = distanceValue;
+	//The existing mesh can only be patched if it was built with the same shading mode
+	const bool bCanPatchMesh = settings.bUseIncrementalRemesh && m_bIsMeshValid && (m_bIsMeshFlatShaded == settings.bShouldFlatShade);
 
-						//Store corner hermite data 
-						HermiteData cornerHermiteData;
-						cornerHermiteData.distance = distanceValue;
-						cornerHermiteData.position = currentCornerPos;
-						cornerHermiteData.normal = CalculateSurfaceNormal(currentCornerPos, actorSdfComponent);
+	if (settings.bUseOctreeSimplification)
+	{
+		//Collapsed cells can span the whole grid, so the octree is always rebuilt
+		BuildOctreeMesh(settings);
+	}
+	else if (bCanPatchMesh)
+	{
+		//Only re-solve the region touched by brush edits since the last update
+		if (m_bHasDirtyRegion && m_bIsMeshFlatShaded)
+			RemeshDirtyRegion<FlatOutput>();
+		else if (m_bHasDirtyRegion)
+			RemeshDirtyRegion<IndexedOutput>();
+	}
+	else
+	{
+		//Normals are interpolated from the cached lattice normals
+		GenerateMesh(LatticeSampleSource(), settings);
+	}
 
-						voxelCornersHermiteData[i] = cornerHermiteData;
+	if (IsCancelled())
+		return AbortCancelledMesh();
 
+	//Finally assign the mesh details
+	return BuildMeshOutput(settings);
+}
 
-						//TODO: convert position from grid relative to SDF center relative
-						//If within the surface, consider for triangulation
-						if (distanceValue <= 0.f)
-						{
-							cornersToConsider |= 1 << i;
-						}
-					}
+template<typename SampleSource>
+void DualContouring::GenerateMesh(const SampleSource& sampleSource, const Settings& settings)
+{
+	//Pick the output mode once, the passes below are specialised for it
+	if (settings.bShouldFlatShade)
+		GenerateVoxelMesh<SampleSource, FlatOutput>(sampleSource, settings);
+	else
+		GenerateVoxelMesh<SampleSource, IndexedOutput>(sampleSource, settings);
+}
 
-					//Store the corner hermite data in a map
-					voxelToCornerHermiteDataMap[GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)] = voxelCornersHermiteData;
+template<typename SampleSource, typename OutputMode>
+void DualContouring::GenerateVoxelMesh(const SampleSource& sampleSource, const Settings& settings)
+{
+	ClearVoxelMeshData();
 
-					//If the voxel is completely within the surface, or outside the volume, ignore it.
-					if (cornersToConsider == 0 || cornersToConsider == 255)
-						continue;
+	//Split the grid into x-slabs, one task per slab
+	PrepareMeshSlabs(settings);
 
-					std::vector<glm::vec3> intersectionPoints;
-					std::vector<glm::vec3> intersectionNormals;
+	const int expandedGridHeight = this->m_expandedGridHeight;
+	const int expandedGridDepth = this->m_expandedGridDepth;
 
-					//Array describing hermite data for 3 edges per voxel
-					std::array<HermiteData, 3> adjacentEdgeHermiteData
-					{
-						{
-							defaultHermiteData,
-							defaultHermiteData,
-							defaultHermiteData,
-						}
-					};
+	//Generate vertex positions, each slab appends to its own buffers and stores slab-local vertex indices
+	JobSystem::GetShared().ParallelFor(static_cast<int>(m_meshSlabs.size()), [&](const int slabIndex)
+	{
+		MeshSlab& slab = m_meshSlabs[slabIndex];
+		std::vector<float>& modelVertices = slab.buffers.vertices;
+		std::vector<float>& modelNormals = slab.buffers.normals;
 
-					//Vector containing hermite data for all 12 edges per voxel, used for computing vertex position
-					std::vector<HermiteData> allEdgeHermiteData;
+		//Vertex positions are solved a batch of voxels at a time
+		QEFBatch vertexBatch;
 
-					//If none of the 3 adjacent edges have an intersection, set flag. By default true.
-					bool bNoIntersectionFor3AdjacentEdges = true;
+		for (int x = slab.xBegin; x < slab.xEnd && !IsCancelled(); x++)
+		{
+			for (int y = 0; y < expandedGridHeight; y++)
+			{
+				for (int z = 0; z < expandedGridDepth; z++)
+				{
+					QEFData qef;
+					glm::vec3 pointsMin(0.f);
+					glm::vec3 pointsMax(0.f);
+					glm::vec3 vertexNormal(0.f);
+					VoxelEdgeCrossings adjacentEdgeCrossings{ 0, 0 };
 
-					for (int i = 0; i < 12; ++i)
-					{
-						const int cornerIndex1 = edgePairs[i].first;
-						const int cornerIndex2 = edgePairs[i].second;
+					//Skip this voxel because it is completely inside/outside the surface
+					if (!IsVoxelBlockSampled(x, y, z) || !AccumulateVoxelQEF(sampleSource, x, y, z, qef, pointsMin, pointsMax, vertexNormal, adjacentEdgeCrossings))
+						continue;
 
+					const int voxelIndex = GetUniqueIndexForGrid(x, y, z, m_expandedGridWidth, m_expandedGridHeight);
 
-						const int m1 = (cornersToConsider >> cornerIndex1) & 1;
-						const int m2 = (cornersToConsider >> cornerIndex2) & 1;
+					//Store the sign changes of the 3 adjacent edges
+					voxelEdgeCrossings[voxelIndex] = adjacentEdgeCrossings;
 
-						//This means that the edge has no crossing over from one sign to the other, skip.
-						if (m1 == m2)
-						{
-							continue;
-						}
+					//Map voxel to vertex array index position
+					const int vertexIndex = static_cast<int>(modelVertices.size());
+					voxelVertexIndices[voxelIndex] = vertexIndex;
 
+					//Reserve the vertex position, it is filled in when the batch is solved
+					modelVertices.resize(modelVertices.size() + 3);
 
-						//Find position along the edge where surface crosses signs
+					//Store model normals
+					modelNormals.push_back(vertexNormal.x);
+					modelNormals.push_back(vertexNormal.y);
+					modelNormals.push_back(vertexNormal.z);
 
-						//TODO: convert position from grid relative to SDF center relative
-						const glm::vec3 cornerPos1 = (voxelCornerOffsets[cornerIndex1] * (this->m_voxelResolution)) + relativePos;
-						const glm::vec3 cornerPos2 = (voxelCornerOffsets[cornerIndex2] * (this->m_voxelResolution)) + relativePos;
+					vertexBatch.Add(qef, pointsMin, pointsMax, vertexIndex);
+					if (vertexBatch.IsFull())
+						SolveVertexBatch(vertexBatch, modelVertices);
+				}
+			}
+		}
 
-						//Get current intersection point by using linear interpolation
-						float interpolateFactor = abs(cornerSDFValues[cornerIndex1]) / (abs(cornerSDFValues[cornerIndex1]) + abs(cornerSDFValues[cornerIndex2]));
-						interpolateFactor = glm::clamp(interpolateFactor, 0.0f, 1.0f);
+		SolveVertexBatch(vertexBatch, modelVertices);
+	}, m_meshingThreadCount);
 
-						glm::vec3 currIntersectionPoint = cornerPos1 + ((cornerPos2 - cornerPos1) * interpolateFactor);
+	if (IsCancelled())
+		return;
 
-						intersectionPoints.push_back(currIntersectionPoint);
+	//Concatenate slab vertices in slab order and make voxel vertex indices global
+	MergeSlabVertices();
 
-						//Calculate normal using Finite Sum Difference
-						const glm::vec3 intersectionNormal = CalculateSurfaceNormal(currIntersectionPoint, actorSdfComponent);
-						intersectionNormals.push_back(intersectionNormal);
+	//Iterate through the cubes again, and make the edge connections
+	EmitAllFaces<OutputMode>();
+}
 
-						//Crossing over has occured, check if edge is one of the 3 adjacent left most corner ones, and set the value.
-						if (i == 0)
-						{
-							////Mark intersection occurred 
+template<typename OutputMode>
+void DualContouring::RemeshDirtyRegion()
+{
+	const glm::ivec3 gridMin(0);
+	const glm::ivec3 gridMax(m_expandedGridWidth - 1, m_expandedGridHeight - 1, m_expandedGridDepth - 1);
 
-							adjacentEdgeHermiteData[0].distance = actorSdfComponent.lock()->EvaluateSDF(currIntersectionPoint);
-							adjacentEdgeHermiteData[0].normal = intersectionNormal;
-							adjacentEdgeHermiteData[0].position = currIntersectionPoint;
-							adjacentEdgeHermiteData[0].bIntersecPosToNeg = (m1 < m2);
+	//Voxels that have a dirty lattice point as one of their corners need their vertex re-solved
+	const glm::ivec3 vertexRegionMin = glm::clamp(m_dirtyLatticeMin - glm::ivec3(1), gridMin, gridMax);
+	const glm::ivec3 vertexRegionMax = glm::clamp(m_dirtyLatticeMax, gridMin, gridMax);
+	//A face joins a voxel with its -1 neighbours, so faces one cell further out can reference a re-solved vertex
+	const glm::ivec3 faceRegionMax = glm::clamp(vertexRegionMax + glm::ivec3(1), gridMin, gridMax);
 
-							bNoIntersectionFor3AdjacentEdges = false;
+	//Remove the old faces of the region
+	for (int x = vertexRegionMin.x; x <= faceRegionMax.x; x++)
+	{
+		for (int y = vertexRegionMin.y; y <= faceRegionMax.y; y++)
+		{
+			for (int z = vertexRegionMin.z; z <= faceRegionMax.z; z++)
+			{
+				const int voxelIndex = GetUniqueIndexForGrid(x, y, z, m_expandedGridWidth, m_expandedGridHeight);
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const int quadSlot = voxelEdgeQuadSlots[voxelIndex * 3 + axis];
+					if (quadSlot >= 0)
+						RemoveQuad(quadSlot);
+				}
+			}
+		}
+	}
 
-						}
-						else if (i == 3)
-						{
-							//Mark intersection occurred 
+	//Re-solve the vertices of the region, freed vertex slots are reused
+	QEFBatch vertexBatch;
 
-							adjacentEdgeHermiteData[1].distance = actorSdfComponent.lock()->EvaluateSDF(currIntersectionPoint);
-							adjacentEdgeHermiteData[1].normal = intersectionNormal;
-							adjacentEdgeHermiteData[1].position = currIntersectionPoint;
-							adjacentEdgeHermiteData[1].bIntersecPosToNeg = (m1 < m2);
+	for (int x = vertexRegionMin.x; x <= vertexRegionMax.x; x++)
+	{
+		for (int y = vertexRegionMin.y; y <= vertexRegionMax.y; y++)
+		{
+			for (int z = vertexRegionMin.z; z <= vertexRegionMax.z; z++)
+			{
+				const int voxelIndex = GetUniqueIndexForGrid(x, y, z, m_expandedGridWidth, m_expandedGridHeight);
 
-							bNoIntersectionFor3AdjacentEdges = false;
+				int& vertexIndex = voxelVertexIndices[voxelIndex];
+				if (vertexIndex >= 0)
+				{
+					m_freeVertexSlots.push_back(vertexIndex);
+					vertexIndex = -1;
+				}
 
-						}
-						else if (i == 8)
-						{
-							//Mark intersection occurred 
+				QEFData qef;
+				glm::vec3 pointsMin(0.f);
+				glm::vec3 pointsMax(0.f);
+				glm::vec3 vertexNormal(0.f);
+				VoxelEdgeCrossings adjacentEdgeCrossings{ 0, 0 };
+				const bool bHasVertex = AccumulateVoxelQEF(LatticeSampleSource(), x, y, z, qef, pointsMin, pointsMax, vertexNormal, adjacentEdgeCrossings);
 
-							adjacentEdgeHermiteData[2].distance = actorSdfComponent.lock()->EvaluateSDF(currIntersectionPoint);
-							adjacentEdgeHermiteData[2].normal = intersectionNormal;
-							adjacentEdgeHermiteData[2].position = currIntersectionPoint;
-							adjacentEdgeHermiteData[2].bIntersecPosToNeg = (m1 < m2);
+				voxelEdgeCrossings[voxelIndex] = adjacentEdgeCrossings;
 
-							bNoIntersectionFor3AdjacentEdges = false;
+				if (!bHasVertex)
+					continue;
 
-						}
+				if (!m_freeVertexSlots.empty())
+				{
+					vertexIndex = m_freeVertexSlots.back();
+					m_freeVertexSlots.pop_back();
+				}
+				else
+				{
+					vertexIndex = static_cast<int>(m_mesh.vertices.size());
+					m_mesh.vertices.resize(m_mesh.vertices.size() + 3);
+					m_mesh.normals.resize(m_mesh.normals.size() + 3);
+				}
+				m_patchedVertices.push_back(vertexIndex / 3);
 
+				m_mesh.normals[vertexIndex] = vertexNormal.x;
+				m_mesh.normals[vertexIndex + 1] = vertexNormal.y;
+				m_mesh.normals[vertexIndex + 2] = vertexNormal.z;
 
-						//Store hermite info of an edge
-						allEdgeHermiteData.push_back(
-							{ currIntersectionPoint, intersectionNormal, actorSdfComponent.lock()->EvaluateSDF(currIntersectionPoint), (m1 < m2)
-							}
-						);
+				vertexBatch.Add(qef, pointsMin, pointsMax, vertexIndex);
+				if (vertexBatch.IsFull())
+					SolveVertexBatch(vertexBatch, m_mesh.vertices);
+			}
+		}
+	}
 
-					}
+	SolveVertexBatch(vertexBatch, m_mesh.vertices);
 
-					//In the case there is an intersection for any of the 3 adjacent edges, map the voxel to the adjacent edges, else don't.
-					if (!bNoIntersectionFor3AdjacentEdges)
-					{
-						//Map voxel to adjacent edges hermite data array
-						voxelToEdgesHermiteDataMap[GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)] = adjacentEdgeHermiteData;
-					}
+	//Re-emit the faces of the region and append them to the mesh
+	MeshBuffers& regionFaces = m_regionFaceBuffers;
+	regionFaces.Clear();
 
-					//Calculate the best vertex using Quadratic error function
-					glm::vec3 vertexPos(0.f);
-					vertexPos = QEFSolver::ComputeBestVertexPosition(allEdgeHermiteData);
+	for (int x = vertexRegionMin.x; x <= faceRegionMax.x; x++)
+	{
+		for (int y = vertexRegionMin.y; y <= faceRegionMax.y; y++)
+		{
+			for (int z = vertexRegionMin.z; z <= faceRegionMax.z; z++)
+			{
+				EmitVoxelFaces<OutputMode>(x, y, z, m_mesh.vertices, regionFaces);
+			}
+		}
+	}
 
-					//Calculate centroid of intersection normals
-					glm::vec3 vertexNormal(0.f);
-					for (const glm::vec3& normal : intersectionNormals)
-						vertexNormal += normal;
+	const int firstAppendedQuad = static_cast<int>(m_mesh.quadOwners.size());
+	AppendQuads(regionFaces);
+	for (int quadSlot = firstAppendedQuad; quadSlot < static_cast<int>(m_mesh.quadOwners.size()); ++quadSlot)
+	{
+		m_patchedQuads.push_back(quadSlot);
+	}
 
-					vertexNormal = glm::normalize(vertexNormal);
+	m_bHasDirtyRegion = false;
+}
 
-					if (allEdgeHermiteData.empty())
-					{
-						std::cout << ".";
-					}
+float DualContouring::GetLatticeEdgeInterpolation(const int latticeIndex1, const int latticeIndex2) const
+{
+	const float corner1Distance = latticeDistances[latticeIndex1];
+	const float corner2Distance = latticeDistances[latticeIndex2];
 
-					//SANITY CHECK: CHECK IF CURRENT UNIQUE ID HAS ALREADY BEEN SET FOR VOXEL-VERTEX MAP
-					if (voxelVertexIndexMap.find(GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)) != voxelVertexIndexMap.end())
-					{
-						std::cout << "ERROR: THIS UNIQUE ID HAS ALREADY BEEN SET\n";
-					}
+	const float interpolateFactor = abs(corner1Distance) / (abs(corner1Distance) + abs(corner2Distance));
+	return glm::clamp(interpolateFactor, 0.0f, 1.0f);
+}
 
-					//Map voxel to vertex array index position
-					voxelVertexIndexMap[GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)] = static_cast<int>(modelVertices.size());
+void DualContouring::GetLatticeEdgeCrossing(const int latticeIndex1, const int latticeIndex2, const glm::vec3& cornerPos1, const glm::vec3& cornerPos2, glm::vec3& outPosition, glm::vec3& outNormal) const
+{
+	const float interpolateFactor = GetLatticeEdgeInterpolation(latticeIndex1, latticeIndex2);
 
-					//std::cout << "New Vertex: " << modelVertices.size() / 3<<", ";
+	outPosition = cornerPos1 + ((cornerPos2 - cornerPos1) * interpolateFactor);
 
-					//Store vertex position relative to grid space
-					modelVertices.push_back(vertexPos.x);
-					modelVertices.push_back(vertexPos.y);
-					modelVertices.push_back(vertexPos.z);
+	//Calculate normal by using linear interpolation
+	outNormal = glm::normalize(glm::mix(latticeNormals[latticeIndex1], latticeNormals[latticeIndex2], interpolateFactor));
+}
 
-					//std::cout << "Vertex added, model vertices size" << modelVertices.size();
+template<typename SampleSource>
+bool DualContouring::AccumulateVoxelQEF(const SampleSource& sampleSource, const int x, const int y, const int z, QEFData& qef, glm::vec3& pointsMin, glm::vec3& pointsMax, glm::vec3& vertexNormal, VoxelEdgeCrossings& adjacentEdgeCrossings) const
+{
+	const int latticeIndex = GetLatticeIndex(x, y, z);
 
-					//Store model normals
-					modelNormals.push_back(vertexNormal.x);
-					modelNormals.push_back(vertexNormal.y);
-					modelNormals.push_back(vertexNormal.z);
+	//Get relative position to grid position
+	const glm::vec3 relativePos = GetVoxelPosition(x, y, z);
 
+	int cornersToConsider = 0;
 
-				}
-			}
+	//Check if voxel is completely inside or outside the surface
+	for (int idx = 0; idx < 8; ++idx)
+	{
+		//If within the surface, consider for triangulation
+		if (latticeDistances[latticeIndex + latticeCornerOffsets[idx]] <= 0.f)
+		{
+			cornersToConsider |= 1 << idx;
 		}
 	}
 
+	//Skip this voxel because it is completely inside/outside the surface
+	if (cornersToConsider == 0 || cornersToConsider == 255)
+		return false;
 
-	//Iterate through the cubes again, and make the edge connections
-	for (int x = 0; x < expandedGridWidth; x++)
+
+	//Sign changes of the 3 adjacent edges of this voxel
+	adjacentEdgeCrossings = VoxelEdgeCrossings{ 0, 0 };
+
+	//Hermite data of all crossing edges, accumulated into a fixed-size QEF for computing the vertex position
+	qef = QEFData();
+	glm::vec3 intersectionNormalSum(0.f);
+	pointsMin = glm::vec3(std::numeric_limits<float>::max());
+	pointsMax = glm::vec3(-std::numeric_limits<float>::max());
+
+	for (int i = 0; i < 12; ++i)
 	{
-		for (int y = 0; y < expandedGridHeight; y++)
-		{
-			for (int z = 0; z < expandedGridDepth; z++)
-			{
-				//Check if there is no mapping, then no intersections for that voxel's 3 adjacent edges. Skip.
-				if (voxelToEdgesHermiteDataMap.find(GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)) == voxelToEdgesHermiteDataMap.end())
-				{
-					continue;
-				}
+		const int cornerIndex1 = edgePairs[i].first;
+		const int cornerIndex2 = edgePairs[i].second;
 
+		const int m1 = (cornersToConsider >> cornerIndex1) & 1;
+		const int m2 = (cornersToConsider >> cornerIndex2) & 1;
 
-				const std::array<HermiteData, 3> adjacentEdgesIntersection = voxelToEdgesHermiteDataMap[
-					GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)];
+		//This means that the edge has no crossing over from one sign to the other, skip.
+		if (m1 == m2)
+		{
+			continue;
+		}
 
+		const glm::vec3 cornerPos1 = (voxelCornerOffsets[cornerIndex1] * this->m_voxelResolution) + relativePos;
+		const glm::vec3 cornerPos2 = (voxelCornerOffsets[cornerIndex2] * this->m_voxelResolution) + relativePos;
 
-				//Iterate over adjacent edges and make connections where possible
-				for (int axis = 0; axis < 3; ++axis)
-				{
-					//For an edge, check if an intersection exists and all 4 neighboring voxels are valid
-					if (adjacentEdgesIntersection[axis].distance != std::numeric_limits<float>::min() && ((x - 1) > 0 && (y - 1) > 0 && (z - 1) > 0))
-					{
+		glm::vec3 currIntersectionPoint;
+		glm::vec3 intersectionNormal;
+		sampleSource.GetEdgeCrossing(*this, latticeIndex + latticeCornerOffsets[cornerIndex1], latticeIndex + latticeCornerOffsets[cornerIndex2], cornerPos1, cornerPos2, currIntersectionPoint, intersectionNormal);
 
-						std::vector<unsigned int> vertexIndices;
-						std::vector<unsigned int> actualVertexIndices;
+		//Crossing over has occured, check if edge is one of the 3 adjacent left most corner ones, and mark it.
+		const int adjacentEdge = (i == 0) ? 0 : (i == 3) ? 1 : (i == 8) ? 2 : -1;
+		if (adjacentEdge != -1)
+		{
+			adjacentEdgeCrossings.crossingMask |= 1 << adjacentEdge;
+			if (m1 < m2) adjacentEdgeCrossings.posToNegMask |= 1 << adjacentEdge;
+		}
 
-						//Store vertex indices for neighboring voxels
-						for (int i = 0; i < 4; ++i)
-						{
-							int curX = x + static_cast<int>(adjacentVoxelsOffsets[axis][i].x);
-							int curY = y + static_cast<int>(adjacentVoxelsOffsets[axis][i].y);
-							int curZ = z + static_cast<int>(adjacentVoxelsOffsets[axis][i].z);
 
-							auto it = voxelVertexIndexMap.find(GetUniqueIndexForGrid(curX, curY, curZ, expandedGridWidth, expandedGridHeight));
+		//Store hermite info of an edge
+		qef.Add(currIntersectionPoint, intersectionNormal);
+		intersectionNormalSum += intersectionNormal;
+		pointsMin = glm::min(pointsMin, currIntersectionPoint);
+		pointsMax = glm::max(pointsMax, currIntersectionPoint);
+	}
 
-							if (it == voxelVertexIndexMap.end())
-								continue;  // If voxel is missing, just skip it
+	//Calculate centroid of intersection normals
+	vertexNormal = glm::normalize(intersectionNormalSum);
 
-							// Store the found vertex index
-							vertexIndices.push_back(it->second / 3);
-							actualVertexIndices.push_back(it->second);
-						}
+	return true;
+}
 
+void DualContouring::SolveVertexBatch(QEFBatch& batch, std::vector<float>& meshVertices)
+{
+	QEFSolver::SolveBatch(batch);
 
-						// If we have fewer than 4 valid neighbors, we cannot form a face
-						if (vertexIndices.size() <= 3)
-						{
-							continue;
-						}
-						//Join all 4 vertices in those voxels
-						if (vertexIndices.size() == 4)
-						{
+	for (int i = 0; i < batch.count; ++i)
+	{
+		const glm::vec3& vertexPos = batch.positions[i];
+		meshVertices[batch.targets[i]] = vertexPos.x;
+		meshVertices[batch.targets[i] + 1] = vertexPos.y;
+		meshVertices[batch.targets[i] + 2] = vertexPos.z;
+	}
 
-							//If the transition is from + to -ve 
-							if (adjacentEdgesIntersection[axis].bIntersecPosToNeg == true)
-							{
+	batch.count = 0;
+}
 
-								//Triangle 1
-
-								// enable duplicate vertices || //Used for glDrawArrays rather than glDrawElements
-								if (settings.bShouldFlatShade)
-								{
-									//Pos 1 (pairs of 3 floats i.e. a 3D vector)
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 2]);
-
-									//Pos 2
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3] + 2]);
-
-									//Pos 3
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 2]);
-
-									//Similarly, push duplicate normals
-									//Normal 1
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 2]);
-
-									////Normal 2
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3] + 2]);
-
-									////Normal 3
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 2]);
-
-
-									//Triangle 1 Color
-									float triangleColorR = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorG = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorB = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									//Push 3 floats (vec3 color) per vertex i.e. 3 vertices
-									for (int i = 0; i < 3; ++i)
-									{
-										modelVertexColors.push_back(triangleColorR);
-										modelVertexColors.push_back(triangleColorG);
-										modelVertexColors.push_back(triangleColorB);
-										
-									}
-
-								}
-								else // utilize indexing to render vertices
-								{
-									modelIndices.push_back(vertexIndices[1]);
-									modelIndices.push_back(vertexIndices[3]);
-									modelIndices.push_back(vertexIndices[2]);
-								}
-
-
-								//Triangle 2
-
-								/*modelIndices.push_back(vertexIndices[0]);
-								modelIndices.push_back(vertexIndices[1]);
-								modelIndices.push_back(vertexIndices[2]);*/
-								/*	modelDuplicateVertices.push_back(modelVertices[vertexIndices[0]]);
-									modelDuplicateVertices.push_back(modelVertices[vertexIndices[1]]);
-									modelDuplicateVertices.push_back(modelVertices[vertexIndices[2]]);*/
-
-									// enable duplicate vertices || //Used for glDrawArrays rather than glDrawElements
-								if (settings.bShouldFlatShade)
-								{
-
-									//Pos 1 (pairs of 3 floats i.e. a 3D vector)
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0] + 2]);
-
-									//Pos 2
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 2]);
-
-									//Pos 3
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 2]);
-
-									//Similarly, push duplicate normals
-									//Normal 1
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0] + 2]);
-
-									////Normal 2
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 2]);
-
-									////Normal 3
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 2]);
-
-									float triangleColorR = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorG = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorB = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									//Push 3 floats (vec3 color) per vertex i.e. 3 vertices
-									for (int i = 0; i < 3; ++i)
-									{
-										modelVertexColors.push_back(triangleColorR);
-										modelVertexColors.push_back(triangleColorG);
-										modelVertexColors.push_back(triangleColorB);
-
-									}
-
-								}
-								else // utilize indexing to render vertices
-								{
-									modelIndices.push_back(vertexIndices[0]);
-									modelIndices.push_back(vertexIndices[1]);
-									modelIndices.push_back(vertexIndices[2]);
-								}
+void DualContouring::BuildOctreeMesh(const Settings& settings)
+{
+	ClearVoxelMeshData();
+	m_mesh.Clear();
 
-							}
-							else //Reverse indices order otherwise (-ve to +ve transition)
-							{
-								////Triangle 1
-								//modelIndices.push_back(vertexIndices[1]);
-								//modelIndices.push_back(vertexIndices[2]);
-								//modelIndices.push_back(vertexIndices[3]);
-
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[1]]);/*
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[2]]);
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[3]]);*/
-
-								// enable duplicate vertices || //Used for glDrawArrays rather than glDrawElements
-								if (settings.bShouldFlatShade)
-								{
-
-									//Pos 1 (pairs of 3 floats i.e. a 3D vector)
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 2]);
-
-									//Pos 2
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 2]);
-
-									//Pos 3
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3] + 2]);
-
-									//Similarly, push duplicate normals
-									//Normal 1
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 2]);
-
-									////Normal 2
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 2]);
-
-									////Normal 3
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3] + 2]);
-
-									float triangleColorR = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorG = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorB = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									//Push 3 floats (vec3 color) per vertex i.e. 3 vertices
-									for (int i = 0; i < 3; ++i)
-									{
-										modelVertexColors.push_back(triangleColorR);
-										modelVertexColors.push_back(triangleColorG);
-										modelVertexColors.push_back(triangleColorB);
-
-									}
-
-
-								}
-								else // utilize indexing to render vertices
-								{
-									modelIndices.push_back(vertexIndices[1]);
-									modelIndices.push_back(vertexIndices[2]);
-									modelIndices.push_back(vertexIndices[3]);
-								}
-
-								//Triangle 2
-								/*modelIndices.push_back(vertexIndices[0]);
-								modelIndices.push_back(vertexIndices[2]);
-								modelIndices.push_back(vertexIndices[1]);*/
-
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[0]]);/*
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[2]]);
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[1]]);*/
-
-								// enable duplicate vertices || //Used for glDrawArrays rather than glDrawElements
-								if (settings.bShouldFlatShade)
-								{
-
-									//Pos 1 (pairs of 3 floats i.e. a 3D vector)
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0] + 2]);
-
-									//Pos 2
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 2]);
-
-									//Pos 3
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 2]);
-
-									//Similarly, push duplicate normals
-									//Normal 1
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0] + 2]);
-
-									////Normal 2
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 2]);
-
-									////Normal 3
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 2]);
-
-									float triangleColorR = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorG = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorB = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									//Push 3 floats (vec3 color) per vertex i.e. 3 vertices
-									for (int i = 0; i < 3; ++i)
-									{
-										modelVertexColors.push_back(triangleColorR);
-										modelVertexColors.push_back(triangleColorG);
-										modelVertexColors.push_back(triangleColorB);
-
-									}
-
-
-								}
-								else // utilize indexing to render vertices
-								{
-									modelIndices.push_back(vertexIndices[0]);
-									modelIndices.push_back(vertexIndices[2]);
-									modelIndices.push_back(vertexIndices[1]);
-								}
-							}
+	if (!m_octree)
+		m_octree = std::make_unique<DualContouringOctree>();
 
-						}
+	//Voxels around the border of the face range stay leaves. Neighbouring grids solve the same vertices for the voxels they
+	//share, and the skirts are hung from the border voxels like on the uniform grid.
+	const glm::ivec3 collapseVoxelMin = m_faceVoxelMin + glm::ivec3(1);
+	const glm::ivec3 collapseVoxelMax = m_faceVoxelMax - glm::ivec3(2);
 
-					}
-				}
+	m_octree->Build(glm::ivec3(m_expandedGridWidth, m_expandedGridHeight, m_expandedGridDepth), collapseVoxelMin, collapseVoxelMax, settings.octreeErrorTolerance,
+		[&](const glm::ivec3& voxel, OctreeLeafData& outLeaf) { return SolveOctreeLeaf(voxel, outLeaf); });
+	m_octree->EmitMesh(settings.bShouldFlatShade, m_faceVoxelMin, m_faceVoxelMax, m_mesh);
+
+	//Octree corners of the voxel's x, z and y edges starting at corner 0, in the order of the adjacent edge bits
+	static const std::array<int, 3> adjacentEdgeEndCorners = { 4, 1, 2 };
 
+	//AppendSkirts looks up the vertices and adjacent edge crossings of the uncollapsed border voxels
+	for (const OctreeNode& node : m_octree->GetNodes())
+	{
+		if (node.type != EOctreeNodeType::Leaf)
+			continue;
 
+		const int voxelIndex = GetUniqueIndexForGrid(node.min.x, node.min.y, node.min.z, m_expandedGridWidth, m_expandedGridHeight);
+		voxelVertexIndices[voxelIndex] = node.vertexIndex * 3;
 
+		const int m1 = node.corners & 1;
+		for (int adjacentEdge = 0; adjacentEdge < 3; ++adjacentEdge)
+		{
+			const int m2 = (node.corners >> adjacentEdgeEndCorners[adjacentEdge]) & 1;
+			if (m1 == m2)
+				continue;
 
-			}
+			voxelEdgeCrossings[voxelIndex].crossingMask |= 1 << adjacentEdge;
+			if (m1 < m2) voxelEdgeCrossings[voxelIndex].posToNegMask |= 1 << adjacentEdge;
 		}
 	}
 
-	//Finally assign the mesh details
+	//Octree faces are not owned by voxel edges, so the mesh can not be patched by incremental updates
+	m_bIsMeshFlatShaded = settings.bShouldFlatShade;
+	m_bIsMeshValid = false;
+}
 
-	//Set vertices to duplicate mode or indices mode
-	vertices = (settings.bShouldFlatShade) ? modelDuplicateVertices : modelVertices;
-	normals = (settings.bShouldFlatShade) ? modelDuplicateNormals : modelNormals;
-	indices = modelIndices;
-	colors = modelVertexColors;
+bool DualContouring::SolveOctreeLeaf(const glm::ivec3& voxel, OctreeLeafData& outLeaf) const
+{
+	//The surface does not cross pruned blocks
+	if (!IsVoxelBlockSampled(voxel.x, voxel.y, voxel.z))
+		return false;
 
+	std::array<int, 8> cornerLatticeIndices;
+	outLeaf.corners = 0;
 
-}
+	for (int i = 0; i < 8; ++i)
+	{
+		const glm::ivec3 corner = voxel + DualContouringOctree::cornerOffsets[i];
+		cornerLatticeIndices[i] = GetLatticeIndex(corner.x, corner.y, corner.z);
 
-void DualContouring::UpdateMesh(std::vector<float>& vertices, std::vector<float>& normals,
-	std::vector<unsigned int>& indices, std::vector<float>& colors, const Settings& settings)
-{
-	ClearHashMapData();
+		//If within the surface, consider for triangulation
+		if (latticeDistances[cornerLatticeIndices[i]] <= 0.f)
+			outLeaf.corners |= static_cast<uint8_t>(1 << i);
+	}
+
+	//Skip this voxel because it is completely inside/outside the surface
+	if (outLeaf.corners == 0 || outLeaf.corners == 255)
+		return false;
 
-	std::vector<float> modelVertices;
-	std::vector<float> modelNormals;
-	std::vector<unsigned int> modelIndices;
-	std::vector<float> modelVertexColors;
+	const glm::vec3 voxelPosition = GetVoxelPosition(voxel.x, voxel.y, voxel.z);
 
-	std::vector<float> modelDuplicateVertices;
-	std::vector<float> modelDuplicateNormals;
+	for (const std::array<int, 2>& edge : DualContouringOctree::edgeCorners)
+	{
+		if (((outLeaf.corners >> edge[0]) & 1) == ((outLeaf.corners >> edge[1]) & 1))
+			continue;
+
+		const glm::vec3 cornerPos1 = voxelPosition + glm::vec3(DualContouringOctree::cornerOffsets[edge[0]]) * this->m_voxelResolution;
+		const glm::vec3 cornerPos2 = voxelPosition + glm::vec3(DualContouringOctree::cornerOffsets[edge[1]]) * this->m_voxelResolution;
 
-	int expandedGridWidth = static_cast<int>(static_cast<float>(this->m_gridWidth) * (1 / this->m_voxelResolution));
-	int expandedGridHeight = static_cast<int>(static_cast<float>(this->m_gridHeight) * (1 / this->m_voxelResolution));
-	int expandedGridDepth = static_cast<int>(static_cast<float>(this->m_gridDepth) * (1 / this->m_voxelResolution));
+		glm::vec3 intersectionPoint;
+		glm::vec3 intersectionNormal;
+		GetLatticeEdgeCrossing(cornerLatticeIndices[edge[0]], cornerLatticeIndices[edge[1]], cornerPos1, cornerPos2, intersectionPoint, intersectionNormal);
+
+		outLeaf.qef.Add(intersectionPoint, intersectionNormal);
+		outLeaf.normalSum += intersectionNormal;
+		outLeaf.pointsMin = glm::min(outLeaf.pointsMin, intersectionPoint);
+		outLeaf.pointsMax = glm::max(outLeaf.pointsMax, intersectionPoint);
+	}
 
+	return true;
+}
 
-	glm::vec3 gridPosition(0.f, 0.f, 0.f);
+template<typename OutputMode>
+void DualContouring::EmitVoxelFaces(const int x, const int y, const int z, const std::vector<float>& meshVertices, MeshBuffers& outBuffers) const
+{
+	const int voxelIndex = GetUniqueIndexForGrid(x, y, z, m_expandedGridWidth, m_expandedGridHeight);
+	const VoxelEdgeCrossings adjacentEdgesIntersection = voxelEdgeCrossings[voxelIndex];
 
-	glm::mat4 gridModelMatrix(1.f);
-	gridModelMatrix = glm::translate(gridModelMatrix, gridPosition);
+	//No intersections for that voxel's 3 adjacent edges, or the voxel is outside the face range. Skip.
+	if (adjacentEdgesIntersection.crossingMask == 0 || x < m_faceVoxelMin.x || y < m_faceVoxelMin.y || z < m_faceVoxelMin.z
+		|| x > m_faceVoxelMax.x || y > m_faceVoxelMax.y || z > m_faceVoxelMax.z)
+		return;
 
-	glm::vec3 gridCenter((this->m_gridWidth) / 2, (this->m_gridHeight) / 2, (this->m_gridDepth) / 2);
+	//Triangle corner order (into the 4 neighboring voxels) for a + to -ve transition, and reversed for -ve to +ve
+	static const std::array<int, 6> posToNegTriangleOrder = { 1, 3, 2, 0, 1, 2 };
+	static const std::array<int, 6> negToPosTriangleOrder = { 1, 2, 3, 0, 2, 1 };
 
-	//Generate vertex positions
-	for (int x = 0; x < expandedGridWidth; x++)
+	//Iterate over adjacent edges and make connections where possible
+	for (int axis = 0; axis < 3; ++axis)
 	{
-		for (int y = 0; y < expandedGridHeight; y++)
+		if (((adjacentEdgesIntersection.crossingMask >> axis) & 1) == 0)
+			continue;
+
+		//Store vertex indices (in floats) for neighboring voxels
+		std::array<int, 4> actualVertexIndices;
+		bool bAllNeighborsHaveVertex = true;
+
+		for (int i = 0; i < 4; ++i)
 		{
-			for (int z = 0; z < expandedGridDepth; z++)
+			int curX = x + static_cast<int>(adjacentVoxelsOffsets[axis][i].x);
+			int curY = y + static_cast<int>(adjacentVoxelsOffsets[axis][i].y);
+			int curZ = z + static_cast<int>(adjacentVoxelsOffsets[axis][i].z);
+
+			actualVertexIndices[i] = voxelVertexIndices[GetUniqueIndexForGrid(curX, curY, curZ, m_expandedGridWidth, m_expandedGridHeight)];
+
+			if (actualVertexIndices[i] < 0)
 			{
-				//Get relative position to grid position
-				glm::vec3 relativePos((static_cast<float>(x) * this->m_voxelResolution), (static_cast<float>(y) * this->m_voxelResolution), (static_cast<float>(z) * this->m_voxelResolution));
+				bAllNeighborsHaveVertex = false;
+				break;
+			}
+		}
 
-				//Relative to grid center
-				relativePos -= gridCenter;
+		// If we have fewer than 4 valid neighbors, we cannot form a face
+		if (!bAllNeighborsHaveVertex)
+			continue;
 
-				//Relative to grid position
-				relativePos += gridPosition;
+		const std::array<int, 6>& triangleOrder = ((adjacentEdgesIntersection.posToNegMask >> axis) & 1) ? posToNegTriangleOrder : negToPosTriangleOrder;
 
-				HermiteData defaultHermiteData{ glm::vec3(0), glm::vec3(1, 0, 0), std::numeric_limits<float>::min(), false };
+		//Join all 4 vertices in those voxels with 2 triangles
+		for (int triangle = 0; triangle < 2; ++triangle)
+		{
+			OutputMode::EmitTriangle(actualVertexIndices[triangleOrder[triangle * 3]], actualVertexIndices[triangleOrder[triangle * 3 + 1]],
+				actualVertexIndices[triangleOrder[triangle * 3 + 2]], meshVertices, outBuffers);
+		}
 
-				//Get hermite data for corners
-				std::array < HermiteData, 8> voxelCornersHermiteData = voxelToCornerHermiteDataMap[GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)];
+		//Remember which voxel edge emitted the quad, so it can be found when the region is remeshed
+		outBuffers.quadOwners.push_back(voxelIndex * 3 + axis);
+	}
+}
 
-				int cornersToConsider = 0;
+template<typename OutputMode>
+void DualContouring::EmitAllFaces()
+{
+	JobSystem::GetShared().ParallelFor(static_cast<int>(m_meshSlabs.size()), [&](const int slabIndex)
+	{
+		MeshSlab& slab = m_meshSlabs[slabIndex];
 
-				//Check if voxel is completely inside or outside the surface
-				for (int idx = 0; idx < 8; ++idx)
+		for (int x = slab.xBegin; x < slab.xEnd && !IsCancelled(); x++)
+		{
+			for (int y = 0; y < m_expandedGridHeight; y++)
+			{
+				for (int z = 0; z < m_expandedGridDepth; z++)
 				{
-					//If within the surface, consider for triangulation
-					if (voxelCornersHermiteData[idx].distance <= 0.f)
-					{
-						cornersToConsider |= 1 << idx;
-					}
+					EmitVoxelFaces<OutputMode>(x, y, z, m_mesh.vertices, slab.buffers);
 				}
+			}
+		}
+	}, m_meshingThreadCount);
 
-				//Skip this voxel because it is completely inside/outside the surface
-				if (cornersToConsider == 0 || cornersToConsider == 255)
-					continue;
+	if (IsCancelled())
+		return;
 
+	//Concatenate slab faces in slab order
+	MergeSlabFaces();
 
-				std::vector<glm::vec3> intersectionPoints;
-				std::vector<glm::vec3> intersectionNormals;
+	m_bIsMeshFlatShaded = OutputMode::bFlatShade;
+	m_bIsMeshValid = true;
+	m_bHasDirtyRegion = false;
 
-				//Array describing hermite data for 3 edges per voxel
-				std::array<HermiteData, 3> adjacentEdgeHermiteData
-				{
-					{
-						defaultHermiteData,
-						defaultHermiteData,
-						defaultHermiteData,
-					}
-				};
+	//The whole mesh is new, slot by slot updates of the output meshes no longer apply
+	for (MeshOutputBuffer& buffer : m_outputBuffers)
+	{
+		buffer.changedVertices.clear();
+		buffer.changedQuads.clear();
+		buffer.bNeedsFullCopy = true;
+	}
+	m_patchedVertices.clear();
+	m_patchedQuads.clear();
+}
 
-				//Vector containing hermite data for all 12 edges per voxel, used for computing vertex position
-				std::vector<HermiteData> allEdgeHermiteData;
+SharedMeshData DualContouring::AbortCancelledMesh()
+{
+	m_mesh.Clear();
+	m_bIsMeshValid = false;
+	m_cancellation = CancellationToken();
+	return nullptr;
+}
 
-				//If none of the 3 adjacent edges have an intersection, set flag. By default true.
-				bool bNoIntersectionFor3AdjacentEdges = true;
+SharedMeshData DualContouring::BuildMeshOutput(const Settings& settings)
+{
+	m_cancellation = CancellationToken();
+
+	//Incremental remesh patches the mesh buffers in place, the output meshes take over the changed slots
+	if (settings.bUseIncrementalRemesh && m_bIsMeshValid)
+		return PublishPatchedMesh();
+
+	//Otherwise the next update rebuilds the buffers anyway and they are moved out
+	m_outputBuffers.fill(MeshOutputBuffer());
+	std::shared_ptr<MeshData> output = std::make_shared<MeshData>();
+
+	output->vertices = m_bIsMeshFlatShaded ? std::move(m_mesh.duplicateVertices) : std::move(m_mesh.vertices);
+	if (!m_bIsMeshFlatShaded)
+		output->normals = std::move(m_mesh.normals);
+	output->indices = std::move(m_mesh.indices);
+	output->colors = std::move(m_mesh.vertexColors);
+
+	//Indexed vertices and normals were moved into the output, flat shaded ones are still in the mesh
+	if (m_skirtSides != 0 && m_bIsMeshFlatShaded)
+		AppendSkirts(m_mesh.vertices, m_mesh.normals, *output);
+	else if (m_skirtSides != 0)
+		AppendSkirts(output->vertices, output->normals, *output);
+
+	m_mesh.Clear();
+	m_bIsMeshValid = false;
+	return output;
+}
 
-				for (int i = 0; i < 12; ++i)
-				{
-					const int cornerIndex1 = edgePairs[i].first;
-					const int cornerIndex2 = edgePairs[i].second;
+SharedMeshData DualContouring::PublishPatchedMesh()
+{
+	//Every output mesh misses the changes of this update
+	for (MeshOutputBuffer& buffer : m_outputBuffers)
+	{
+		if (buffer.bNeedsFullCopy)
+			continue;
 
-					const HermiteData corner1HermiteData = voxelCornersHermiteData[cornerIndex1];
-					const HermiteData corner2HermiteData = voxelCornersHermiteData[cornerIndex2];
+		buffer.changedVertices.insert(buffer.changedVertices.end(), m_patchedVertices.begin(), m_patchedVertices.end());
+		buffer.changedQuads.insert(buffer.changedQuads.end(), m_patchedQuads.begin(), m_patchedQuads.end());
 
-					//This means that the edge has no crossing over from one sign to the other, skip.
-					if ((corner1HermiteData.distance > 0.f && corner2HermiteData.distance > 0.f) || (corner1HermiteData.distance < 0.f && corner2HermiteData.distance < 0.f))
-					{
-						continue;
-					}
+		//A mesh held over many updates is copied whole rather than slot by slot
+		if (buffer.changedVertices.size() * 3 > m_mesh.vertices.size() || buffer.changedQuads.size() > m_mesh.quadOwners.size())
+		{
+			buffer.changedVertices.clear();
+			buffer.changedQuads.clear();
+			buffer.bNeedsFullCopy = true;
+		}
+	}
+	m_patchedVertices.clear();
+	m_patchedQuads.clear();
 
-					float interpolateFactor = abs(corner1HermiteData.distance) / (abs(corner1HermiteData.distance) + abs(corner2HermiteData.distance));
-					interpolateFactor = glm::clamp(interpolateFactor, 0.0f, 1.0f);
+	//The mesh handed out last is the least behind, then the other one if its holders let go of it
+	int bufferIndex = -1;
+	for (const int candidate : { m_lastOutputBuffer, 1 - m_lastOutputBuffer })
+	{
+		if (m_outputBuffers[candidate].mesh && m_outputBuffers[candidate].mesh.use_count() == 1)
+		{
+			bufferIndex = candidate;
+			break;
+		}
+	}
 
-					glm::vec3 currIntersectionPoint = corner1HermiteData.position + ((corner2HermiteData.position - corner1HermiteData.position) * interpolateFactor);
+	if (bufferIndex >= 0)
+	{
+		//The last holder read the mesh before releasing it
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+	else
+	{
+		//Both are still held (or not made yet), the one handed out before the last is replaced
+		bufferIndex = 1 - m_lastOutputBuffer;
+		m_outputBuffers[bufferIndex] = MeshOutputBuffer();
+		m_outputBuffers[bufferIndex].mesh = std::make_shared<MeshData>();
+	}
 
-					intersectionPoints.push_back(currIntersectionPoint);
+	MeshOutputBuffer& buffer = m_outputBuffers[bufferIndex];
+	MeshData& output = *buffer.mesh;
 
-					//Calculate normal by using linear interpolation
-					const glm::vec3 intersectionNormal = glm::normalize(glm::mix(corner1HermiteData.normal, corner2HermiteData.normal, interpolateFactor));
+	//The output's skirts past the end of the mesh are cut off, then the changed slots are copied
+	const auto updateArray = [&](auto& target, const auto& source, const std::vector<int>& changedSlots, const size_t slotStride)
+	{
+		if (buffer.bNeedsFullCopy)
+		{
+			target.assign(source.begin(), source.end());
+			return;
+		}
 
-					intersectionNormals.push_back(intersectionNormal);
+		target.resize(source.size());
+		for (const int slot : changedSlots)
+		{
+			const size_t first = static_cast<size_t>(slot) * slotStride;
+			if (first + slotStride <= source.size())
+				std::copy(source.begin() + first, source.begin() + first + slotStride, target.begin() + first);
+		}
+	};
 
-					//Crossing over has occured, check if edge is one of the 3 adjacent left most corner ones, and set the value.
-					if (i == 0)
-					{
-						////Mark intersection occurred 
+	//Set vertices to duplicate mode or indices mode
+	if (m_bIsMeshFlatShaded)
+	{
+		updateArray(output.vertices, m_mesh.duplicateVertices, buffer.changedQuads, QUAD_FLOAT_COUNT);
+		output.normals.clear();
+	}
+	else
+	{
+		updateArray(output.vertices, m_mesh.vertices, buffer.changedVertices, 3);
+		updateArray(output.normals, m_mesh.normals, buffer.changedVertices, 3);
+	}
+	updateArray(output.indices, m_mesh.indices, buffer.changedQuads, QUAD_INDEX_COUNT);
+	updateArray(output.colors, m_mesh.vertexColors, buffer.changedQuads, QUAD_FLOAT_COUNT);
 
-						adjacentEdgeHermiteData[0].distance = 0.f;
-						adjacentEdgeHermiteData[0].normal = intersectionNormal;
-						adjacentEdgeHermiteData[0].position = currIntersectionPoint;
-						adjacentEdgeHermiteData[0].bIntersecPosToNeg = (corner1HermiteData.distance > corner2HermiteData.distance);
+	buffer.changedVertices.clear();
+	buffer.changedQuads.clear();
+	buffer.bNeedsFullCopy = false;
 
-						bNoIntersectionFor3AdjacentEdges = false;
+	if (m_skirtSides != 0)
+		AppendSkirts(m_mesh.vertices, m_mesh.normals, output);
 
-					}
-					else if (i == 3)
-					{
-						//Mark intersection occurred 
+	m_lastOutputBuffer = bufferIndex;
+	return buffer.mesh;
+}
 
-						adjacentEdgeHermiteData[1].distance = 0.f;
-						adjacentEdgeHermiteData[1].normal = intersectionNormal;
-						adjacentEdgeHermiteData[1].position = currIntersectionPoint;
-						adjacentEdgeHermiteData[1].bIntersecPosToNeg = (corner1HermiteData.distance > corner2HermiteData.distance);
+void DualContouring::AppendSkirts(const std::vector<float>& meshVertices, const std::vector<float>& meshNormals, MeshData& output) const
+{
+	//Axis each adjacent edge runs along, in the order of adjacentVoxelsOffsets (the x, z and y edges)
+	static const std::array<int, 3> edgeDirections = { 0, 2, 1 };
 
-						bNoIntersectionFor3AdjacentEdges = false;
+	//Positions are copied out before appending, meshVertices may be the output's own vertex array
+	const auto getVertex = [&](const std::vector<float>& values, const int vertexIndex) { return glm::vec3(values[vertexIndex], values[vertexIndex + 1], values[vertexIndex + 2]); };
 
-					}
-					else if (i == 8)
-					{
-						//Mark intersection occurred 
+	for (int side = 0; side < 6; ++side)
+	{
+		if (((m_skirtSides >> side) & 1) == 0)
+			continue;
 
-						adjacentEdgeHermiteData[2].distance = 0.f;
-						adjacentEdgeHermiteData[2].normal = intersectionNormal;
-						adjacentEdgeHermiteData[2].position = currIntersectionPoint;
-						adjacentEdgeHermiteData[2].bIntersecPosToNeg = (corner1HermiteData.distance > corner2HermiteData.distance);
+		const int borderAxis = side / 2;
+		const bool bHighSide = (side & 1) != 0;
+		//Offset along the border axis of the voxels holding the open edge, relative to the voxel owning the edge's quad
+		const int outerOffset = bHighSide ? 0 : -1;
 
-						bNoIntersectionFor3AdjacentEdges = false;
+		//Voxels on the side of the face range, their quads end at the open border
+		glm::ivec3 borderMin = m_faceVoxelMin;
+		glm::ivec3 borderMax = m_faceVoxelMax;
+		borderMin[borderAxis] = borderMax[borderAxis] = bHighSide ? m_faceVoxelMax[borderAxis] : m_faceVoxelMin[borderAxis];
 
-					}
+		for (int z = borderMin.z; z <= borderMax.z; z++)
+		{
+			for (int y = borderMin.y; y <= borderMax.y; y++)
+			{
+				for (int x = borderMin.x; x <= borderMax.x; x++)
+				{
+					const VoxelEdgeCrossings crossings = voxelEdgeCrossings[GetUniqueIndexForGrid(x, y, z, m_expandedGridWidth, m_expandedGridHeight)];
+
+					//Quads of edges along the border axis stay inside the range, the other two axes' quads reach the border
+					for (int edgeAxis = 0; edgeAxis < 3; ++edgeAxis)
+					{
+						if (edgeDirections[edgeAxis] == borderAxis || ((crossings.crossingMask >> edgeAxis) & 1) == 0)
+							continue;
 
+						//Same 4 voxels as EmitVoxelFaces, the quad only exists if all of them have a vertex
+						std::array<int, 2> outerVertices;
+						int outerVertexCount = 0;
+						bool bHasQuad = true;
+						for (int i = 0; i < 4 && bHasQuad; ++i)
+						{
+							const glm::ivec3 offset(adjacentVoxelsOffsets[edgeAxis][i]);
+							const int vertexIndex = voxelVertexIndices[GetUniqueIndexForGrid(x + offset.x, y + offset.y, z + offset.z, m_expandedGridWidth, m_expandedGridHeight)];
+							bHasQuad = vertexIndex >= 0;
 
-					//Store hermite info of an edge
-					allEdgeHermiteData.push_back(
-						{ currIntersectionPoint, intersectionNormal, 0.f, (corner1HermiteData.distance > corner2HermiteData.distance)
+							if (offset[borderAxis] == outerOffset)
+								outerVertices[outerVertexCount++] = vertexIndex;
 						}
-					);
 
-				}
+						if (!bHasQuad)
+							continue;
 
-				//In the case there is an intersection for any of the 3 adjacent edges, map the voxel to the adjacent edges, else don't.
-				if (!bNoIntersectionFor3AdjacentEdges)
-				{
-					//Map voxel to adjacent edges hermite data array
-					voxelToEdgesHermiteDataMap[GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)] = adjacentEdgeHermiteData;
-				}
+						//The skirt hangs from the open edge into the surface, along the vertex normals
+						const glm::vec3 top1 = getVertex(meshVertices, outerVertices[0]);
+						const glm::vec3 top2 = getVertex(meshVertices, outerVertices[1]);
+						const glm::vec3 normal1 = getVertex(meshNormals, outerVertices[0]);
+						const glm::vec3 normal2 = getVertex(meshNormals, outerVertices[1]);
+						const glm::vec3 bottom1 = top1 - normal1 * m_skirtDepth;
+						const glm::vec3 bottom2 = top2 - normal2 * m_skirtDepth;
 
-				//Calculate the best vertex using Quadratic error function
-				glm::vec3 vertexPos(0.f);
-				vertexPos = QEFSolver::ComputeBestVertexPosition(allEdgeHermiteData);
+						if (m_bIsMeshFlatShaded)
+						{
+							for (const glm::vec3& corner : { top1, top2, bottom2, top1, bottom2, bottom1 })
+								output.vertices.insert(output.vertices.end(), { corner.x, corner.y, corner.z });
 
-				//Calculate centroid of intersection normals
-				glm::vec3 vertexNormal(0.f);
-				for (const glm::vec3& normal : intersectionNormals)
-					vertexNormal += normal;
+							//One color per triangle, like the faces
+							for (int triangle = 0; triangle < 2; ++triangle)
+							{
+								const glm::vec3 triangleColor(RNG::GetRandomFloatNumber(0.0f, 1.0f), RNG::GetRandomFloatNumber(0.0f, 1.0f), RNG::GetRandomFloatNumber(0.0f, 1.0f));
+								for (int i = 0; i < 3; ++i)
+									output.colors.insert(output.colors.end(), { triangleColor.x, triangleColor.y, triangleColor.z });
+							}
+							continue;
+						}
 
-				vertexNormal = glm::normalize(vertexNormal);
+						//The bottom vertices keep the normals of the top ones, so the skirt is lit like the border it continues
+						const unsigned int bottomIndex = static_cast<unsigned int>(output.vertices.size() / 3);
+						output.vertices.insert(output.vertices.end(), { bottom1.x, bottom1.y, bottom1.z, bottom2.x, bottom2.y, bottom2.z });
+						output.normals.insert(output.normals.end(), { normal1.x, normal1.y, normal1.z, normal2.x, normal2.y, normal2.z });
 
-				//SANITY CHECK: CHECK IF CURRENT UNIQUE ID HAS ALREADY BEEN SET FOR VOXEL-VERTEX MAP
-				if (voxelVertexIndexMap.find(GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)) != voxelVertexIndexMap.end())
-				{
-					std::cout << "ERROR: THIS UNIQUE ID HAS ALREADY BEEN SET\n";
+						const unsigned int topIndex1 = static_cast<unsigned int>(outerVertices[0] / 3);
+						const unsigned int topIndex2 = static_cast<unsigned int>(outerVertices[1] / 3);
+						output.indices.insert(output.indices.end(), { topIndex1, topIndex2, bottomIndex + 1, topIndex1, bottomIndex + 1, bottomIndex });
+					}
 				}
+			}
+		}
+	}
+}
+
+void DualContouring::SetFaceRange(const glm::ivec3& faceVoxelMin, const glm::ivec3& faceVoxelMax)
+{
+	if (faceVoxelMin == m_faceVoxelMin && faceVoxelMax == m_faceVoxelMax)
+		return;
+
+	m_faceVoxelMin = faceVoxelMin;
+	m_faceVoxelMax = faceVoxelMax;
+	//The mesh kept for patching holds the faces of the old range
+	m_bIsMeshValid = false;
+}
+
+void DualContouring::SetLatticeOrigin(const glm::ivec3& latticeOrigin)
+{
+	if (latticeOrigin == m_latticeOrigin)
+		return;
+
+	m_latticeOrigin = latticeOrigin;
+	//Nothing stored belongs to the new place yet
+	m_bIsLatticeValid = false;
+	m_bIsMeshValid = false;
+	m_bHasDirtyRegion = false;
+}
 
-				//Map voxel to vertex array index position
-				voxelVertexIndexMap[GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)] = static_cast<int>(modelVertices.size());
+void DualContouring::SetSkirts(const uint8_t skirtSides, const float& skirtDepth)
+{
+	m_skirtSides = skirtSides;
+	m_skirtDepth = skirtDepth;
+}
 
-				//std::cout << "New Vertex: " << modelVertices.size() / 3<<", ";
+float DualContouring::GetBrushInfluenceRadius(const float& sphereRadius, EBrushType brushType, const float& voxelSize)
+{
+	//Soft brushes have no influence outside the radius. Hard brushes only move the surface inside the radius,
+	//the margin keeps the corners of edges crossing the new surface up to date.
+	if (brushType == EBrushType::HardBrushAdd || brushType == EBrushType::HardBrushSubtract)
+		return sphereRadius + HARD_BRUSH_MARGIN_VOXELS * voxelSize;
 
-				//Store vertex position relative to grid space
-				modelVertices.push_back(vertexPos.x);
-				modelVertices.push_back(vertexPos.y);
-				modelVertices.push_back(vertexPos.z);
+	return sphereRadius;
+}
 
-				//std::cout << "Vertex added, model vertices size" << modelVertices.size();
+void DualContouring::ApplyBrushToVoxels(const float& sphereRadius, const glm::vec3& sphereCenter, EBrushType brushType)
+{
+	const float influenceRadius = GetBrushInfluenceRadius(sphereRadius, brushType, this->m_voxelResolution);
 
-				//Store model normals
-				modelNormals.push_back(vertexNormal.x);
-				modelNormals.push_back(vertexNormal.y);
-				modelNormals.push_back(vertexNormal.z);
+	//A cancelled generation left nothing to edit, the next update resamples the lattice from the SDF
+	if (!m_bIsLatticeValid)
+		return;
 
+	//Only visit the lattice points inside the brush bounds
+	glm::ivec3 brushLatticeMin, brushLatticeMax;
+	if (!GetLatticeBounds(sphereCenter - glm::vec3(influenceRadius), sphereCenter + glm::vec3(influenceRadius), brushLatticeMin, brushLatticeMax))
+		return;
 
-				}
-			}
-	}
+	//Pruned blocks only hold a distance bound, sample them before editing
+	SampleLatticeBlocks(brushLatticeMin, brushLatticeMax);
 
+	//Bounds of the lattice points changed by this edit, per z-plane so the planes can be edited in parallel
+	const int planeCount = brushLatticeMax.z - brushLatticeMin.z + 1;
+	ScratchScope scratch(ScratchArena::GetThreadArena());
+	glm::ivec3* planeEditMin = scratch.Allocate<glm::ivec3>(planeCount);
+	glm::ivec3* planeEditMax = scratch.Allocate<glm::ivec3>(planeCount);
 
-	//Iterate through the cubes again, and make the edge connections
-	for (int x = 0; x < expandedGridWidth; x++)
+	//One task per z-plane, each lattice point is updated once so voxels sharing a corner see the same value
+	JobSystem::GetShared().ParallelFor(planeCount, [&](const int planeIndex)
 	{
-		for (int y = 0; y < expandedGridHeight; y++)
+		const int z = brushLatticeMin.z + planeIndex;
+		glm::ivec3 editMin(std::numeric_limits<int>::max());
+		glm::ivec3 editMax(std::numeric_limits<int>::min());
+
+		//Brush distances are evaluated an x-row at a time with the batch sphere kernel
+		ScratchScope rowScratch(ScratchArena::GetThreadArena());
+		LatticeRowBuffers row(rowScratch.GetArena(), brushLatticeMax.x - brushLatticeMin.x + 1);
+		FillLatticeRowX(row, brushLatticeMin.x);
+
+		for (int y = brushLatticeMin.y; y <= brushLatticeMax.y; y++)
 		{
-			for (int z = 0; z < expandedGridDepth; z++)
+			const glm::vec3 rowStart = GetVoxelPosition(brushLatticeMin.x, y, z);
+			std::fill(row.y, row.y + row.length, rowStart.y);
+			std::fill(row.z, row.z + row.length, rowStart.z);
+			SDFBatch::EvaluateSphere(sphereCenter, sphereRadius, row.GetPoints(), row.distances);
+
+			for (int x = brushLatticeMin.x; x <= brushLatticeMax.x; x++)
 			{
-				//Check if there is no mapping, then no intersections for that voxel's 3 adjacent edges. Skip.
-				if (voxelToEdgesHermiteDataMap.find(GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)) == voxelToEdgesHermiteDataMap.end())
-				{
-					continue;
-				}
+				//Get SDF value and normal at this lattice point
+				const int latticeIndex = GetLatticeIndex(x, y, z);
+				float& latticeDistance = latticeDistances[latticeIndex];
+				glm::vec3& latticeNormal = latticeNormals[latticeIndex];
 
+				const glm::vec3 cornerPos = GetVoxelPosition(x, y, z);
 
-				const std::array<HermiteData, 3> adjacentEdgesIntersection = voxelToEdgesHermiteDataMap[
-					GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)];
+				const float previousDistance = latticeDistance;
 
+				float brushSDF = row.distances[x - brushLatticeMin.x];
 
-				//Iterate over adjacent edges and make connections where possible
-				for (int axis = 0; axis < 3; ++axis)
+				switch (brushType)
 				{
-					//For an edge, check if an intersection exists and all 4 neighboring voxels are valid
-					if (adjacentEdgesIntersection[axis].distance != std::numeric_limits<float>::min() && ((x - 1) > 0 && (y - 1) > 0 && (z - 1) > 0))
+					case EBrushType::HardBrushAdd:
+					{
+						//Use union operation
+						if (brushSDF < latticeDistance)
+						{
+							latticeDistance = brushSDF;
+							latticeNormal = SphereBrush::CalculateSurfaceNormal(cornerPos, sphereCenter, sphereRadius);
+						}
+						break;
+					}
+					case EBrushType::HardBrushSubtract:
 					{
+						//Subtract
 
-						std::vector<unsigned int> vertexIndices;
-						std::vector<unsigned int> actualVertexIndices;
+						brushSDF *= -1.0f;
 
-						//Store vertex indices for neighboring voxels
-						for (int i = 0; i < 4; ++i)
+						if (brushSDF > latticeDistance)
 						{
-							int curX = x + static_cast<int>(adjacentVoxelsOffsets[axis][i].x);
-							int curY = y + static_cast<int>(adjacentVoxelsOffsets[axis][i].y);
-							int curZ = z + static_cast<int>(adjacentVoxelsOffsets[axis][i].z);
-
-							auto it = voxelVertexIndexMap.find(GetUniqueIndexForGrid(curX, curY, curZ, expandedGridWidth, expandedGridHeight));
+							latticeDistance = brushSDF;
+							latticeNormal = SphereBrush::CalculateSurfaceNormal(cornerPos, sphereCenter, sphereRadius);
+						}
+						break;
+					}
+					case EBrushType::SoftBrushAdd:
+					{
+						// Calculate distance from center (normalized to [0,1] at brush edge)
+						float distToCenter = glm::distance(cornerPos, sphereCenter);
+						float normalizedDist = distToCenter / sphereRadius;
 
-							if (it == voxelVertexIndexMap.end())
-								continue;  // If voxel is missing, just skip it
+						// Skip if completely outside brush influence
+						if (normalizedDist >= 1.0f) break;
 
-							// Store the found vertex index
-							vertexIndices.push_back(it->second / 3);
-							actualVertexIndices.push_back(it->second);
-						}
+						// Gaussian function with finite support
+						float falloff = exp(-3.0f * normalizedDist * normalizedDist); 
+						float brushInfluence = (1.0f - normalizedDist) * falloff;
 
+						// Blend with existing SDF
+						float newSDF = latticeDistance - brushInfluence * sphereRadius;
 
-						// If we have fewer than 4 valid neighbors, we cannot form a face
-						if (vertexIndices.size() <= 3)
-						{
-							continue;
+						if (newSDF < latticeDistance) {
+							latticeDistance = newSDF;
+							latticeNormal = SphereBrush::CalculateSurfaceNormal(
+								cornerPos, sphereCenter, sphereRadius);
 						}
-						//Join all 4 vertices in those voxels
-						if (vertexIndices.size() == 4)
-						{
+						break;
+					}
+					case EBrushType::SoftBrushSubtract:
+					{
+						// Calculate distance from center (normalized to [0,1] at brush edge)
+						float distToCenter = glm::distance(cornerPos, sphereCenter);
+						float normalizedDist = distToCenter / sphereRadius;
 
-							//If the transition is from + to -ve 
-							if (adjacentEdgesIntersection[axis].bIntersecPosToNeg == true)
-							{
+						// Skip if completely outside brush influence
+						if (normalizedDist >= 1.0f) break;
 
-								//Triangle 1
-
-								// enable duplicate vertices || //Used for glDrawArrays rather than glDrawElements
-								if (settings.bShouldFlatShade)
-								{
-									//Pos 1 (pairs of 3 floats i.e. a 3D vector)
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 2]);
-
-									//Pos 2
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3] + 2]);
-
-									//Pos 3
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 2]);
-
-									//Similarly, push duplicate normals
-									//Normal 1
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 2]);
-
-									////Normal 2
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3] + 2]);
-
-									////Normal 3
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 2]);
-
-
-									//Triangle 1 Color
-									float triangleColorR = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorG = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorB = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									//Push 3 floats (vec3 color) per vertex i.e. 3 vertices
-									for (int i = 0; i < 3; ++i)
-									{
-										modelVertexColors.push_back(triangleColorR);
-										modelVertexColors.push_back(triangleColorG);
-										modelVertexColors.push_back(triangleColorB);
-
-									}
-
-								}
-								else // utilize indexing to render vertices
-								{
-									modelIndices.push_back(vertexIndices[1]);
-									modelIndices.push_back(vertexIndices[3]);
-									modelIndices.push_back(vertexIndices[2]);
-								}
-
-
-								//Triangle 2
-
-								/*modelIndices.push_back(vertexIndices[0]);
-								modelIndices.push_back(vertexIndices[1]);
-								modelIndices.push_back(vertexIndices[2]);*/
-								/*	modelDuplicateVertices.push_back(modelVertices[vertexIndices[0]]);
-									modelDuplicateVertices.push_back(modelVertices[vertexIndices[1]]);
-									modelDuplicateVertices.push_back(modelVertices[vertexIndices[2]]);*/
-
-									// enable duplicate vertices || //Used for glDrawArrays rather than glDrawElements
-								if (settings.bShouldFlatShade)
-								{
-
-									//Pos 1 (pairs of 3 floats i.e. a 3D vector)
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0] + 2]);
-
-									//Pos 2
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 2]);
-
-									//Pos 3
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 2]);
-
-									//Similarly, push duplicate normals
-									//Normal 1
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0] + 2]);
-
-									////Normal 2
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 2]);
-
-									////Normal 3
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 2]);
-
-									float triangleColorR = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorG = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorB = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									//Push 3 floats (vec3 color) per vertex i.e. 3 vertices
-									for (int i = 0; i < 3; ++i)
-									{
-										modelVertexColors.push_back(triangleColorR);
-										modelVertexColors.push_back(triangleColorG);
-										modelVertexColors.push_back(triangleColorB);
-
-									}
-
-								}
-								else // utilize indexing to render vertices
-								{
-									modelIndices.push_back(vertexIndices[0]);
-									modelIndices.push_back(vertexIndices[1]);
-									modelIndices.push_back(vertexIndices[2]);
-								}
+						// Gaussian function with finite support
+						float falloff = exp(-3.0f * normalizedDist * normalizedDist);
+						float brushInfluence = (1.0f - normalizedDist) * falloff;
 
-							}
-							else //Reverse indices order otherwise (-ve to +ve transition)
-							{
-								////Triangle 1
-								//modelIndices.push_back(vertexIndices[1]);
-								//modelIndices.push_back(vertexIndices[2]);
-								//modelIndices.push_back(vertexIndices[3]);
-
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[1]]);/*
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[2]]);
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[3]]);*/
-
-								// enable duplicate vertices || //Used for glDrawArrays rather than glDrawElements
-								if (settings.bShouldFlatShade)
-								{
-
-									//Pos 1 (pairs of 3 floats i.e. a 3D vector)
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 2]);
-
-									//Pos 2
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 2]);
-
-									//Pos 3
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[3] + 2]);
-
-									//Similarly, push duplicate normals
-									//Normal 1
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 2]);
-
-									////Normal 2
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 2]);
-
-									////Normal 3
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[3] + 2]);
-
-									float triangleColorR = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorG = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorB = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									//Push 3 floats (vec3 color) per vertex i.e. 3 vertices
-									for (int i = 0; i < 3; ++i)
-									{
-										modelVertexColors.push_back(triangleColorR);
-										modelVertexColors.push_back(triangleColorG);
-										modelVertexColors.push_back(triangleColorB);
-
-									}
-
-
-								}
-								else // utilize indexing to render vertices
-								{
-									modelIndices.push_back(vertexIndices[1]);
-									modelIndices.push_back(vertexIndices[2]);
-									modelIndices.push_back(vertexIndices[3]);
-								}
-
-								//Triangle 2
-								/*modelIndices.push_back(vertexIndices[0]);
-								modelIndices.push_back(vertexIndices[2]);
-								modelIndices.push_back(vertexIndices[1]);*/
-
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[0]]);/*
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[2]]);
-								//modelDuplicateVertices.push_back(modelVertices[vertexIndices[1]]);*/
-
-								// enable duplicate vertices || //Used for glDrawArrays rather than glDrawElements
-								if (settings.bShouldFlatShade)
-								{
-
-									//Pos 1 (pairs of 3 floats i.e. a 3D vector)
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[0] + 2]);
-
-									//Pos 2
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[2] + 2]);
-
-									//Pos 3
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1]]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 1]);
-									modelDuplicateVertices.push_back(modelVertices[actualVertexIndices[1] + 2]);
-
-									//Similarly, push duplicate normals
-									//Normal 1
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[0] + 2]);
-
-									////Normal 2
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[2] + 2]);
-
-									////Normal 3
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1]]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 1]);
-									//modelDuplicateNormals.push_back(modelNormals[actualVertexIndices[1] + 2]);
-
-									float triangleColorR = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorG = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									float triangleColorB = RNG::GetRandomFloatNumber(0.0f, 1.0f);
-									//Push 3 floats (vec3 color) per vertex i.e. 3 vertices
-									for (int i = 0; i < 3; ++i)
-									{
-										modelVertexColors.push_back(triangleColorR);
-										modelVertexColors.push_back(triangleColorG);
-										modelVertexColors.push_back(triangleColorB);
-
-									}
-
-
-								}
-								else // utilize indexing to render vertices
-								{
-									modelIndices.push_back(vertexIndices[0]);
-									modelIndices.push_back(vertexIndices[2]);
-									modelIndices.push_back(vertexIndices[1]);
-								}
-							}
+						// Blend with existing SDF (note the + sign for "subtracting")
+						float newSDF = latticeDistance + brushInfluence * sphereRadius;
 
+						if (newSDF > latticeDistance) {
+							latticeDistance = newSDF;
+							latticeNormal = SphereBrush::CalculateSurfaceNormal(
+								cornerPos, sphereCenter, sphereRadius);
 						}
-
+						break;
+					}
+					default:
+					{
+						break;
 					}
 				}
 
+				if (latticeDistance != previousDistance)
+				{
+					editMin = glm::min(editMin, glm::ivec3(x, y, z));
+					editMax = glm::max(editMax, glm::ivec3(x, y, z));
+				}
+			}
+		}
 
+		planeEditMin[planeIndex] = editMin;
+		planeEditMax[planeIndex] = editMax;
+	}, m_meshingThreadCount);
 
+	glm::ivec3 editMin(std::numeric_limits<int>::max());
+	glm::ivec3 editMax(std::numeric_limits<int>::min());
+	for (int planeIndex = 0; planeIndex < planeCount; ++planeIndex)
+	{
+		editMin = glm::min(editMin, planeEditMin[planeIndex]);
+		editMax = glm::max(editMax, planeEditMax[planeIndex]);
+	}
 
-			}
-		}
+	//Grow the dirty region for the next incremental update
+	if (editMin.x <= editMax.x)
+	{
+		m_dirtyLatticeMin = m_bHasDirtyRegion ? glm::min(m_dirtyLatticeMin, editMin) : editMin;
+		m_dirtyLatticeMax = m_bHasDirtyRegion ? glm::max(m_dirtyLatticeMax, editMax) : editMax;
+		m_bHasDirtyRegion = true;
 	}
+}
 
-	//Finally assign the mesh details
+int DualContouring::GetUniqueIndexForGrid(const int x, const int y, const int z, const int gridWidth,
+                                          const int gridHeight)
+{
+	return x + gridWidth * (y + gridHeight * z);
+}
 
-	//Set vertices to duplicate mode or indices mode
-	vertices = (settings.bShouldFlatShade) ? modelDuplicateVertices : modelVertices;
-	normals = (settings.bShouldFlatShade) ? modelDuplicateNormals : modelNormals;
-	indices = modelIndices;
-	colors = modelVertexColors;
+int DualContouring::GetLatticeIndex(const int x, const int y, const int z) const
+{
+	return GetUniqueIndexForGrid(x, y, z, m_expandedGridWidth + 1, m_expandedGridHeight + 1);
+}
 
+glm::vec3 DualContouring::GetVoxelPosition(const int x, const int y, const int z) const
+{
+	//From the global lattice index, so every grid containing this lattice point computes the same position
+	const glm::ivec3 globalLatticePoint = glm::ivec3(x, y, z) + m_latticeOrigin;
+	const glm::vec3 relativePos((static_cast<float>(globalLatticePoint.x) * this->m_voxelResolution), (static_cast<float>(globalLatticePoint.y) * this->m_voxelResolution), (static_cast<float>(globalLatticePoint.z) * this->m_voxelResolution));
+
+	return relativePos + m_worldOrigin;
 }
 
-void DualContouring::ApplyBrushToVoxels(const float& sphereRadius, const glm::vec3& sphereCenter, EBrushType brushType)
+void DualContouring::FillLatticeRowX(LatticeRowBuffers& row, const int xBegin) const
 {
+	for (int i = 0; i < row.length; ++i)
+	{
+		row.x[i] = GetVoxelPosition(xBegin + i, 0, 0).x;
+	}
+}
 
-	int expandedGridWidth = static_cast<int>(static_cast<float>(this->m_gridWidth) * (1 / this->m_voxelResolution));
-	int expandedGridHeight = static_cast<int>(static_cast<float>(this->m_gridHeight) * (1 / this->m_voxelResolution));
-	int expandedGridDepth = static_cast<int>(static_cast<float>(this->m_gridDepth) * (1 / this->m_voxelResolution));
+bool DualContouring::GetLatticeBounds(const glm::vec3& worldMin, const glm::vec3& worldMax, glm::ivec3& outLatticeMin, glm::ivec3& outLatticeMax) const
+{
+	//Inverse of GetVoxelPosition, rounded in global lattice indices so grids sharing lattice points pick the same ones
+	const glm::vec3 latticeMin = glm::ceil((worldMin - m_worldOrigin) / this->m_voxelResolution) - glm::vec3(m_latticeOrigin);
+	const glm::vec3 latticeMax = glm::floor((worldMax - m_worldOrigin) / this->m_voxelResolution) - glm::vec3(m_latticeOrigin);
 
-	glm::vec3 gridPosition(0.f, 0.f, 0.f);
+	const glm::ivec3 lastLatticePoint(m_expandedGridWidth, m_expandedGridHeight, m_expandedGridDepth);
+	outLatticeMin = glm::clamp(glm::ivec3(latticeMin), glm::ivec3(0), lastLatticePoint);
+	outLatticeMax = glm::clamp(glm::ivec3(latticeMax), glm::ivec3(0), lastLatticePoint);
 
-	glm::mat4 gridModelMatrix(1.f);
-	gridModelMatrix = glm::translate(gridModelMatrix, gridPosition);
+	//Box misses the grid, or lies between two lattice points
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (latticeMin[axis] > static_cast<float>(lastLatticePoint[axis]) || latticeMax[axis] < 0.f || latticeMin[axis] > latticeMax[axis])
+			return false;
+	}
 
+	return true;
+}
+
+int DualContouring::GetLatticeBlockIndex(const int blockX, const int blockY, const int blockZ) const
+{
+	return GetUniqueIndexForGrid(blockX, blockY, blockZ, m_latticeBlockCount.x, m_latticeBlockCount.y);
+}
+
+void DualContouring::GetLatticeBlockExtent(const int blockX, const int blockY, const int blockZ, glm::ivec3& outLatticeMin, glm::ivec3& outLatticeMax) const
+{
+	outLatticeMin = glm::ivec3(blockX, blockY, blockZ) * LATTICE_BLOCK_SIZE;
+	outLatticeMax = glm::min(outLatticeMin + glm::ivec3(LATTICE_BLOCK_SIZE), glm::ivec3(m_expandedGridWidth, m_expandedGridHeight, m_expandedGridDepth));
+}
 
-	//Generate vertex positions
-	for (int x = 0; x < expandedGridWidth; x++)
+bool DualContouring::IsVoxelBlockSampled(const int x, const int y, const int z) const
+{
+	return latticeBlockStates[GetLatticeBlockIndex(x / LATTICE_BLOCK_SIZE, y / LATTICE_BLOCK_SIZE, z / LATTICE_BLOCK_SIZE)] == ELatticeBlockState::Sampled;
+}
+
+void DualContouring::ClassifyLatticeBlocks(const USDFComponent& sdfComponent)
+{
+	const float pruneSlack = LATTICE_BLOCK_PRUNE_SLACK_VOXELS * this->m_voxelResolution;
+
+	JobSystem::GetShared().ParallelFor(m_latticeBlockCount.z, [&](const int blockZ)
 	{
-		for (int y = 0; y < expandedGridHeight; y++)
+		//A newer generation superseded this one, the remaining planes are skipped
+		if (IsCancelled())
+			return;
+
+		//Block centers are evaluated an x-row of blocks at a time
+		ScratchScope scratch(ScratchArena::GetThreadArena());
+		LatticeRowBuffers centers(scratch.GetArena(), m_latticeBlockCount.x);
+		float* halfDiagonals = scratch.Allocate<float>(m_latticeBlockCount.x);
+
+		for (int blockY = 0; blockY < m_latticeBlockCount.y; blockY++)
 		{
-			for (int z = 0; z < expandedGridDepth; z++)
+			for (int blockX = 0; blockX < m_latticeBlockCount.x; blockX++)
+			{
+				glm::ivec3 latticeMin, latticeMax;
+				GetLatticeBlockExtent(blockX, blockY, blockZ, latticeMin, latticeMax);
+
+				const glm::vec3 cornerMin = GetVoxelPosition(latticeMin.x, latticeMin.y, latticeMin.z);
+				const glm::vec3 cornerMax = GetVoxelPosition(latticeMax.x, latticeMax.y, latticeMax.z);
+				const glm::vec3 center = (cornerMin + cornerMax) * 0.5f;
+
+				centers.x[blockX] = center.x;
+				centers.y[blockX] = center.y;
+				centers.z[blockX] = center.z;
+				halfDiagonals[blockX] = glm::length(cornerMax - cornerMin) * 0.5f;
+			}
+
+			sdfComponent.EvaluateSDFBatch(centers.GetPoints(), centers.distances);
+
+			//Every SDF is a distance bound (1-Lipschitz), so no lattice point of the block is closer to the surface than |d| - halfDiagonal
+			for (int blockX = 0; blockX < m_latticeBlockCount.x; blockX++)
 			{
-				//Get SDF values at corner of this voxel
-				std::array < HermiteData, 8>& voxelCornersHermiteData = voxelToCornerHermiteDataMap[GetUniqueIndexForGrid(x, y, z, expandedGridWidth, expandedGridHeight)];
+				const int blockIndex = GetLatticeBlockIndex(blockX, blockY, blockZ);
+				const float centerDistance = centers.distances[blockX];
+				const float pruneDistance = halfDiagonals[blockX] + pruneSlack;
 
-				for (int i = 0; i < 8; ++i)
+				if (centerDistance > pruneDistance)
+				{
+					latticeBlockStates[blockIndex] = ELatticeBlockState::Outside;
+					latticeBlockDistanceBounds[blockIndex] = centerDistance - halfDiagonals[blockX];
+				}
+				else if (centerDistance < -pruneDistance)
+				{
+					latticeBlockStates[blockIndex] = ELatticeBlockState::Inside;
+					latticeBlockDistanceBounds[blockIndex] = centerDistance + halfDiagonals[blockX];
+				}
+				else
 				{
+					latticeBlockStates[blockIndex] = ELatticeBlockState::Sampled;
+				}
+			}
+		}
+	}, m_meshingThreadCount);
+}
 
-					float brushSDF = SphereBrush::EvaluateBrushSDF(voxelCornersHermiteData[i].position, sphereCenter, sphereRadius);
+void DualContouring::SampleLattice(const USDFComponent& sdfComponent)
+{
+	const int expandedGridWidth = this->m_expandedGridWidth;
 
-					switch (brushType)
-					{
-						case EBrushType::HardBrushAdd:
-						{
-							//Use union operation
-							if (brushSDF < voxelCornersHermiteData[i].distance)
-							{
-								voxelCornersHermiteData[i].distance = brushSDF;
-								voxelCornersHermiteData[i].normal = SphereBrush::CalculateSurfaceNormal(voxelCornersHermiteData[i].position, sphereCenter, sphereRadius);
-							}
-							break;
-						}
-						case EBrushType::HardBrushSubtract:
-						{
-							//Subtract
+	//One task per z-plane
+	JobSystem::GetShared().ParallelFor(m_expandedGridDepth + 1, [&](const int z)
+	{
+		if (IsCancelled())
+			return;
 
-							brushSDF *= -1.0f;
+		//One x-row of lattice points at a time, as a structure of arrays for the batch SDF kernels
+		ScratchScope scratch(ScratchArena::GetThreadArena());
+		LatticeRowBuffers row(scratch.GetArena(), expandedGridWidth + 1);
+		FillLatticeRowX(row);
+		bool* bBlockColumnSampled = scratch.Allocate<bool>(m_latticeBlockCount.x);
 
-							if (brushSDF > voxelCornersHermiteData[i].distance)
-							{
-								voxelCornersHermiteData[i].distance = brushSDF;
-								voxelCornersHermiteData[i].normal = SphereBrush::CalculateSurfaceNormal(voxelCornersHermiteData[i].position, sphereCenter, sphereRadius);
-							}
-							break;
-						}
-						case EBrushType::SoftBrushAdd:
-						{
-							// Calculate distance from center (normalized to [0,1] at brush edge)
-							float distToCenter = glm::distance(voxelCornersHermiteData[i].position, sphereCenter);
-							float normalizedDist = distToCenter / sphereRadius;
+		int blockZLow, blockZHigh;
+		GetLatticeCoordinateBlocks(z, m_latticeBlockCount.z, blockZLow, blockZHigh);
 
-							// Skip if completely outside brush influence
-							if (normalizedDist >= 1.0f) break;
+		for (int y = 0; y <= m_expandedGridHeight; y++)
+		{
+			int blockYLow, blockYHigh;
+			GetLatticeCoordinateBlocks(y, m_latticeBlockCount.y, blockYLow, blockYHigh);
 
-							// Gaussian function with finite support
-							float falloff = exp(-3.0f * normalizedDist * normalizedDist); 
-							float brushInfluence = (1.0f - normalizedDist) * falloff;
+			//A lattice point is sampled if any block sharing it is
+			for (int blockX = 0; blockX < m_latticeBlockCount.x; blockX++)
+			{
+				auto isSampled = [&](const int blockY, const int blockZ) { return latticeBlockStates[GetLatticeBlockIndex(blockX, blockY, blockZ)] == ELatticeBlockState::Sampled; };
+				bBlockColumnSampled[blockX] = isSampled(blockYLow, blockZLow) || isSampled(blockYLow, blockZHigh) || isSampled(blockYHigh, blockZLow) || isSampled(blockYHigh, blockZHigh);
+			}
 
-							// Blend with existing SDF
-							float newSDF = voxelCornersHermiteData[i].distance - brushInfluence * sphereRadius;
+			const int rowLatticeIndex = GetLatticeIndex(0, y, z);
+			int runBegin = -1;
 
-							if (newSDF < voxelCornersHermiteData[i].distance) {
-								voxelCornersHermiteData[i].distance = newSDF;
-								voxelCornersHermiteData[i].normal = SphereBrush::CalculateSurfaceNormal(
-									voxelCornersHermiteData[i].position, sphereCenter, sphereRadius);
-							}
-							break;
-						}
-						case EBrushType::SoftBrushSubtract:
-						{
-							// Calculate distance from center (normalized to [0,1] at brush edge)
-							float distToCenter = glm::distance(voxelCornersHermiteData[i].position, sphereCenter);
-							float normalizedDist = distToCenter / sphereRadius;
+			for (int x = 0; x <= expandedGridWidth + 1; x++)
+			{
+				bool bSampled = false;
+				int blockXLow = 0, blockXHigh = 0;
+				if (x <= expandedGridWidth)
+				{
+					GetLatticeCoordinateBlocks(x, m_latticeBlockCount.x, blockXLow, blockXHigh);
+					bSampled = bBlockColumnSampled[blockXLow] || bBlockColumnSampled[blockXHigh];
+				}
 
-							// Skip if completely outside brush influence
-							if (normalizedDist >= 1.0f) break;
+				//Runs of sampled points go through the batch evaluation together
+				if (bSampled && runBegin < 0)
+				{
+					runBegin = x;
+				}
+				else if (!bSampled && runBegin >= 0)
+				{
+					SampleLatticeRun(sdfComponent, row, runBegin, x - 1, y, z);
+					runBegin = -1;
+				}
 
-							// Gaussian function with finite support
-							float falloff = exp(-3.0f * normalizedDist * normalizedDist);
-							float brushInfluence = (1.0f - normalizedDist) * falloff;
+				//Only pruned blocks share this point, they all prove the same sign
+				if (!bSampled && x <= expandedGridWidth)
+					latticeDistances[rowLatticeIndex + x] = latticeBlockDistanceBounds[GetLatticeBlockIndex(blockXHigh, blockYHigh, blockZHigh)];
+			}
+		}
+	}, m_meshingThreadCount);
+}
 
-							// Blend with existing SDF (note the + sign for "subtracting")
-							float newSDF = voxelCornersHermiteData[i].distance + brushInfluence * sphereRadius;
+void DualContouring::SampleLatticeBlocks(const glm::ivec3& latticeMin, const glm::ivec3& latticeMax)
+{
+	const std::shared_ptr<USDFComponent> sdfComponent = m_sdfComponent.lock();
+	if (!sdfComponent)
+		return;
+
+	//Blocks sharing any lattice point of the range
+	glm::ivec3 blockMin, blockMax, unusedBlock;
+	GetLatticeCoordinateBlocks(latticeMin.x, m_latticeBlockCount.x, blockMin.x, unusedBlock.x);
+	GetLatticeCoordinateBlocks(latticeMin.y, m_latticeBlockCount.y, blockMin.y, unusedBlock.y);
+	GetLatticeCoordinateBlocks(latticeMin.z, m_latticeBlockCount.z, blockMin.z, unusedBlock.z);
+	GetLatticeCoordinateBlocks(latticeMax.x, m_latticeBlockCount.x, unusedBlock.x, blockMax.x);
+	GetLatticeCoordinateBlocks(latticeMax.y, m_latticeBlockCount.y, unusedBlock.y, blockMax.y);
+	GetLatticeCoordinateBlocks(latticeMax.z, m_latticeBlockCount.z, unusedBlock.z, blockMax.z);
+
+	//Row buffers for sampling, the x coordinates are only filled once a pruned block is found
+	ScratchScope scratch(ScratchArena::GetThreadArena());
+	LatticeRowBuffers row(scratch.GetArena(), m_expandedGridWidth + 1);
+	bool bIsRowFilled = false;
+
+	for (int blockZ = blockMin.z; blockZ <= blockMax.z; blockZ++)
+	{
+		for (int blockY = blockMin.y; blockY <= blockMax.y; blockY++)
+		{
+			for (int blockX = blockMin.x; blockX <= blockMax.x; blockX++)
+			{
+				const int blockIndex = GetLatticeBlockIndex(blockX, blockY, blockZ);
+				if (latticeBlockStates[blockIndex] == ELatticeBlockState::Sampled)
+					continue;
 
-							if (newSDF > voxelCornersHermiteData[i].distance) {
-								voxelCornersHermiteData[i].distance = newSDF;
-								voxelCornersHermiteData[i].normal = SphereBrush::CalculateSurfaceNormal(
-									voxelCornersHermiteData[i].position, sphereCenter, sphereRadius);
-							}
-							break;
-						}
-						default:
-						{
-							break;
-						}
+				if (!bIsRowFilled)
+				{
+					FillLatticeRowX(row);
+					bIsRowFilled = true;
+				}
+
+				//Points shared with sampled blocks are sampled again, a brush can only have edited them if this block was sampled too
+				glm::ivec3 blockLatticeMin, blockLatticeMax;
+				GetLatticeBlockExtent(blockX, blockY, blockZ, blockLatticeMin, blockLatticeMax);
+				for (int z = blockLatticeMin.z; z <= blockLatticeMax.z; z++)
+				{
+					for (int y = blockLatticeMin.y; y <= blockLatticeMax.y; y++)
+					{
+						SampleLatticeRun(*sdfComponent, row, blockLatticeMin.x, blockLatticeMax.x, y, z);
 					}
+				}
+
+				latticeBlockStates[blockIndex] = ELatticeBlockState::Sampled;
+			}
+		}
+	}
+}
 
-			
+void DualContouring::SampleLatticeRun(const USDFComponent& sdfComponent, LatticeRowBuffers& row, const int xBegin, const int xEnd, const int y, const int z)
+{
+	const glm::vec3 rowStart = GetVoxelPosition(0, y, z);
+	std::fill(row.y + xBegin, row.y + xEnd + 1, rowStart.y);
+	std::fill(row.z + xBegin, row.z + xEnd + 1, rowStart.z);
 
-				}
+	const SDFBatchPoints points{ row.x + xBegin, row.y + xBegin, row.z + xBegin, xEnd - xBegin + 1 };
+	const SDFBatchGradients gradients{ row.gradientX + xBegin, row.gradientY + xBegin, row.gradientZ + xBegin };
+
+	//Distances go straight into the lattice, an x-row is contiguous
+	const int latticeIndex = GetLatticeIndex(xBegin, y, z);
+	sdfComponent.EvaluateSDFWithGradientBatch(points, &latticeDistances[latticeIndex], gradients);
+
+	for (int x = xBegin; x <= xEnd; x++)
+	{
+		latticeNormals[latticeIndex + x - xBegin] = glm::normalize(glm::vec3(row.gradientX[x], row.gradientY[x], row.gradientZ[x]));
+	}
+}
+
+void DualContouring::PrepareMeshSlabs(const Settings& settings)
+{
+	//Passes share the job system with the other subsystems, the setting only caps how many of its threads they use
+	const unsigned int threadCount = JobSystem::ResolveThreadCount(static_cast<unsigned int>(std::max(settings.meshingThreadCount, 0)));
+	m_meshingThreadCount = threadCount;
+
+	//A few slabs per thread to balance slabs that hit more of the surface than others
+	const int slabCount = std::max(1, std::min(m_expandedGridWidth, static_cast<int>(threadCount) * 4));
 
+	m_meshSlabs.resize(slabCount);
+	for (int slabIndex = 0; slabIndex < slabCount; ++slabIndex)
+	{
+		MeshSlab& slab = m_meshSlabs[slabIndex];
+		slab.xBegin = (m_expandedGridWidth * slabIndex) / slabCount;
+		slab.xEnd = (m_expandedGridWidth * (slabIndex + 1)) / slabCount;
+
+		//Keep the capacity around for the next pass
+		slab.buffers.Clear();
+	}
+}
+
+void DualContouring::MergeSlabVertices()
+{
+	//Offset (in floats) of each slab's first vertex in the merged array
+	ScratchScope scratch(ScratchArena::GetThreadArena());
+	int* slabVertexOffsets = scratch.Allocate<int>(m_meshSlabs.size());
+	size_t totalVertexFloats = 0;
+	for (size_t slabIndex = 0; slabIndex < m_meshSlabs.size(); ++slabIndex)
+	{
+		slabVertexOffsets[slabIndex] = static_cast<int>(totalVertexFloats);
+		totalVertexFloats += m_meshSlabs[slabIndex].buffers.vertices.size();
+	}
+
+	m_mesh.Clear();
+	m_mesh.vertices.reserve(totalVertexFloats);
+	m_mesh.normals.reserve(totalVertexFloats);
+	for (const MeshSlab& slab : m_meshSlabs)
+	{
+		m_mesh.vertices.insert(m_mesh.vertices.end(), slab.buffers.vertices.begin(), slab.buffers.vertices.end());
+		m_mesh.normals.insert(m_mesh.normals.end(), slab.buffers.normals.begin(), slab.buffers.normals.end());
+	}
+
+	//Shift slab-local vertex indices to their merged position
+	JobSystem::GetShared().ParallelFor(static_cast<int>(m_meshSlabs.size()), [&](const int slabIndex)
+	{
+		const MeshSlab& slab = m_meshSlabs[slabIndex];
+		const int vertexOffset = slabVertexOffsets[slabIndex];
+		if (vertexOffset == 0)
+			return;
+
+		for (int z = 0; z < m_expandedGridDepth; z++)
+		{
+			for (int y = 0; y < m_expandedGridHeight; y++)
+			{
+				for (int x = slab.xBegin; x < slab.xEnd; x++)
+				{
+					int& vertexIndex = voxelVertexIndices[GetUniqueIndexForGrid(x, y, z, m_expandedGridWidth, m_expandedGridHeight)];
+					if (vertexIndex >= 0)
+						vertexIndex += vertexOffset;
+				}
 			}
 		}
+	}, m_meshingThreadCount);
+}
+
+void DualContouring::MergeSlabFaces()
+{
+	size_t totalIndices = 0, totalDuplicateVertices = 0, totalColors = 0, totalQuads = 0;
+	for (const MeshSlab& slab : m_meshSlabs)
+	{
+		totalIndices += slab.buffers.indices.size();
+		totalDuplicateVertices += slab.buffers.duplicateVertices.size();
+		totalColors += slab.buffers.vertexColors.size();
+		totalQuads += slab.buffers.quadOwners.size();
 	}
 
+	m_mesh.indices.reserve(totalIndices);
+	m_mesh.duplicateVertices.reserve(totalDuplicateVertices);
+	m_mesh.vertexColors.reserve(totalColors);
+	m_mesh.quadOwners.reserve(totalQuads);
+	for (const MeshSlab& slab : m_meshSlabs)
+	{
+		AppendQuads(slab.buffers);
+	}
 }
 
-int DualContouring::GetUniqueIndexForGrid(const int x, const int y, const int z, const int gridWidth,
-                                          const int gridHeight)
+void DualContouring::AppendQuads(const MeshBuffers& quads)
 {
-	return x + gridWidth * (y + gridHeight * z);
+	const int firstQuadSlot = static_cast<int>(m_mesh.quadOwners.size());
+
+	m_mesh.indices.insert(m_mesh.indices.end(), quads.indices.begin(), quads.indices.end());
+	m_mesh.duplicateVertices.insert(m_mesh.duplicateVertices.end(), quads.duplicateVertices.begin(), quads.duplicateVertices.end());
+	m_mesh.vertexColors.insert(m_mesh.vertexColors.end(), quads.vertexColors.begin(), quads.vertexColors.end());
+	m_mesh.quadOwners.insert(m_mesh.quadOwners.end(), quads.quadOwners.begin(), quads.quadOwners.end());
+
+	for (size_t quad = 0; quad < quads.quadOwners.size(); ++quad)
+	{
+		voxelEdgeQuadSlots[quads.quadOwners[quad]] = firstQuadSlot + static_cast<int>(quad);
+	}
+}
+
+void DualContouring::RemoveQuad(const int quadSlot)
+{
+	const int lastQuadSlot = static_cast<int>(m_mesh.quadOwners.size()) - 1;
+
+	voxelEdgeQuadSlots[m_mesh.quadOwners[quadSlot]] = -1;
+
+	//Move the last quad into the freed slot so the buffers stay packed
+	if (quadSlot != lastQuadSlot)
+	{
+		auto moveQuadData = [&](auto& buffer, const size_t quadStride)
+		{
+			if (buffer.empty()) return;
+			std::copy(buffer.begin() + lastQuadSlot * quadStride, buffer.begin() + (lastQuadSlot + 1) * quadStride, buffer.begin() + quadSlot * quadStride);
+		};
+		moveQuadData(m_mesh.indices, QUAD_INDEX_COUNT);
+		moveQuadData(m_mesh.duplicateVertices, QUAD_FLOAT_COUNT);
+		moveQuadData(m_mesh.vertexColors, QUAD_FLOAT_COUNT);
+
+		m_mesh.quadOwners[quadSlot] = m_mesh.quadOwners[lastQuadSlot];
+		voxelEdgeQuadSlots[m_mesh.quadOwners[quadSlot]] = quadSlot;
+		m_patchedQuads.push_back(quadSlot);
+	}
+
+	auto popQuadData = [&](auto& buffer, const size_t quadStride)
+	{
+		if (buffer.empty()) return;
+		buffer.resize(buffer.size() - quadStride);
+	};
+	popQuadData(m_mesh.indices, QUAD_INDEX_COUNT);
+	popQuadData(m_mesh.duplicateVertices, QUAD_FLOAT_COUNT);
+	popQuadData(m_mesh.vertexColors, QUAD_FLOAT_COUNT);
+	m_mesh.quadOwners.pop_back();
+}
+
+void DualContouring::ClearVoxelMeshData()
+{
+	std::fill(voxelVertexIndices.begin(), voxelVertexIndices.end(), -1);
+	std::fill(voxelEdgeCrossings.begin(), voxelEdgeCrossings.end(), VoxelEdgeCrossings{ 0, 0 });
+	std::fill(voxelEdgeQuadSlots.begin(), voxelEdgeQuadSlots.end(), -1);
+	m_freeVertexSlots.clear();
+
+	m_bIsMeshValid = false;
+	m_bHasDirtyRegion = false;
 }
 
-void DualContouring::ClearHashMapData()
+void MeshBuffers::Clear()
 {
-	voxelVertexIndexMap.clear();
-	voxelToEdgesHermiteDataMap.clear();
+	vertices.clear();
+	normals.clear();
+	indices.clear();
+	duplicateVertices.clear();
+	vertexColors.clear();
+	quadOwners.clear();
 }
@@ -1,33 +1,130 @@
 #pragma once
+#include <array>
+#include <cstdint>
 #include <memory>
-#include <unordered_map>
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "JobSystem.h"
+#include "Math/SDFBatch.h"
+#include "MeshData.h"
+#include "ScratchArena.h"
+
 
 enum class EBrushType;
 class USDFComponent;
 
-//Describes the data for a given intersection point
-struct HermiteData
+//Packed sign-change info for the 3 front-most adjacent edges of a voxel (edge 0, 3 and 8), one bit per edge
+struct VoxelEdgeCrossings
+{
+	//Bit is set if the edge has a sign change
+	uint8_t crossingMask;
+	//Bit is set if the sign change goes from positive to negative (used for rendering order of triangles)
+	uint8_t posToNegMask;
+};
+
+
+//Mesh data built by dual contouring. Faces are stored as quads (2 triangles) so a quad can be removed when its region is remeshed.
+struct MeshBuffers
 {
-	glm::vec3 position;
-	glm::vec3 normal;
-	float distance;
-	//Whether the intersection point is from positive to negative or vice versa (used for rendering order of triangles)
-	bool bIntersecPosToNeg;
+	std::vector<float> vertices;
+	std::vector<float> normals;
+	std::vector<unsigned int> indices;
+	std::vector<float> duplicateVertices;
+	std::vector<float> vertexColors;
+	//Voxel edge (voxelIndex * 3 + axis) that emitted each quad
+	std::vector<int> quadOwners;
+
+	//Clears all buffers but keeps their capacity
+	void Clear();
+};
+
+//Mesh handed out while incremental remeshing is on, with the slots of the grid's mesh that changed since it was last
+//brought up to date
+struct MeshOutputBuffer
+{
+	std::shared_ptr<MeshData> mesh;
+	//Vertex numbers and quad slots whose rendered data changed, unused while bNeedsFullCopy is set
+	std::vector<int> changedVertices;
+	std::vector<int> changedQuads;
+	bool bNeedsFullCopy = true;
+};
+
+//Mesh output of one x-slab of the grid. Slabs are merged in slab order, so the result matches a single-threaded pass.
+struct MeshSlab
+{
+	//First and one-past-last voxel x coordinate of the slab
+	int xBegin = 0;
+	int xEnd = 0;
+
+	MeshBuffers buffers;
+};
+
+//Coarse blocks of the lattice, used to skip the regions the surface cannot cross
+enum class ELatticeBlockState : uint8_t
+{
+	//The lattice points of the block hold sampled distances
+	Sampled,
+	//The block is proven to be fully outside/inside the surface, its lattice points only hold a distance bound with the right sign
+	Outside,
+	Inside
+};
+
+//Sampled lattice of a grid, kept while the grid's storage holds another place of the world
+struct LatticeSnapshot
+{
+	std::vector<float> distances;
+	std::vector<glm::vec3> normals;
+	std::vector<ELatticeBlockState> blockStates;
+	std::vector<float> blockDistanceBounds;
+
+	size_t GetByteSize() const
+	{
+		return distances.size() * sizeof(float) + normals.size() * sizeof(glm::vec3) + blockStates.size() * sizeof(ELatticeBlockState)
+			+ blockDistanceBounds.size() * sizeof(float);
+	}
+};
+
+//Structure-of-arrays buffers for one x-row of lattice points, fed to the batch SDF kernels
+struct LatticeRowBuffers
+{
+	int length = 0;
+	float* x = nullptr;
+	float* y = nullptr;
+	float* z = nullptr;
+	float* distances = nullptr;
+	float* gradientX = nullptr;
+	float* gradientY = nullptr;
+	float* gradientZ = nullptr;
+
+	//The buffers live in the arena until it is rewound
+	LatticeRowBuffers(ScratchArena& arena, const int rowLength)
+		: length(rowLength), x(arena.Allocate<float>(rowLength)), y(arena.Allocate<float>(rowLength)), z(arena.Allocate<float>(rowLength)), distances(arena.Allocate<float>(rowLength)),
+		gradientX(arena.Allocate<float>(rowLength)), gradientY(arena.Allocate<float>(rowLength)), gradientZ(arena.Allocate<float>(rowLength)) {}
+
+	SDFBatchPoints GetPoints() const { return SDFBatchPoints{ x, y, z, length }; }
+	SDFBatchGradients GetGradients() { return SDFBatchGradients{ gradientX, gradientY, gradientZ }; }
 };
 
 
 class ACamera;
 class Settings; 
+class DualContouringOctree;
+struct OctreeLeafData;
+struct QEFData;
+struct QEFBatch;
 
 class DualContouring
 {
 public:
 	DualContouring(const unsigned int& gridWidth, const unsigned int& gridHeight, const unsigned int& gridDepth, const float& voxelSize);
+	//Grid of voxelCount voxels whose lattice point (0,0,0) is the global lattice point latticeOrigin, global lattice point
+	//(0,0,0) lies at worldOrigin. Positions are computed from global lattice indices, so grids sharing lattice points agree on
+	//them bit for bit. With bAlwaysUseLatticeNormals the initial mesh takes its normals from the lattice too, so a voxel's
+	//vertex only depends on its 8 corners and grids sharing the voxel solve the same vertex whichever of them remeshed last.
+	DualContouring(const glm::ivec3& voxelCount, const float& voxelSize, const glm::vec3& worldOrigin, const glm::ivec3& latticeOrigin, const bool bAlwaysUseLatticeNormals);
 	~DualContouring();
 
 	static const std::vector<glm::vec3> voxelCornerOffsets;
@@ -36,28 +133,203 @@ public:
 
 	static const glm::vec3 GetIntersectionPoint(const glm::vec3& firstPosition, const glm::vec3& secondPosition, const glm::vec3& spherePosition, const float& sphereRadius, int totalSteps = 100);
 	static const glm::vec3 CalculateSurfaceNormal(const glm::vec3& intersectionPos, std::weak_ptr<USDFComponent> actorSdfComponent);
-	//Generates mesh initially
-	void InitGenerateMesh(std::vector<float>& vertices, std::vector<float>& normals, std::vector<unsigned int>& indices, std::vector<float>& colors, const std::weak_ptr<USDFComponent> actorSdfComponent, const Settings& settings);
-	//Updates mesh depending on any edits made to the SDF using user-inputs
-	void UpdateMesh(std::vector<float>& vertices, std::vector<float>& normals, std::vector<unsigned int>& indices, std::vector<float>& colors, const Settings& settings);
+	//Generates mesh initially. Returns nullptr if cancelled, the lattice then has to be generated again.
+	SharedMeshData InitGenerateMesh(const std::weak_ptr<USDFComponent> actorSdfComponent, const Settings& settings, const CancellationToken& cancellation = CancellationToken());
+	//Only samples the lattice from the SDF, e.g. to save it for later. Returns false if cancelled.
+	bool InitSampleLattice(const std::weak_ptr<USDFComponent> actorSdfComponent, const Settings& settings, const CancellationToken& cancellation = CancellationToken());
+	//Copies the lattice into a snapshot, returns false if it isn't fully sampled
+	bool SaveLattice(LatticeSnapshot& outSnapshot) const;
+	//Takes over the lattice of a snapshot saved from a grid of the same size, the next update meshes it. Returns false if
+	//the sizes differ.
+	bool RestoreLattice(LatticeSnapshot& snapshot, const std::weak_ptr<USDFComponent> actorSdfComponent);
+	//Updates mesh depending on any edits made to the SDF using user-inputs. Returns nullptr if cancelled, the next
+	//update then remeshes the whole grid.
+	SharedMeshData UpdateMesh(const Settings& settings, const CancellationToken& cancellation = CancellationToken());
 	void ApplyBrushToVoxels(const float& sphereRadius, const glm::vec3& sphereCenter, EBrushType brushType);
-	void DebugDrawVertices(const std::vector<float>& vertices,  std::weak_ptr<ACamera> curCamera, const Settings& settings);
-
-	//Maps a voxel (unique index from x,y,z pos) to 3 front-most adjacent edge's hermite data
-	std::unordered_map<int, std::array<HermiteData, 3>> voxelToEdgesHermiteDataMap;
-	//Maps a voxel (unique index from x,y,z pos) to 8 corner's hermite data
-	std::unordered_map<int, std::array<HermiteData, 8>> voxelToCornerHermiteDataMap;
+	//Radius around the brush center whose lattice points an edit may change
+	static float GetBrushInfluenceRadius(const float& sphereRadius, EBrushType brushType, const float& voxelSize);
+	//True if brushes changed the lattice since the last update
+	bool HasPendingEdits() const { return m_bHasDirtyRegion; }
+	//Voxels (inclusive) whose edges emit faces, the voxels outside only provide vertices to them. By default every voxel
+	//from the second on. Changing it rebuilds the whole mesh on the next update.
+	void SetFaceRange(const glm::ivec3& faceVoxelMin, const glm::ivec3& faceVoxelMax);
+	//Moves the grid to another place of the global lattice, keeping its storage. The lattice has to be sampled again by
+	//InitGenerateMesh, edits made so far are dropped.
+	void SetLatticeOrigin(const glm::ivec3& latticeOrigin);
+	//Sides of the face range (bit axis * 2, plus 1 for the high side) whose open mesh border gets a skirt reaching depth
+	//below the surface, it hides the cracks towards a neighbouring mesh of another resolution. Picked up by the next update.
+	void SetSkirts(const uint8_t skirtSides, const float& skirtDepth);
+	static void DebugDrawVertices(const ArrayView<float> vertices, std::weak_ptr<ACamera> curCamera, const Settings& settings);
 
 private:
-	int m_gridWidth = 15;
-	int m_gridHeight = 15;
-	int m_gridDepth = 15;
 	float m_voxelResolution = 1.0f;
+	//World position of global lattice point (0,0,0)
+	glm::vec3 m_worldOrigin = glm::vec3(0.f);
+	//Global lattice index of the grid's lattice point (0,0,0)
+	glm::ivec3 m_latticeOrigin = glm::ivec3(0);
+	//Voxels (inclusive) whose edges emit faces, a face needs the voxels below its edge
+	glm::ivec3 m_faceVoxelMin = glm::ivec3(2);
+	glm::ivec3 m_faceVoxelMax = glm::ivec3(0);
+	//Sides of the face range that get a skirt, see SetSkirts
+	uint8_t m_skirtSides = 0;
+	float m_skirtDepth = 0.f;
+	//Initial mesh interpolates the lattice normals instead of taking the SDF gradient at each crossing
+	bool m_bAlwaysUseLatticeNormals = false;
+
+	//Number of voxels along each axis once the grid is subdivided by the voxel resolution
+	int m_expandedGridWidth = 0;
+	int m_expandedGridHeight = 0;
+	int m_expandedGridDepth = 0;
+
+	// -- SHARED CORNER LATTICE ((W+1) x (H+1) x (D+1) points, indexed by GetLatticeIndex) --
+
+	//Signed distance sampled once per lattice point
+	std::vector<float> latticeDistances;
+	//Surface normal sampled once per lattice point
+	std::vector<glm::vec3> latticeNormals;
+	//Offset from a voxel's lattice index to each of its 8 corners (same order as voxelCornerOffsets)
+	std::array<int, 8> latticeCornerOffsets;
+
+	// -- LATTICE BLOCK PRUNING --
+
+	//State of each block of voxels, indexed by GetLatticeBlockIndex
+	std::vector<ELatticeBlockState> latticeBlockStates;
+	//Bound on the signed distance of every lattice point of a pruned block (> 0 outside, < 0 inside)
+	std::vector<float> latticeBlockDistanceBounds;
+	glm::ivec3 m_latticeBlockCount = glm::ivec3(0);
+	//SDF the lattice was sampled from, pruned blocks are sampled from it once a brush reaches them
+	std::weak_ptr<USDFComponent> m_sdfComponent;
+	//False until a generation finished sampling the lattice, a cancelled one leaves it partially sampled
+	bool m_bIsLatticeValid = false;
 
-	std::unordered_map<int, int> voxelVertexIndexMap;
+	// -- DENSE VOXEL STORAGE (indexed by GetUniqueIndexForGrid) --
+
+	//Sign changes of the 3 front-most adjacent edges per voxel
+	std::vector<VoxelEdgeCrossings> voxelEdgeCrossings;
+	//Index into the model vertex array (in floats) of the voxel's vertex, -1 if the voxel has no vertex
+	std::vector<int> voxelVertexIndices;
+	//Quad slot in the mesh of each voxel's 3 adjacent edges (voxelIndex * 3 + axis), -1 if the edge emitted no quad
+	std::vector<int> voxelEdgeQuadSlots;
+
+	// -- INCREMENTAL REMESHING --
+
+	//Mesh of the last pass, patched in place by incremental updates
+	MeshBuffers m_mesh;
+	//Faces re-emitted for the dirty region, reused across updates
+	MeshBuffers m_regionFaceBuffers;
+	//Vertex slots (in floats) no longer referenced by any voxel, reused before the vertex array grows
+	std::vector<int> m_freeVertexSlots;
+	bool m_bIsMeshValid = false;
+	bool m_bIsMeshFlatShaded = false;
+	//Two output meshes patched in turn, an update only copies what changed into the one the renderer released
+	std::array<MeshOutputBuffer, 2> m_outputBuffers;
+	int m_lastOutputBuffer = 0;
+	//Vertex numbers and quad slots of the mesh changed by the running patch
+	std::vector<int> m_patchedVertices;
+	std::vector<int> m_patchedQuads;
+
+	//Bounds (inclusive) of lattice points changed by brushes since the last update
+	bool m_bHasDirtyRegion = false;
+	glm::ivec3 m_dirtyLatticeMin = glm::ivec3(0);
+	glm::ivec3 m_dirtyLatticeMax = glm::ivec3(0);
+
+	// -- MULTI-THREADED MESHING --
+
+	//Most threads of the shared job system a meshing pass runs on, from the settings
+	unsigned int m_meshingThreadCount = 1;
+	//Cancellation of the running InitGenerateMesh/UpdateMesh call, checked by the passes between rows of work
+	CancellationToken m_cancellation;
+	//Per-slab output buffers, reused across passes
+	std::vector<MeshSlab> m_meshSlabs;
+
+	// -- OCTREE SIMPLIFICATION --
+
+	//Built from the lattice when octree simplification is enabled
+	std::unique_ptr<DualContouringOctree> m_octree;
 
 private:
 	static int GetUniqueIndexForGrid(const int x, const int y, const int z, const int gridWidth, const int gridHeight);
-	void ClearHashMapData();
+	//Index of a lattice point, a voxel's first corner shares the voxel's x,y,z
+	int GetLatticeIndex(const int x, const int y, const int z) const;
+	//Returns the world position of the voxel's first corner
+	glm::vec3 GetVoxelPosition(const int x, const int y, const int z) const;
+	//Fills the x coordinates of a lattice row starting at lattice x = xBegin
+	void FillLatticeRowX(LatticeRowBuffers& row, const int xBegin = 0) const;
+	//Range (inclusive) of lattice points inside a world-space box, returns false if the box misses the grid
+	bool GetLatticeBounds(const glm::vec3& worldMin, const glm::vec3& worldMax, glm::ivec3& outLatticeMin, glm::ivec3& outLatticeMax) const;
+	int GetLatticeBlockIndex(const int blockX, const int blockY, const int blockZ) const;
+	//Range (inclusive) of lattice points of a block, neighbouring blocks share their boundary points
+	void GetLatticeBlockExtent(const int blockX, const int blockY, const int blockZ, glm::ivec3& outLatticeMin, glm::ivec3& outLatticeMax) const;
+	//Voxels of pruned blocks have no sign change
+	bool IsVoxelBlockSampled(const int x, const int y, const int z) const;
+	//Classifies and samples the whole lattice with m_cancellation, returns false if cancelled
+	bool SampleLatticeFromSDF(const std::shared_ptr<USDFComponent>& sdfComponent, const Settings& settings);
+	//Prunes the blocks whose center distance proves the sign of the whole block
+	void ClassifyLatticeBlocks(const USDFComponent& sdfComponent);
+	//Samples the lattice points of unpruned blocks, points only shared by pruned blocks get their block's distance bound
+	void SampleLattice(const USDFComponent& sdfComponent);
+	//Samples the pruned blocks overlapping a range (inclusive) of lattice points, so edits there start from exact distances
+	void SampleLatticeBlocks(const glm::ivec3& latticeMin, const glm::ivec3& latticeMax);
+	//Samples the distance and normal of the lattice points xBegin..xEnd (inclusive) of a row, row.x must cover the whole row
+	void SampleLatticeRun(const USDFComponent& sdfComponent, LatticeRowBuffers& row, const int xBegin, const int xEnd, const int y, const int z);
+	//Clears per-mesh data (edge crossings, vertex indices and quad slots), corner samples are kept
+	void ClearVoxelMeshData();
+	//Sizes the thread pool from the settings and splits the grid into x-slabs
+	void PrepareMeshSlabs(const Settings& settings);
+	//Concatenates slab vertices in slab order into the mesh and rewrites slab-local voxel vertex indices to merged ones
+	void MergeSlabVertices();
+	//Concatenates slab faces in slab order into the mesh
+	void MergeSlabFaces();
+
+	//Compile-time policies of the meshing pipeline, defined in the source file.
+	//Sample sources provide the hermite data of a crossing edge: LiveSDFSampleSource takes the normal from the SDF gradient,
+	//LatticeSampleSource interpolates the cached lattice normals.
+	struct LiveSDFSampleSource;
+	struct LatticeSampleSource;
+	//Output modes write the triangles of a quad: indexed into the shared vertices, or as flat-shaded duplicated vertices
+	struct IndexedOutput;
+	struct FlatOutput;
+
+	//Rebuilds the whole mesh from the lattice, with the output mode picked from the settings
+	template<typename SampleSource>
+	void GenerateMesh(const SampleSource& sampleSource, const Settings& settings);
+	template<typename SampleSource, typename OutputMode>
+	void GenerateVoxelMesh(const SampleSource& sampleSource, const Settings& settings);
+	//Re-solves the vertices and faces around the dirty region only
+	template<typename OutputMode>
+	void RemeshDirtyRegion();
+	//Builds the mesh with the simplification octree instead of one vertex per voxel
+	void BuildOctreeMesh(const Settings& settings);
+	//Fills the corner signs and QEF of a voxel from the lattice, returns false if the surface does not cross the voxel
+	bool SolveOctreeLeaf(const glm::ivec3& voxel, OctreeLeafData& outLeaf) const;
+	//Clamped factor along the lattice edge between two corners where the distance crosses zero
+	float GetLatticeEdgeInterpolation(const int latticeIndex1, const int latticeIndex2) const;
+	//Hermite data of the surface crossing on the lattice edge between two corners
+	void GetLatticeEdgeCrossing(const int latticeIndex1, const int latticeIndex2, const glm::vec3& cornerPos1, const glm::vec3& cornerPos2, glm::vec3& outPosition, glm::vec3& outNormal) const;
+	//Accumulates the QEF and normal of a voxel from the lattice, returns false if the surface does not cross the voxel
+	template<typename SampleSource>
+	bool AccumulateVoxelQEF(const SampleSource& sampleSource, const int x, const int y, const int z, QEFData& qef, glm::vec3& pointsMin, glm::vec3& pointsMax, glm::vec3& vertexNormal, VoxelEdgeCrossings& adjacentEdgeCrossings) const;
+	//Solves the batched voxels and writes their positions at the batch targets (float offsets into the vertex array), then empties the batch
+	static void SolveVertexBatch(QEFBatch& batch, std::vector<float>& meshVertices);
+	//Emits the quads of a voxel's 3 adjacent edges that have a sign change
+	template<typename OutputMode>
+	void EmitVoxelFaces(const int x, const int y, const int z, const std::vector<float>& meshVertices, MeshBuffers& outBuffers) const;
+	//Emits the faces of every voxel into the mesh
+	template<typename OutputMode>
+	void EmitAllFaces();
+	//Appends quads to the mesh and records their slots
+	void AppendQuads(const MeshBuffers& quads);
+	//Removes a quad from the mesh by moving the last quad into its slot
+	void RemoveQuad(const int quadSlot);
+	//Hands the generated mesh out, moving the buffers when they are not kept for patching
+	SharedMeshData BuildMeshOutput(const Settings& settings);
+	//Brings a released output mesh up to date with the patched mesh and hands it out, or a new one if both are still held
+	SharedMeshData PublishPatchedMesh();
+	//Appends a skirt quad below every open edge of the mesh on the skirted sides of the face range. The voxel vertices
+	//and normals are read from meshVertices/meshNormals, the output may hold them already (indexed) or not (flat shaded).
+	void AppendSkirts(const std::vector<float>& meshVertices, const std::vector<float>& meshNormals, MeshData& output) const;
+	bool IsCancelled() const { return m_cancellation.IsCancelled(); }
+	//Drops the partial mesh of a cancelled call, so the next update starts from scratch
+	SharedMeshData AbortCancelledMesh();
 
 };
@@ -0,0 +1,394 @@
+#include "DualContouringOctree.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "DualContouring.h"
+#include "Math/RNG.h"
+
+namespace
+{
+	//Child pairs sharing a face inside a cell, and the face direction
+	const int cellProcFaceMask[12][3] = { {0,4,0},{1,5,0},{2,6,0},{3,7,0},{0,2,1},{4,6,1},{1,3,1},{5,7,1},{0,1,2},{2,3,2},{4,5,2},{6,7,2} };
+	//Child quads sharing an edge inside a cell, and the edge direction
+	const int cellProcEdgeMask[6][5] = { {0,1,2,3,0},{4,5,6,7,0},{0,4,1,5,1},{2,6,3,7,1},{0,2,4,6,2},{1,3,5,7,2} };
+
+	//Children of the two cells of a face that share a sub-face, and its direction
+	const int faceProcFaceMask[3][4][3] = {
+		{{4,0,0},{5,1,0},{6,2,0},{7,3,0}},
+		{{2,0,1},{6,4,1},{3,1,1},{7,5,1}},
+		{{1,0,2},{3,2,2},{5,4,2},{7,6,2}}
+	};
+	//Children of the two cells of a face that share an edge: node order, 4 children, and the edge direction
+	const int faceProcEdgeMask[3][4][6] = {
+		{{1,4,0,5,1,1},{1,6,2,7,3,1},{0,4,6,0,2,2},{0,5,7,1,3,2}},
+		{{0,2,3,0,1,0},{0,6,7,4,5,0},{1,2,0,6,4,2},{1,3,1,7,5,2}},
+		{{1,1,0,3,2,0},{1,5,4,7,6,0},{0,1,5,0,4,1},{0,3,7,2,6,1}}
+	};
+	//Which of the two cells of a face each node of a shared edge comes from
+	const int faceProcEdgeOrders[2][4] = { { 0, 0, 1, 1 }, { 0, 1, 0, 1 } };
+
+	//Children of the four cells around an edge that share its two halves, and the edge direction
+	const int edgeProcEdgeMask[3][2][5] = {
+		{{3,2,1,0,0},{7,6,5,4,0}},
+		{{5,1,4,0,1},{7,3,6,2,1}},
+		{{6,4,2,0,2},{7,5,3,1,2}}
+	};
+	//Edge (see edgeCorners) of each of the four cells around an edge that is the shared edge
+	const int processEdgeMask[3][4] = { {3,2,1,0},{7,5,6,4},{11,10,9,8} };
+}
+
+const std::array<glm::ivec3, 8> DualContouringOctree::cornerOffsets =
+{
+	glm::ivec3(0, 0, 0),
+	glm::ivec3(0, 0, 1),
+	glm::ivec3(0, 1, 0),
+	glm::ivec3(0, 1, 1),
+	glm::ivec3(1, 0, 0),
+	glm::ivec3(1, 0, 1),
+	glm::ivec3(1, 1, 0),
+	glm::ivec3(1, 1, 1)
+};
+
+const std::array<std::array<int, 2>, 12> DualContouringOctree::edgeCorners =
+{ {
+	{ { 0, 4 } }, { { 1, 5 } }, { { 2, 6 } }, { { 3, 7 } },
+	{ { 0, 2 } }, { { 1, 3 } }, { { 4, 6 } }, { { 5, 7 } },
+	{ { 0, 1 } }, { { 2, 3 } }, { { 4, 5 } }, { { 6, 7 } }
+} };
+
+void DualContouringOctree::Build(const glm::ivec3& gridSize, const glm::ivec3& collapseVoxelMin, const glm::ivec3& collapseVoxelMax, const float errorTolerance, const LeafSolver& solveLeaf)
+{
+	nodes.clear();
+	rootIndex = -1;
+	vertexCount = 0;
+
+	m_gridSize = gridSize;
+	m_errorTolerance = errorTolerance;
+	m_collapseVoxelMin = collapseVoxelMin;
+	m_collapseVoxelMax = collapseVoxelMax;
+
+	//The root covers the grid with a power of two size, cells outside the grid stay empty
+	int rootSize = 1;
+	while (rootSize < std::max(gridSize.x, std::max(gridSize.y, gridSize.z)))
+		rootSize *= 2;
+
+	rootIndex = BuildNode(glm::ivec3(0), rootSize, solveLeaf);
+
+	//Collapsed subtrees were dropped from the pool, so every leaf and collapsed node left has a vertex
+	for (OctreeNode& node : nodes)
+	{
+		if (node.type != EOctreeNodeType::Internal)
+			node.vertexIndex = vertexCount++;
+	}
+}
+
+int DualContouringOctree::BuildNode(const glm::ivec3& min, const int size, const LeafSolver& solveLeaf)
+{
+	if (min.x >= m_gridSize.x || min.y >= m_gridSize.y || min.z >= m_gridSize.z)
+		return -1;
+
+	if (size == 1)
+	{
+		OctreeLeafData leaf;
+		if (!solveLeaf(min, leaf))
+			return -1;
+
+		OctreeNode node;
+		node.type = EOctreeNodeType::Leaf;
+		node.min = min;
+		node.size = 1;
+		node.corners = leaf.corners;
+		node.qef = leaf.qef;
+		node.normalSum = leaf.normalSum;
+		node.pointsMin = leaf.pointsMin;
+		node.pointsMax = leaf.pointsMax;
+		node.position = QEFSolver::SolveWithinBounds(leaf.qef, leaf.pointsMin, leaf.pointsMax);
+
+		nodes.push_back(node);
+		return static_cast<int>(nodes.size()) - 1;
+	}
+
+	//The subtree is appended from here on, so it can be dropped again if the cell collapses
+	const size_t subtreeBegin = nodes.size();
+	const int childSize = size / 2;
+
+	OctreeNode node;
+	node.type = EOctreeNodeType::Internal;
+	node.min = min;
+	node.size = size;
+
+	bool bHasChildren = false;
+	for (int i = 0; i < 8; ++i)
+	{
+		node.children[i] = BuildNode(min + cornerOffsets[i] * childSize, childSize, solveLeaf);
+		bHasChildren |= node.children[i] >= 0;
+	}
+
+	if (!bHasChildren)
+		return -1;
+
+	//Only cells within the collapse range whose children are all leaf or collapsed cells can collapse
+	bool bCanCollapse = true;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		bCanCollapse &= min[axis] >= m_collapseVoxelMin[axis] && min[axis] + size - 1 <= m_collapseVoxelMax[axis];
+	}
+
+	int centerSign = 0;
+	std::array<int, 8> childCornerSigns;
+	childCornerSigns.fill(-1);
+
+	for (int i = 0; i < 8 && bCanCollapse; ++i)
+	{
+		if (node.children[i] < 0)
+			continue;
+
+		const OctreeNode& child = nodes[node.children[i]];
+		if (child.type == EOctreeNodeType::Internal)
+		{
+			bCanCollapse = false;
+			break;
+		}
+
+		node.qef += child.qef;
+		node.normalSum += child.normalSum;
+		node.pointsMin = glm::min(node.pointsMin, child.pointsMin);
+		node.pointsMax = glm::max(node.pointsMax, child.pointsMax);
+
+		//Each child's corner opposite to corner i sits at the cell center
+		centerSign = (child.corners >> (7 - i)) & 1;
+		childCornerSigns[i] = (child.corners >> i) & 1;
+	}
+
+	if (bCanCollapse)
+	{
+		const glm::vec3 position = QEFSolver::SolveWithinBounds(node.qef, node.pointsMin, node.pointsMax);
+
+		if (node.qef.GetError(position) < m_errorTolerance)
+		{
+			node.type = EOctreeNodeType::Pseudo;
+			node.position = position;
+			node.children.fill(-1);
+
+			//Corners of children without surface have the sign of the cell center
+			node.corners = 0;
+			for (int i = 0; i < 8; ++i)
+			{
+				node.corners |= static_cast<uint8_t>((childCornerSigns[i] < 0 ? centerSign : childCornerSigns[i]) << i);
+			}
+
+			nodes.resize(subtreeBegin);
+		}
+	}
+
+	nodes.push_back(node);
+	return static_cast<int>(nodes.size()) - 1;
+}
+
+void DualContouringOctree::EmitMesh(const bool bFlatShade, const glm::ivec3& faceVoxelMin, const glm::ivec3& faceVoxelMax, MeshBuffers& outMesh)
+{
+	m_faceVoxelMin = faceVoxelMin;
+	m_faceVoxelMax = faceVoxelMax;
+
+	//Vertices are stored in vertex index order
+	for (const OctreeNode& node : nodes)
+	{
+		if (node.type == EOctreeNodeType::Internal)
+			continue;
+
+		const glm::vec3 normal = glm::normalize(node.normalSum);
+
+		outMesh.vertices.push_back(node.position.x);
+		outMesh.vertices.push_back(node.position.y);
+		outMesh.vertices.push_back(node.position.z);
+
+		outMesh.normals.push_back(normal.x);
+		outMesh.normals.push_back(normal.y);
+		outMesh.normals.push_back(normal.z);
+	}
+
+	ContourCell(rootIndex, outMesh, bFlatShade);
+}
+
+void DualContouringOctree::ContourCell(const int node, MeshBuffers& outMesh, const bool bFlatShade) const
+{
+	if (node < 0 || nodes[node].type != EOctreeNodeType::Internal)
+		return;
+
+	const std::array<int, 8>& children = nodes[node].children;
+
+	for (int i = 0; i < 8; ++i)
+	{
+		ContourCell(children[i], outMesh, bFlatShade);
+	}
+
+	//Faces and edges shared between the children
+	for (int i = 0; i < 12; ++i)
+	{
+		ContourFace({ { children[cellProcFaceMask[i][0]], children[cellProcFaceMask[i][1]] } }, cellProcFaceMask[i][2], outMesh, bFlatShade);
+	}
+
+	for (int i = 0; i < 6; ++i)
+	{
+		ContourEdge({ { children[cellProcEdgeMask[i][0]], children[cellProcEdgeMask[i][1]], children[cellProcEdgeMask[i][2]], children[cellProcEdgeMask[i][3]] } }, cellProcEdgeMask[i][4], outMesh, bFlatShade);
+	}
+}
+
+void DualContouringOctree::ContourFace(const std::array<int, 2>& faceNodes, const int direction, MeshBuffers& outMesh, const bool bFlatShade) const
+{
+	if (faceNodes[0] < 0 || faceNodes[1] < 0)
+		return;
+
+	const bool bInternal0 = nodes[faceNodes[0]].type == EOctreeNodeType::Internal;
+	const bool bInternal1 = nodes[faceNodes[1]].type == EOctreeNodeType::Internal;
+	if (!bInternal0 && !bInternal1)
+		return;
+
+	//Leaf and collapsed cells stand in for their own children
+	auto getChild = [&](const int nodeIndex, const int child)
+	{
+		return nodes[nodeIndex].type == EOctreeNodeType::Internal ? nodes[nodeIndex].children[child] : nodeIndex;
+	};
+
+	for (int i = 0; i < 4; ++i)
+	{
+		const int* mask = faceProcFaceMask[direction][i];
+		ContourFace({ { getChild(faceNodes[0], mask[0]), getChild(faceNodes[1], mask[1]) } }, mask[2], outMesh, bFlatShade);
+	}
+
+	for (int i = 0; i < 4; ++i)
+	{
+		const int* mask = faceProcEdgeMask[direction][i];
+		const int* order = faceProcEdgeOrders[mask[0]];
+
+		std::array<int, 4> edgeNodes;
+		for (int j = 0; j < 4; ++j)
+		{
+			edgeNodes[j] = getChild(faceNodes[order[j]], mask[j + 1]);
+		}
+
+		ContourEdge(edgeNodes, mask[5], outMesh, bFlatShade);
+	}
+}
+
+void DualContouringOctree::ContourEdge(const std::array<int, 4>& edgeNodes, const int direction, MeshBuffers& outMesh, const bool bFlatShade) const
+{
+	bool bAnyInternal = false;
+	for (const int node : edgeNodes)
+	{
+		if (node < 0)
+			return;
+
+		bAnyInternal |= nodes[node].type == EOctreeNodeType::Internal;
+	}
+
+	if (!bAnyInternal)
+	{
+		EmitEdgeQuad(edgeNodes, direction, outMesh, bFlatShade);
+		return;
+	}
+
+	//Split the edge in two and recurse into the children sharing each half
+	for (int i = 0; i < 2; ++i)
+	{
+		const int* mask = edgeProcEdgeMask[direction][i];
+
+		std::array<int, 4> childNodes;
+		for (int j = 0; j < 4; ++j)
+		{
+			const OctreeNode& node = nodes[edgeNodes[j]];
+			childNodes[j] = node.type == EOctreeNodeType::Internal ? node.children[mask[j]] : edgeNodes[j];
+		}
+
+		ContourEdge(childNodes, mask[4], outMesh, bFlatShade);
+	}
+}
+
+void DualContouringOctree::EmitEdgeQuad(const std::array<int, 4>& edgeNodes, const int direction, MeshBuffers& outMesh, const bool bFlatShade) const
+{
+	//The smallest cell holds the actual edge, its signs decide if there is a face and its winding
+	int minSize = std::numeric_limits<int>::max();
+	int minIndex = 0;
+	bool bFlip = false;
+	std::array<bool, 4> bSignChanges;
+	std::array<int, 4> vertexIndices;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		const OctreeNode& node = nodes[edgeNodes[i]];
+		const std::array<int, 2>& corners = edgeCorners[processEdgeMask[direction][i]];
+		const int sign1 = (node.corners >> corners[0]) & 1;
+		const int sign2 = (node.corners >> corners[1]) & 1;
+
+		if (node.size < minSize)
+		{
+			minSize = node.size;
+			minIndex = i;
+			bFlip = sign1 != 0;
+		}
+
+		vertexIndices[i] = node.vertexIndex;
+		bSignChanges[i] = sign1 != sign2;
+	}
+
+	if (!bSignChanges[minIndex])
+		return;
+
+	//Voxel at the lower end of the actual edge, edges owned by voxels outside the face range are emitted by another grid
+	const OctreeNode& minNode = nodes[edgeNodes[minIndex]];
+	const glm::ivec3 edgeOwner = minNode.min + cornerOffsets[edgeCorners[processEdgeMask[direction][minIndex]][0]] * minNode.size;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (edgeOwner[axis] < m_faceVoxelMin[axis] || edgeOwner[axis] > m_faceVoxelMax[axis])
+			return;
+	}
+
+	//Same winding as the faces of the uniform grid
+	if (bFlip)
+	{
+		EmitTriangle(vertexIndices[0], vertexIndices[1], vertexIndices[3], outMesh, bFlatShade);
+		EmitTriangle(vertexIndices[0], vertexIndices[3], vertexIndices[2], outMesh, bFlatShade);
+	}
+	else
+	{
+		EmitTriangle(vertexIndices[0], vertexIndices[3], vertexIndices[1], outMesh, bFlatShade);
+		EmitTriangle(vertexIndices[0], vertexIndices[2], vertexIndices[3], outMesh, bFlatShade);
+	}
+}
+
+void DualContouringOctree::EmitTriangle(const int vertexIndex1, const int vertexIndex2, const int vertexIndex3, MeshBuffers& outMesh, const bool bFlatShade) const
+{
+	//A collapsed cell can be shared by two corners of a quad, which leaves one of its triangles degenerate
+	if (vertexIndex1 == vertexIndex2 || vertexIndex2 == vertexIndex3 || vertexIndex1 == vertexIndex3)
+		return;
+
+	const std::array<int, 3> triangle = { { vertexIndex1, vertexIndex2, vertexIndex3 } };
+
+	// enable duplicate vertices || //Used for glDrawArrays rather than glDrawElements
+	if (bFlatShade)
+	{
+		for (const int vertexIndex : triangle)
+		{
+			outMesh.duplicateVertices.push_back(outMesh.vertices[vertexIndex * 3]);
+			outMesh.duplicateVertices.push_back(outMesh.vertices[vertexIndex * 3 + 1]);
+			outMesh.duplicateVertices.push_back(outMesh.vertices[vertexIndex * 3 + 2]);
+		}
+
+		//Triangle Color
+		const glm::vec3 triangleColor(RNG::GetRandomFloatNumber(0.0f, 1.0f), RNG::GetRandomFloatNumber(0.0f, 1.0f), RNG::GetRandomFloatNumber(0.0f, 1.0f));
+		for (int i = 0; i < 3; ++i)
+		{
+			outMesh.vertexColors.push_back(triangleColor.x);
+			outMesh.vertexColors.push_back(triangleColor.y);
+			outMesh.vertexColors.push_back(triangleColor.z);
+		}
+	}
+	else
+	{
+		for (const int vertexIndex : triangle)
+		{
+			outMesh.indices.push_back(static_cast<unsigned int>(vertexIndex));
+		}
+	}
+}
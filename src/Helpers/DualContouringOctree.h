@@ -0,0 +1,101 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Math/QEFSolver.h"
+
+struct MeshBuffers;
+
+enum class EOctreeNodeType : uint8_t
+{
+	//Has children
+	Internal,
+	//Collapsed cell, its children were merged into one vertex
+	Pseudo,
+	//Single voxel
+	Leaf
+};
+
+//Surface data of one voxel, filled by the leaf solver
+struct OctreeLeafData
+{
+	//Bit i is set if corner i (see DualContouringOctree::cornerOffsets) is inside the surface
+	uint8_t corners = 0;
+	QEFData qef;
+	//Sum of the intersection normals
+	glm::vec3 normalSum = glm::vec3(0.f);
+	//Bounds of the intersection points
+	glm::vec3 pointsMin = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 pointsMax = glm::vec3(-std::numeric_limits<float>::max());
+};
+
+struct OctreeNode
+{
+	EOctreeNodeType type = EOctreeNodeType::Leaf;
+	//First voxel and size (in voxels) of the cell
+	glm::ivec3 min = glm::ivec3(0);
+	int size = 1;
+	//Node indices of the children of internal nodes, -1 if the child has no surface
+	std::array<int, 8> children{ { -1, -1, -1, -1, -1, -1, -1, -1 } };
+	//Corner signs, same layout as OctreeLeafData::corners
+	uint8_t corners = 0;
+	QEFData qef;
+	glm::vec3 normalSum = glm::vec3(0.f);
+	glm::vec3 pointsMin = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 pointsMax = glm::vec3(-std::numeric_limits<float>::max());
+	glm::vec3 position = glm::vec3(0.f);
+	//Index of the cell's vertex in the mesh, -1 for internal nodes
+	int vertexIndex = -1;
+};
+
+//Dual contouring over an octree built bottom-up from the voxel grid. Sibling cells whose merged QEF error stays below the
+//tolerance are collapsed into a single vertex, so flat regions get far fewer triangles than detailed ones. Faces are
+//generated with the cell/face/edge recursion of Ju et al., "Dual Contouring of Hermite Data".
+class DualContouringOctree
+{
+public:
+
+	//Returns false if the surface does not cross the voxel
+	using LeafSolver = std::function<bool(const glm::ivec3& voxel, OctreeLeafData& outLeaf)>;
+
+	//Offset of corner (or child) i, ordered x * 4 + y * 2 + z
+	static const std::array<glm::ivec3, 8> cornerOffsets;
+	//Corners of each cell edge, 4 edges per axis (x, y, then z)
+	static const std::array<std::array<int, 2>, 12> edgeCorners;
+
+	//Only cells that lie within the collapse range (inclusive voxels) are collapsed, the voxels outside it stay leaves
+	void Build(const glm::ivec3& gridSize, const glm::ivec3& collapseVoxelMin, const glm::ivec3& collapseVoxelMax, const float errorTolerance, const LeafSolver& solveLeaf);
+	//Appends the vertex of every cell and the faces of the edges owned by the face range (inclusive voxels) to the mesh.
+	//Like on the uniform grid, an edge is owned by the voxel at its lower end.
+	void EmitMesh(const bool bFlatShade, const glm::ivec3& faceVoxelMin, const glm::ivec3& faceVoxelMax, MeshBuffers& outMesh);
+
+	int GetVertexCount() const { return vertexCount; }
+	const std::vector<OctreeNode>& GetNodes() const { return nodes; }
+
+private:
+
+	std::vector<OctreeNode> nodes;
+	int rootIndex = -1;
+	int vertexCount = 0;
+
+	glm::ivec3 m_gridSize = glm::ivec3(0);
+	float m_errorTolerance = 0.f;
+	glm::ivec3 m_collapseVoxelMin = glm::ivec3(0);
+	glm::ivec3 m_collapseVoxelMax = glm::ivec3(0);
+	glm::ivec3 m_faceVoxelMin = glm::ivec3(0);
+	glm::ivec3 m_faceVoxelMax = glm::ivec3(0);
+
+	//Returns the node index, -1 if the surface does not cross the cell
+	int BuildNode(const glm::ivec3& min, const int size, const LeafSolver& solveLeaf);
+
+	void ContourCell(const int node, MeshBuffers& outMesh, const bool bFlatShade) const;
+	void ContourFace(const std::array<int, 2>& faceNodes, const int direction, MeshBuffers& outMesh, const bool bFlatShade) const;
+	void ContourEdge(const std::array<int, 4>& edgeNodes, const int direction, MeshBuffers& outMesh, const bool bFlatShade) const;
+	//Emits the quad of the smallest of the 4 leaf or collapsed cells around an edge
+	void EmitEdgeQuad(const std::array<int, 4>& edgeNodes, const int direction, MeshBuffers& outMesh, const bool bFlatShade) const;
+	void EmitTriangle(const int vertexIndex1, const int vertexIndex2, const int vertexIndex3, MeshBuffers& outMesh, const bool bFlatShade) const;
+};
@@ -0,0 +1,281 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+//Tasks a deque holds before Spawn runs new ones inline, a parallel loop queues at most one task per thread
+static constexpr size_t TASK_DEQUE_CAPACITY = 1024;
+
+namespace
+{
+	//Scheduler and worker index of the calling thread, -1 for threads that are not workers
+	thread_local const void* currentJobSystem = nullptr;
+	thread_local int currentWorkerIndex = -1;
+}
+
+JobSystem::TaskDeque::TaskDeque(const size_t capacity)
+	: m_tasks(capacity)
+{
+}
+
+bool JobSystem::TaskDeque::PushBack(const Task& task)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_count == m_tasks.size())
+		return false;
+
+	m_tasks[(m_front + m_count) % m_tasks.size()] = task;
+	++m_count;
+	return true;
+}
+
+bool JobSystem::TaskDeque::PopBack(Task& outTask)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_count == 0)
+		return false;
+
+	--m_count;
+	outTask = m_tasks[(m_front + m_count) % m_tasks.size()];
+	return true;
+}
+
+bool JobSystem::TaskDeque::PopFront(Task& outTask)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_count == 0)
+		return false;
+
+	outTask = m_tasks[m_front];
+	m_front = (m_front + 1) % m_tasks.size();
+	--m_count;
+	return true;
+}
+
+bool JobSystem::TaskDeque::PopGroupTask(const TaskGroup& group, Task& outTask)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = m_count; i-- > 0;)
+	{
+		const size_t index = (m_front + i) % m_tasks.size();
+		if (m_tasks[index].group != &group)
+			continue;
+
+		outTask = m_tasks[index];
+
+		//Close the gap, keeping the order of the tasks behind it
+		for (size_t j = i + 1; j < m_count; ++j)
+			m_tasks[(m_front + j - 1) % m_tasks.size()] = m_tasks[(m_front + j) % m_tasks.size()];
+		--m_count;
+		return true;
+	}
+
+	return false;
+}
+
+JobSystem::JobSystem(unsigned int threadCount)
+{
+	//At least one worker, threads that are not workers only run tasks while they wait
+	const unsigned int workerCount = std::max(ResolveThreadCount(threadCount), 2u) - 1;
+
+	for (unsigned int i = 0; i <= workerCount; ++i)
+		m_deques.push_back(std::make_unique<TaskDeque>(TASK_DEQUE_CAPACITY));
+
+	for (unsigned int i = 0; i < workerCount; ++i)
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this, static_cast<int>(i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_bShuttingDown = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+JobSystem& JobSystem::GetShared()
+{
+	static JobSystem sharedJobSystem(0);
+	return sharedJobSystem;
+}
+
+unsigned int JobSystem::ResolveThreadCount(unsigned int requestedThreadCount)
+{
+	if (requestedThreadCount > 0)
+		return requestedThreadCount;
+
+	//hardware_concurrency() may return 0 if it can't be determined
+	const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads > 0 ? hardwareThreads : 1;
+}
+
+void JobSystem::Spawn(TaskGroup& group, const TaskRef task, const int taskIndex)
+{
+	group.m_pendingTasks.fetch_add(1, std::memory_order_relaxed);
+
+	const Task queuedTask{ task, taskIndex, &group };
+	if (!GetLocalDeque().PushBack(queuedTask))
+	{
+		//Deque is full, there is enough queued work to keep the other threads busy
+		RunTask(queuedTask);
+		return;
+	}
+
+	m_queuedTaskCount.fetch_add(1);
+
+	//Only take the lock if a worker may be sleeping, the counters are sequentially consistent so a worker going to
+	//sleep either sees the new task or is seen here
+	if (m_sleepingWorkerCount.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_wakeCondition.notify_one();
+	}
+}
+
+void JobSystem::Wait(TaskGroup& group)
+{
+	const bool bIsWorker = currentJobSystem == this;
+
+	while (!group.IsDone())
+	{
+		Task task;
+		if (bIsWorker ? TryTakeTask(task) : TryTakeGroupTask(group, task))
+		{
+			RunTask(task);
+			continue;
+		}
+
+		//The remaining tasks of the group are running on other threads (or, for a thread that is not a worker, queued
+		//where it does not look), sleep until the group is done. A worker also wakes up for new tasks to help with.
+		//The checks below are sequentially consistent to pair with the completion check in RunTask.
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_groupWaiterCount.fetch_add(1);
+		if (bIsWorker)
+		{
+			m_sleepingWorkerCount.fetch_add(1);
+			m_wakeCondition.wait(lock, [this, &group]() { return group.m_pendingTasks.load() == 0 || m_queuedTaskCount.load() > 0; });
+			m_sleepingWorkerCount.fetch_sub(1);
+		}
+		else
+		{
+			m_groupDoneCondition.wait(lock, [&group]() { return group.m_pendingTasks.load() == 0; });
+		}
+		m_groupWaiterCount.fetch_sub(1);
+	}
+}
+
+void JobSystem::ParallelFor(int taskCount, const TaskRef task, unsigned int maxParallelism)
+{
+	if (taskCount <= 0)
+		return;
+
+	const unsigned int threadCount = maxParallelism > 0 ? std::min(maxParallelism, GetThreadCount()) : GetThreadCount();
+	const int runnerCount = std::min(taskCount, static_cast<int>(threadCount));
+
+	//Nothing to distribute, run inline
+	if (runnerCount == 1)
+	{
+		for (int i = 0; i < taskCount; ++i)
+			task(i);
+		return;
+	}
+
+	//Each runner takes the next index until all are handed out, so uneven tasks balance themselves. Runners that are
+	//not picked up before the loop is done find no index left and return immediately.
+	std::atomic<int> nextTaskIndex(0);
+	const auto runner = [&](int)
+	{
+		for (int taskIndex = nextTaskIndex.fetch_add(1); taskIndex < taskCount; taskIndex = nextTaskIndex.fetch_add(1))
+			task(taskIndex);
+	};
+
+	TaskGroup group;
+	for (int i = 1; i < runnerCount; ++i)
+		Spawn(group, runner);
+
+	runner(0);
+	Wait(group);
+}
+
+void JobSystem::WorkerLoop(const int workerIndex)
+{
+	currentJobSystem = this;
+	currentWorkerIndex = workerIndex;
+
+	while (true)
+	{
+		Task task;
+		if (TryTakeTask(task))
+		{
+			RunTask(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_sleepingWorkerCount.fetch_add(1);
+		m_wakeCondition.wait(lock, [this]() { return m_bShuttingDown || m_queuedTaskCount.load() > 0; });
+		m_sleepingWorkerCount.fetch_sub(1);
+
+		if (m_bShuttingDown)
+			return;
+	}
+}
+
+bool JobSystem::TryTakeTask(Task& outTask)
+{
+	//Newest own task first, it is the most likely to still be in cache
+	bool bFound = GetLocalDeque().PopBack(outTask);
+
+	//Then the shared queue and the oldest task of every other worker, starting after our own deque to spread the thieves
+	const int dequeCount = static_cast<int>(m_deques.size());
+	const int firstVictim = currentJobSystem == this ? currentWorkerIndex + 1 : 0;
+	for (int i = 0; !bFound && i < dequeCount; ++i)
+	{
+		const int victimIndex = (firstVictim + i) % dequeCount;
+		if (currentJobSystem == this && victimIndex == currentWorkerIndex)
+			continue;
+
+		bFound = m_deques[victimIndex]->PopFront(outTask);
+	}
+
+	if (bFound)
+		m_queuedTaskCount.fetch_sub(1);
+	return bFound;
+}
+
+bool JobSystem::TryTakeGroupTask(const TaskGroup& group, Task& outTask)
+{
+	if (!m_deques.back()->PopGroupTask(group, outTask))
+		return false;
+
+	m_queuedTaskCount.fetch_sub(1);
+	return true;
+}
+
+void JobSystem::RunTask(const Task& task)
+{
+	task.function(task.taskIndex);
+
+	//Children spawned by the task were counted before this, so the group can't finish early
+	const bool bGroupDone = task.group->m_pendingTasks.fetch_sub(1) == 1;
+
+	//The waiter may destroy the group as soon as it sees it done, so only the scheduler is touched from here. Counters are
+	//sequentially consistent, so a waiter going to sleep either sees the group done or is seen here.
+	if (bGroupDone && m_groupWaiterCount.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_groupDoneCondition.notify_all();
+		m_wakeCondition.notify_all();
+	}
+}
+
+JobSystem::TaskDeque& JobSystem::GetLocalDeque()
+{
+	if (currentJobSystem == this)
+		return *m_deques[currentWorkerIndex];
+
+	return *m_deques.back();
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Non-owning reference to a task callable. Unlike std::function it never allocates, the callable must outlive the call it is passed to.
+class TaskRef
+{
+public:
+	//Empty reference, it must be assigned before it is called
+	TaskRef() = default;
+
+	template<typename Task>
+	TaskRef(const Task& task)
+		: m_task(&task), m_invoke([](const void* task, const int taskIndex) { (*static_cast<const Task*>(task))(taskIndex); })
+	{
+	}
+
+	void operator()(const int taskIndex) const { m_invoke(m_task, taskIndex); }
+
+private:
+	const void* m_task = nullptr;
+	void (*m_invoke)(const void*, int) = nullptr;
+};
+
+//Counts the unfinished tasks spawned into it. A task may spawn children into the group it runs in, the group is only
+//done once they finished too, so waiting on a parent's group also waits for its children.
+class TaskGroup
+{
+public:
+	TaskGroup() = default;
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	bool IsDone() const { return m_pendingTasks.load(std::memory_order_acquire) == 0; }
+
+private:
+	std::atomic<int> m_pendingTasks{ 0 };
+
+	friend class JobSystem;
+};
+
+//Lets long running work notice that its result is no longer wanted. The work keeps the generation it was requested at
+//and is cancelled once the requester's generation moved past it, it is expected to check at regular checkpoints.
+class CancellationToken
+{
+public:
+	//Never cancelled
+	CancellationToken() = default;
+	CancellationToken(const std::atomic<uint64_t>& latestGeneration, const uint64_t generation)
+		: m_latestGeneration(&latestGeneration), m_generation(generation)
+	{
+	}
+
+	bool IsCancelled() const { return m_latestGeneration && m_latestGeneration->load(std::memory_order_relaxed) != m_generation; }
+
+private:
+	const std::atomic<uint64_t>* m_latestGeneration = nullptr;
+	uint64_t m_generation = 0;
+};
+
+//Work-stealing task scheduler shared by every subsystem, so running several of them at once never starts more threads
+//than there are cores. Each worker owns a deque: it pushes and pops its own tasks at the back and idle workers steal
+//from the front of the others. Threads that are not workers push into a shared queue and, while they wait on a group, only
+//run the queued tasks of that group, so a render thread never picks up unrelated long running work.
+class JobSystem
+{
+public:
+	//Thread count includes one thread that is not a worker (the caller), 0 uses all hardware threads
+	explicit JobSystem(unsigned int threadCount);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	//Scheduler used by meshing, brushes and I/O, sized to the hardware threads
+	static JobSystem& GetShared();
+
+	unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_workers.size()) + 1; }
+
+	//Queues task(taskIndex). The callable behind the reference must stay alive until the group is done.
+	void Spawn(TaskGroup& group, const TaskRef task, const int taskIndex = 0);
+	//Blocks until every task of the group finished. Workers run any queued task meanwhile, other threads only the tasks of
+	//the group. Once there is nothing left to run, the thread sleeps until the group is done.
+	void Wait(TaskGroup& group);
+
+	//Runs task(i) for every i in [0, taskCount) and blocks until all of them have finished. At most maxParallelism
+	//threads (0 = no limit) work on the loop, the calling thread takes indices too. Indices are handed out in order
+	//but may finish in any order.
+	void ParallelFor(int taskCount, const TaskRef task, unsigned int maxParallelism = 0);
+
+	//Resolves a requested thread count (0 = all hardware threads) to an actual thread count
+	static unsigned int ResolveThreadCount(unsigned int requestedThreadCount);
+
+private:
+	struct Task
+	{
+		TaskRef function;
+		int taskIndex = 0;
+		TaskGroup* group = nullptr;
+	};
+
+	//Fixed-capacity double-ended queue, the owner works at the back and thieves take from the front
+	class TaskDeque
+	{
+	public:
+		explicit TaskDeque(size_t capacity);
+
+		//Returns false if the deque is full
+		bool PushBack(const Task& task);
+		bool PopBack(Task& outTask);
+		bool PopFront(Task& outTask);
+		//Newest task of the group, wherever it is in the deque
+		bool PopGroupTask(const TaskGroup& group, Task& outTask);
+
+	private:
+		std::mutex m_mutex;
+		std::vector<Task> m_tasks;
+		//Index of the front task and number of queued tasks, the deque wraps around
+		size_t m_front = 0;
+		size_t m_count = 0;
+	};
+
+	void WorkerLoop(const int workerIndex);
+	//Own deque first, then the shared queue, then steal from the other workers
+	bool TryTakeTask(Task& outTask);
+	//Only looks at the shared queue, where threads that are not workers spawn their tasks
+	bool TryTakeGroupTask(const TaskGroup& group, Task& outTask);
+	void RunTask(const Task& task);
+	//Deque of the calling thread, the shared queue for threads that are not workers of this scheduler
+	TaskDeque& GetLocalDeque();
+
+private:
+	std::vector<std::thread> m_workers;
+	//One deque per worker, followed by the shared queue
+	std::vector<std::unique_ptr<TaskDeque>> m_deques;
+
+	//Queued tasks across all deques, idle workers sleep while it is zero
+	std::atomic<int> m_queuedTaskCount{ 0 };
+	std::atomic<int> m_sleepingWorkerCount{ 0 };
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wakeCondition;
+	//Threads sleeping in Wait, woken when any group they may be waiting on finishes. Workers sleep on m_wakeCondition
+	//instead so new tasks wake them too.
+	std::atomic<int> m_groupWaiterCount{ 0 };
+	std::condition_variable m_groupDoneCondition;
+	std::atomic<bool> m_bShuttingDown{ false };
+};
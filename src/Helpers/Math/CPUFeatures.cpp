@@ -0,0 +1,85 @@
+#include "CPUFeatures.h"
+
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_FEATURES_X86 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define CPU_FEATURES_X86 1
+#endif
+
+namespace
+{
+#if CPU_FEATURES_X86
+	//EAX, EBX, ECX and EDX of a cpuid leaf, zero if the leaf is not supported
+	void QueryCPUID(const uint32_t leaf, const uint32_t subleaf, uint32_t outRegisters[4])
+	{
+#if defined(_MSC_VER)
+		int maxRegisters[4];
+		__cpuid(maxRegisters, 0);
+		if (static_cast<uint32_t>(maxRegisters[0]) < leaf)
+		{
+			outRegisters[0] = outRegisters[1] = outRegisters[2] = outRegisters[3] = 0;
+			return;
+		}
+
+		int registers[4];
+		__cpuidex(registers, static_cast<int>(leaf), static_cast<int>(subleaf));
+		for (int i = 0; i < 4; ++i)
+			outRegisters[i] = static_cast<uint32_t>(registers[i]);
+#else
+		if (__get_cpuid_max(0, nullptr) < leaf)
+		{
+			outRegisters[0] = outRegisters[1] = outRegisters[2] = outRegisters[3] = 0;
+			return;
+		}
+
+		__cpuid_count(leaf, subleaf, outRegisters[0], outRegisters[1], outRegisters[2], outRegisters[3]);
+#endif
+	}
+
+	//Register state the operating system saves on context switches (XCR0)
+	uint64_t GetEnabledRegisterState()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32_t low, high;
+		__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+	}
+
+	bool DetectAVX2()
+	{
+		uint32_t registers[4];
+
+		//Leaf 1 ECX: bit 27 OSXSAVE (xgetbv is available), bit 28 AVX
+		QueryCPUID(1, 0, registers);
+		const uint32_t osxsaveAndAVX = (1u << 27) | (1u << 28);
+		if ((registers[2] & osxsaveAndAVX) != osxsaveAndAVX)
+			return false;
+
+		//XCR0 bits 1 and 2: SSE and AVX state are enabled by the OS
+		if ((GetEnabledRegisterState() & 0x6) != 0x6)
+			return false;
+
+		//Leaf 7 EBX: bit 5 AVX2
+		QueryCPUID(7, 0, registers);
+		return (registers[1] & (1u << 5)) != 0;
+	}
+#else
+	bool DetectAVX2()
+	{
+		return false;
+	}
+#endif
+}
+
+bool CPUFeatures::HasAVX2()
+{
+	static const bool bHasAVX2 = DetectAVX2();
+	return bHasAVX2;
+}
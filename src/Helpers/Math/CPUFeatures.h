@@ -0,0 +1,11 @@
+#pragma once
+
+//Instruction sets that are only used after a runtime check, everything else (up to SSE2 on x64) is assumed
+class CPUFeatures
+{
+public:
+
+	//True if the CPU supports AVX2 and the operating system saves the AVX registers on context switches.
+	//Queried once, the result is cached.
+	static bool HasAVX2();
+};
@@ -0,0 +1,203 @@
+#pragma once
+#include "QEFSolver.h"
+#include "SIMDLane.h"
+
+//Solve kernel shared by QEFSolver.cpp (SSE and scalar lanes) and QEFSolverAVX2.cpp (AVX2 lanes). Each lane type must only
+//be instantiated in one of the two files, or the linker may keep the AVX2 copy of the kernel for the whole program.
+namespace QEFSolveKernel
+{
+	//Singular values below this fraction of the largest one are treated as zero
+	constexpr float SINGULAR_VALUE_TRUNCATION = 0.1f;
+	//Jacobi sweeps, a 3x3 symmetric matrix converges to float precision in a handful
+	constexpr int JACOBI_SWEEPS = 5;
+	//Off-diagonal entries below this are already zero, their rotation is skipped
+	constexpr float JACOBI_EPSILON = 1e-12f;
+	//Margin around the bounds before a solution is rejected
+	constexpr float BOUNDS_EPSILON = 1e-3f;
+
+	//Floats gathered per cell: A^T A (6), A^T b (3), mass point sum (3), point count, bounds min (3) and max (3)
+	constexpr int GATHERED_FIELD_COUNT = 19;
+
+	using SolveFunction = int(*)(const QEFData* qefs, const glm::vec3* boundsMin, const glm::vec3* boundsMax, const int count, glm::vec3* outPositions, int cellIndex, QEFSolverStats& ioStats);
+
+	//Defined in QEFSolverAVX2.cpp, nullptr if that file was built without AVX2. Only call it if CPUFeatures::HasAVX2().
+	SolveFunction GetAVX2Kernel();
+
+	//Number of lanes set in a mask
+	template<typename Lane>
+	int CountLanes(const typename Lane::Mask mask)
+	{
+		int count = 0;
+		for (int bits = Lane::MaskBits(mask); bits != 0; bits &= bits - 1)
+			++count;
+		return count;
+	}
+
+	//Zeroes matrix[p][q] with a Jacobi rotation, accumulating the rotation into the eigenvectors.
+	//Lanes whose entry is already zero get the identity rotation instead of a branch.
+	template<typename Lane>
+	void JacobiRotate(typename Lane::Float matrix[3][3], typename Lane::Float eigenvectors[3][3], const int p, const int q)
+	{
+		using Float = typename Lane::Float;
+		const Float zero = Lane::Set(0.f), one = Lane::Set(1.f);
+
+		const typename Lane::Mask bSkip = Lane::Less(Lane::Abs(matrix[p][q]), Lane::Set(JACOBI_EPSILON));
+		const Float offDiagonal = Lane::Select(bSkip, one, matrix[p][q]);
+
+		const Float theta = Lane::Div(Lane::Sub(matrix[q][q], matrix[p][p]), Lane::Mul(Lane::Set(2.f), offDiagonal));
+		const Float sign = Lane::Select(Lane::GreaterEqual(theta, zero), one, Lane::Set(-1.f));
+		const Float t = Lane::Div(sign, Lane::Add(Lane::Abs(theta), Lane::Sqrt(Lane::Add(Lane::Mul(theta, theta), one))));
+		const Float cosine = Lane::Div(one, Lane::Sqrt(Lane::Add(Lane::Mul(t, t), one)));
+		const Float c = Lane::Select(bSkip, one, cosine);
+		const Float s = Lane::Select(bSkip, zero, Lane::Mul(t, cosine));
+
+		//A' = J^T A J, only rows and columns p and q change
+		for (int k = 0; k < 3; ++k)
+		{
+			const Float kp = matrix[k][p];
+			const Float kq = matrix[k][q];
+			matrix[k][p] = Lane::Sub(Lane::Mul(c, kp), Lane::Mul(s, kq));
+			matrix[k][q] = Lane::Add(Lane::Mul(s, kp), Lane::Mul(c, kq));
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			const Float pk = matrix[p][k];
+			const Float qk = matrix[q][k];
+			matrix[p][k] = Lane::Sub(Lane::Mul(c, pk), Lane::Mul(s, qk));
+			matrix[q][k] = Lane::Add(Lane::Mul(s, pk), Lane::Mul(c, qk));
+		}
+
+		for (int k = 0; k < 3; ++k)
+		{
+			const Float kp = eigenvectors[k][p];
+			const Float kq = eigenvectors[k][q];
+			eigenvectors[k][p] = Lane::Sub(Lane::Mul(c, kp), Lane::Mul(s, kq));
+			eigenvectors[k][q] = Lane::Add(Lane::Mul(s, kp), Lane::Mul(c, kq));
+		}
+	}
+
+	//Solves whole lane groups starting at cellIndex and returns the index of the first cell it did not solve.
+	//Bounds are optional, without them the unclamped solution is returned.
+	template<typename Lane>
+	int SolveKernel(const QEFData* qefs, const glm::vec3* boundsMin, const glm::vec3* boundsMax, const int count, glm::vec3* outPositions, int cellIndex, QEFSolverStats& ioStats)
+	{
+		using Float = typename Lane::Float;
+		using Mask = typename Lane::Mask;
+		const Float zero = Lane::Set(0.f), one = Lane::Set(1.f);
+		const Mask allLanes = Lane::GreaterEqual(zero, zero);
+
+		for (; cellIndex + Lane::Width <= count; cellIndex += Lane::Width)
+		{
+			//Gather the accumulators of the lane group into structure-of-arrays form
+			float gathered[GATHERED_FIELD_COUNT][Lane::Width];
+			for (int lane = 0; lane < Lane::Width; ++lane)
+			{
+				const QEFData& qef = qefs[cellIndex + lane];
+				for (int i = 0; i < 6; ++i)
+					gathered[i][lane] = qef.ATA[i];
+				//Components are copied one by one, see the note in QEFSolverAVX2.cpp
+				gathered[6][lane] = qef.ATb.x;
+				gathered[7][lane] = qef.ATb.y;
+				gathered[8][lane] = qef.ATb.z;
+				gathered[9][lane] = qef.massPointSum.x;
+				gathered[10][lane] = qef.massPointSum.y;
+				gathered[11][lane] = qef.massPointSum.z;
+				gathered[13][lane] = boundsMin ? boundsMin[cellIndex + lane].x : 0.f;
+				gathered[14][lane] = boundsMin ? boundsMin[cellIndex + lane].y : 0.f;
+				gathered[15][lane] = boundsMin ? boundsMin[cellIndex + lane].z : 0.f;
+				gathered[16][lane] = boundsMax ? boundsMax[cellIndex + lane].x : 0.f;
+				gathered[17][lane] = boundsMax ? boundsMax[cellIndex + lane].y : 0.f;
+				gathered[18][lane] = boundsMax ? boundsMax[cellIndex + lane].z : 0.f;
+				gathered[12][lane] = static_cast<float>(qef.pointCount);
+			}
+
+			Float ATA[6];
+			for (int i = 0; i < 6; ++i)
+				ATA[i] = Lane::Load(gathered[i]);
+
+			//Cells without points have a zero sum, so clamping the count keeps their mass point at the origin
+			const Float pointCount = Lane::Max(Lane::Load(gathered[12]), one);
+			Float massPoint[3];
+			for (int axis = 0; axis < 3; ++axis)
+				massPoint[axis] = Lane::Div(Lane::Load(gathered[9 + axis]), pointCount);
+
+			//A^T A is symmetric positive semi-definite, so its eigen decomposition is its SVD
+			const Float matrixRows[3][3] =
+			{
+				{ ATA[0], ATA[1], ATA[2] },
+				{ ATA[1], ATA[3], ATA[4] },
+				{ ATA[2], ATA[4], ATA[5] }
+			};
+			Float matrix[3][3];
+			for (int row = 0; row < 3; ++row)
+				for (int column = 0; column < 3; ++column)
+					matrix[row][column] = matrixRows[row][column];
+			Float eigenvectors[3][3] = { { one, zero, zero }, { zero, one, zero }, { zero, zero, one } };
+
+			for (int sweep = 0; sweep < JACOBI_SWEEPS; ++sweep)
+			{
+				JacobiRotate<Lane>(matrix, eigenvectors, 0, 1);
+				JacobiRotate<Lane>(matrix, eigenvectors, 0, 2);
+				JacobiRotate<Lane>(matrix, eigenvectors, 1, 2);
+			}
+
+			const Float largestSingularValue = Lane::Max(Lane::Abs(matrix[0][0]), Lane::Max(Lane::Abs(matrix[1][1]), Lane::Abs(matrix[2][2])));
+			const Float truncationThreshold = Lane::Mul(Lane::Set(SINGULAR_VALUE_TRUNCATION), largestSingularValue);
+
+			//Solve A^T A (x - m) = A^T b - A^T A m, so truncated directions stay at the mass point
+			Float residual[3];
+			for (int row = 0; row < 3; ++row)
+			{
+				const Float product = Lane::Add(Lane::Add(Lane::Mul(matrixRows[row][0], massPoint[0]), Lane::Mul(matrixRows[row][1], massPoint[1])), Lane::Mul(matrixRows[row][2], massPoint[2]));
+				residual[row] = Lane::Sub(Lane::Load(gathered[6 + row]), product);
+			}
+
+			Float offset[3] = { zero, zero, zero };
+			Mask bTruncated = Lane::Less(zero, zero);
+
+			for (int i = 0; i < 3; ++i)
+			{
+				const Float singularValue = matrix[i][i];
+				const Mask bKeep = Lane::Less(truncationThreshold, Lane::Abs(singularValue));
+				bTruncated = Lane::Or(bTruncated, Lane::AndNot(bKeep, allLanes));
+
+				const Float projection = Lane::Add(Lane::Add(Lane::Mul(eigenvectors[0][i], residual[0]), Lane::Mul(eigenvectors[1][i], residual[1])), Lane::Mul(eigenvectors[2][i], residual[2]));
+				const Float scale = Lane::Select(bKeep, Lane::Div(projection, Lane::Select(bKeep, singularValue, one)), zero);
+
+				for (int axis = 0; axis < 3; ++axis)
+					offset[axis] = Lane::Add(offset[axis], Lane::Mul(eigenvectors[axis][i], scale));
+			}
+
+			Float position[3];
+			Mask bOutOfBounds = Lane::Less(zero, zero);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				position[axis] = Lane::Add(massPoint[axis], offset[axis]);
+
+				if (boundsMin)
+				{
+					const Float low = Lane::Sub(Lane::Load(gathered[13 + axis]), Lane::Set(BOUNDS_EPSILON));
+					const Float high = Lane::Add(Lane::Load(gathered[16 + axis]), Lane::Set(BOUNDS_EPSILON));
+					bOutOfBounds = Lane::Or(bOutOfBounds, Lane::Or(Lane::Less(position[axis], low), Lane::Less(high, position[axis])));
+				}
+			}
+
+			//Scatter the positions back to the cells, falling back to the mass point where the solution left the bounds
+			float scattered[3][Lane::Width];
+			for (int axis = 0; axis < 3; ++axis)
+				Lane::Store(scattered[axis], Lane::Select(bOutOfBounds, massPoint[axis], position[axis]));
+
+			for (int lane = 0; lane < Lane::Width; ++lane)
+			{
+				outPositions[cellIndex + lane].x = scattered[0][lane];
+				outPositions[cellIndex + lane].y = scattered[1][lane];
+				outPositions[cellIndex + lane].z = scattered[2][lane];
+			}
+
+			ioStats.truncatedSolves += CountLanes<Lane>(bTruncated);
+			ioStats.massPointFallbacks += CountLanes<Lane>(bOutOfBounds);
+		}
+
+		return cellIndex;
+	}
+}
@@ -0,0 +1,66 @@
+#include "QEFSolver.h"
+
+#include <atomic>
+
+#include "CPUFeatures.h"
+#include "QEFSolveKernel.h"
+
+namespace
+{
+	//Picked once at startup, nullptr on CPUs (or operating systems) without AVX2 support
+	const QEFSolveKernel::SolveFunction avx2SolveKernel = CPUFeatures::HasAVX2() ? QEFSolveKernel::GetAVX2Kernel() : nullptr;
+
+	std::atomic<uint32_t> truncatedSolveCount(0);
+	std::atomic<uint32_t> massPointFallbackCount(0);
+
+	void RunSolve(const QEFData* qefs, const glm::vec3* boundsMin, const glm::vec3* boundsMax, const int count, glm::vec3* outPositions)
+	{
+		QEFSolverStats stats;
+		int cellIndex = 0;
+		//8 cells at a time where the CPU supports AVX2, then 4 and 1 for the rest
+		if (avx2SolveKernel)
+			cellIndex = avx2SolveKernel(qefs, boundsMin, boundsMax, count, outPositions, cellIndex, stats);
+#if SIMD_LANE_SSE
+		cellIndex = QEFSolveKernel::SolveKernel<SSELane>(qefs, boundsMin, boundsMax, count, outPositions, cellIndex, stats);
+#endif
+		QEFSolveKernel::SolveKernel<ScalarLane>(qefs, boundsMin, boundsMax, count, outPositions, cellIndex, stats);
+
+		if (stats.truncatedSolves > 0)
+			truncatedSolveCount.fetch_add(stats.truncatedSolves, std::memory_order_relaxed);
+		if (stats.massPointFallbacks > 0)
+			massPointFallbackCount.fetch_add(stats.massPointFallbacks, std::memory_order_relaxed);
+	}
+}
+
+glm::vec3 QEFSolver::Solve(const QEFData& qef)
+{
+	glm::vec3 position;
+	RunSolve(&qef, nullptr, nullptr, 1, &position);
+	return position;
+}
+
+glm::vec3 QEFSolver::SolveWithinBounds(const QEFData& qef, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	glm::vec3 position;
+	RunSolve(&qef, &boundsMin, &boundsMax, 1, &position);
+	return position;
+}
+
+void QEFSolver::SolveBatch(QEFBatch& batch)
+{
+	RunSolve(batch.qefs.data(), batch.boundsMin.data(), batch.boundsMax.data(), batch.count, batch.positions.data());
+}
+
+QEFSolverStats QEFSolver::GetStats()
+{
+	QEFSolverStats stats;
+	stats.truncatedSolves = truncatedSolveCount.load(std::memory_order_relaxed);
+	stats.massPointFallbacks = massPointFallbackCount.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void QEFSolver::ResetStats()
+{
+	truncatedSolveCount.store(0, std::memory_order_relaxed);
+	massPointFallbackCount.store(0, std::memory_order_relaxed);
+}
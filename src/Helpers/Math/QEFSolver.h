@@ -1,79 +1,116 @@
 #pragma once
-#include <vector>
-#include <glm/vec3.hpp>
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
 
-#include "Helpers/DualContouring.h"
-
-class QEFSolver
+//Least squares system of a set of hermite planes (n . x = n . p), stored as fixed-size sums so it can be built one
+//intersection at a time without allocating. The QEFs of neighbouring cells can be summed to get the QEF of the merged cell.
+struct QEFData
 {
-public:
-
-	static glm::vec3 ComputeBestVertexPosition(const std::vector<HermiteData>& hermiteDataPoints)
+	//Upper triangle of A^T A (xx, xy, xz, yy, yz, zz)
+	std::array<float, 6> ATA{ { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f } };
+	glm::vec3 ATb = glm::vec3(0.f);
+	float btb = 0.f;
+	glm::vec3 massPointSum = glm::vec3(0.f);
+	int pointCount = 0;
+
+	void Add(const glm::vec3& position, const glm::vec3& normal)
 	{
+		const float d = glm::dot(normal, position);
+
+		ATA[0] += normal.x * normal.x;
+		ATA[1] += normal.x * normal.y;
+		ATA[2] += normal.x * normal.z;
+		ATA[3] += normal.y * normal.y;
+		ATA[4] += normal.y * normal.z;
+		ATA[5] += normal.z * normal.z;
+		ATb += normal * d;
+		btb += d * d;
+		massPointSum += position;
+		++pointCount;
+	}
 
-        // Define A^T A and A^T b matrices
-        glm::mat3 ATA(0.0f);
-        glm::vec3 ATb(0.0f);
-
-        // Compute A^T A and A^T b
-        for (const auto& data : hermiteDataPoints) {
-            glm::vec3 n = data.normal;
-            float d = glm::dot(n, data.position); // b_i = n_i . p_i
-
-            glm::mat3 outerProduct = glm::outerProduct(n, n); // n_i * n_i^T
-            ATA += outerProduct; // Accumulate A^T A
-            ATb += n * d; // Accumulate A^T b
-        }
-
-        // Check for rank deficiency
-        float determinant = glm::determinant(ATA);
-        if (glm::abs(determinant) < 1e-6f) { // Small determinant means nearly singular
-            std::cout << "Rank deficient case detected. Using centroid instead.\n";
-
-            glm::vec3 pos(0.0);
-
-             //Get centroid of intersection positions 
-             for (const auto& data: hermiteDataPoints)
-	        	pos += data.position;
-
-            pos = pos / static_cast<float>(hermiteDataPoints.size());
-            return pos;
-        }
-
-        // Solve the system A^T A * x = A^T b
-        glm::vec3 x = glm::inverse(ATA) * ATb; // Solve for x using matrix inverse
-
-        
-        glm::vec3 minBound(FLT_MAX), maxBound(-FLT_MAX);
+	QEFData& operator+=(const QEFData& other)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			ATA[i] += other.ATA[i];
+		}
+		ATb += other.ATb;
+		btb += other.btb;
+		massPointSum += other.massPointSum;
+		pointCount += other.pointCount;
+		return *this;
+	}
 
-        for (const auto& data : hermiteDataPoints) 
-        {
-            minBound = glm::min(minBound, data.position);
-            maxBound = glm::max(maxBound, data.position);
-        }
+	glm::vec3 GetMassPoint() const { return pointCount > 0 ? massPointSum / static_cast<float>(pointCount) : glm::vec3(0.f); }
 
-        // Sanity: Check if x lies within voxel bounds (with a small margin)
-        const float epsilon = 1e-3f;
-        if (x.x < minBound.x - epsilon || x.x > maxBound.x + epsilon ||
-            x.y < minBound.y - epsilon || x.y > maxBound.y + epsilon ||
-            x.z < minBound.z - epsilon || x.z > maxBound.z + epsilon)
-        {
-            std::cout << "Outside voxel bounds! Returning to centroid.\n";
-            glm::vec3 pos(0.0);
+	//A^T A * v
+	glm::vec3 MultiplyATA(const glm::vec3& v) const
+	{
+		return glm::vec3(ATA[0] * v.x + ATA[1] * v.y + ATA[2] * v.z,
+			ATA[1] * v.x + ATA[3] * v.y + ATA[4] * v.z,
+			ATA[2] * v.x + ATA[4] * v.y + ATA[5] * v.z);
+	}
 
-            //Get centroid of intersection positions 
-            for (const auto& data : hermiteDataPoints)
-                pos += data.position;
+	//Sum of the squared distances from a position to all planes (clamped, float cancellation can make it slightly negative)
+	float GetError(const glm::vec3& position) const
+	{
+		return glm::max(glm::dot(position, MultiplyATA(position)) - 2.f * glm::dot(position, ATb) + btb, 0.f);
+	}
+};
 
-            pos = pos / static_cast<float>(hermiteDataPoints.size());
-            return pos;
-        }
+//Fallbacks taken by the solver since the last reset
+struct QEFSolverStats
+{
+	//Solves where a singular value was truncated (flat or edge-like surface), the vertex moves toward the mass point along those directions
+	uint32_t truncatedSolves = 0;
+	//Solves whose result left the bounds and was replaced by the mass point
+	uint32_t massPointFallbacks = 0;
+};
 
+//Cells gathered to be solved together by QEFSolver::SolveBatch
+struct QEFBatch
+{
+	//Two AVX2 lane groups per batch, or four SSE ones on CPUs without AVX2
+	static constexpr int Capacity = 16;
 
-        return x;
+	std::array<QEFData, Capacity> qefs;
+	std::array<glm::vec3, Capacity> boundsMin;
+	std::array<glm::vec3, Capacity> boundsMax;
+	//Where the caller stores each solved position (e.g. an offset into a vertex array)
+	std::array<int, Capacity> targets;
+	//Filled by SolveBatch
+	std::array<glm::vec3, Capacity> positions;
+	int count = 0;
 
+	bool IsFull() const { return count == Capacity; }
 
+	void Add(const QEFData& qef, const glm::vec3& pointsMin, const glm::vec3& pointsMax, const int target)
+	{
+		qefs[count] = qef;
+		boundsMin[count] = pointsMin;
+		boundsMax[count] = pointsMax;
+		targets[count] = target;
+		++count;
 	}
 };
 
+class QEFSolver
+{
+public:
 
+	//Minimizes the QEF with a pseudo-inverse of A^T A (from its SVD) around the mass point. Singular values that are small
+	//relative to the largest are truncated, so under-determined directions keep the mass point instead of blowing up.
+	static glm::vec3 Solve(const QEFData& qef);
+	//Solve, falling back to the mass point if the solution leaves the bounds (of the intersection points) by more than a small margin
+	static glm::vec3 SolveWithinBounds(const QEFData& qef, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	//SolveWithinBounds for every cell of the batch. Cells are solved a lane group at a time with a branch-free Jacobi
+	//decomposition, the results match the single-cell solve bit for bit as long as the compiler doesn't contract
+	//multiplies and adds into FMAs (MSVC's /fp:precise doesn't).
+	static void SolveBatch(QEFBatch& batch);
+
+	//Fallbacks are counted rather than logged, since vertices are solved from many threads
+	static QEFSolverStats GetStats();
+	static void ResetStats();
+};
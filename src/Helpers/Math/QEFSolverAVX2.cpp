@@ -0,0 +1,16 @@
+//Compiled with /arch:AVX2 (see the project file), so only the AVX2 instantiation of the kernel may live here.
+//Anything else inlined from a shared header (e.g. glm::vec3 math) could be emitted with AVX2 instructions and picked by
+//the linker for every caller, which is why the kernel copies vectors one component at a time.
+#include "QEFSolveKernel.h"
+
+namespace QEFSolveKernel
+{
+	SolveFunction GetAVX2Kernel()
+	{
+#if SIMD_LANE_AVX2
+		return &SolveKernel<AVX2Lane>;
+#else
+		return nullptr;
+#endif
+	}
+}
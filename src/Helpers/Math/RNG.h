@@ -6,8 +6,9 @@ class RNG
 public:
 	static inline float GetRandomFloatNumber(float minValue, float maxValue)
 	{
-		static std::random_device rd;
-		static std::mt19937 gen(rd());
+		//Generator per thread, as meshing slabs request colors concurrently
+		static thread_local std::random_device rd;
+		static thread_local std::mt19937 gen(rd());
 		std::uniform_real_distribution<float> dist(minValue, maxValue);
 		return dist(gen);
 	}
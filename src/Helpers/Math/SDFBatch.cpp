@@ -0,0 +1,75 @@
+#include "SDFBatch.h"
+
+#include "CPUFeatures.h"
+#include "SDFBatchKernels.h"
+
+namespace
+{
+	//Picked once at startup, nullptr on CPUs (or operating systems) without AVX2 support
+	const SDFBatchKernels::KernelSet* const avx2Kernels = CPUFeatures::HasAVX2() ? SDFBatchKernels::GetAVX2Kernels() : nullptr;
+
+	void RunSphere(const glm::vec3& center, const float radius, const SDFBatchPoints& points, float* outDistances, SDFBatchGradients* outGradients)
+	{
+		int pointIndex = 0;
+		if (avx2Kernels)
+			pointIndex = avx2Kernels->sphere(center, radius, points, outDistances, outGradients, pointIndex);
+#if SIMD_LANE_SSE
+		pointIndex = SDFBatchKernels::SphereKernel<SSELane>(center, radius, points, outDistances, outGradients, pointIndex);
+#endif
+		SDFBatchKernels::SphereKernel<ScalarLane>(center, radius, points, outDistances, outGradients, pointIndex);
+	}
+
+	void RunBox(const glm::vec3& center, const glm::vec3& halfExtents, const SDFBatchPoints& points, float* outDistances, SDFBatchGradients* outGradients)
+	{
+		int pointIndex = 0;
+		if (avx2Kernels)
+			pointIndex = avx2Kernels->box(center, halfExtents, points, outDistances, outGradients, pointIndex);
+#if SIMD_LANE_SSE
+		pointIndex = SDFBatchKernels::BoxKernel<SSELane>(center, halfExtents, points, outDistances, outGradients, pointIndex);
+#endif
+		SDFBatchKernels::BoxKernel<ScalarLane>(center, halfExtents, points, outDistances, outGradients, pointIndex);
+	}
+
+	void RunUnion(const float* distances, const SDFBatchGradients* gradients, float* ioDistances, const SDFBatchGradients* ioGradients, const int count)
+	{
+		int pointIndex = 0;
+		if (avx2Kernels)
+			pointIndex = avx2Kernels->unionMin(distances, gradients, ioDistances, ioGradients, count, pointIndex);
+#if SIMD_LANE_SSE
+		pointIndex = SDFBatchKernels::UnionKernel<SSELane>(distances, gradients, ioDistances, ioGradients, count, pointIndex);
+#endif
+		SDFBatchKernels::UnionKernel<ScalarLane>(distances, gradients, ioDistances, ioGradients, count, pointIndex);
+	}
+}
+
+void SDFBatch::EvaluateSphere(const glm::vec3& center, const float radius, const SDFBatchPoints& points, float* outDistances)
+{
+	RunSphere(center, radius, points, outDistances, nullptr);
+}
+
+void SDFBatch::EvaluateSphereWithGradient(const glm::vec3& center, const float radius, const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients& outGradients)
+{
+	SDFBatchGradients gradients = outGradients;
+	RunSphere(center, radius, points, outDistances, &gradients);
+}
+
+void SDFBatch::EvaluateBox(const glm::vec3& center, const glm::vec3& halfExtents, const SDFBatchPoints& points, float* outDistances)
+{
+	RunBox(center, halfExtents, points, outDistances, nullptr);
+}
+
+void SDFBatch::EvaluateBoxWithGradient(const glm::vec3& center, const glm::vec3& halfExtents, const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients& outGradients)
+{
+	SDFBatchGradients gradients = outGradients;
+	RunBox(center, halfExtents, points, outDistances, &gradients);
+}
+
+void SDFBatch::UnionMin(const float* distances, float* ioDistances, const int count)
+{
+	RunUnion(distances, nullptr, ioDistances, nullptr, count);
+}
+
+void SDFBatch::UnionMinWithGradient(const float* distances, const SDFBatchGradients& gradients, float* ioDistances, const SDFBatchGradients& ioGradients, const int count)
+{
+	RunUnion(distances, &gradients, ioDistances, &ioGradients, count);
+}
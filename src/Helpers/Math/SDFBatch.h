@@ -0,0 +1,37 @@
+#pragma once
+#include <glm/glm.hpp>
+
+//Structure-of-arrays batch of query points
+struct SDFBatchPoints
+{
+	const float* x;
+	const float* y;
+	const float* z;
+	int count;
+};
+
+//Structure-of-arrays batch of gradients, one per query point
+struct SDFBatchGradients
+{
+	float* x;
+	float* y;
+	float* z;
+};
+
+//Batch SDF kernels. Each kernel runs 8 points at a time with AVX2 (when the CPU supports it), 4 at a time with SSE, and a
+//scalar loop for the remainder. Results match the scalar ISignedDistanceField evaluation.
+class SDFBatch
+{
+public:
+
+	static void EvaluateSphere(const glm::vec3& center, const float radius, const SDFBatchPoints& points, float* outDistances);
+	static void EvaluateSphereWithGradient(const glm::vec3& center, const float radius, const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients& outGradients);
+
+	static void EvaluateBox(const glm::vec3& center, const glm::vec3& halfExtents, const SDFBatchPoints& points, float* outDistances);
+	static void EvaluateBoxWithGradient(const glm::vec3& center, const glm::vec3& halfExtents, const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients& outGradients);
+
+	//Min-union of a primitive's distances into the running result
+	static void UnionMin(const float* distances, float* ioDistances, const int count);
+	//Min-union that also keeps the gradient of the argmin
+	static void UnionMinWithGradient(const float* distances, const SDFBatchGradients& gradients, float* ioDistances, const SDFBatchGradients& ioGradients, const int count);
+};
@@ -0,0 +1,17 @@
+//Compiled with /arch:AVX2 (see the project file), so only the AVX2 instantiations of the kernels may live here.
+//Anything else inlined from a shared header (e.g. glm::vec3 math) could be emitted with AVX2 instructions and picked by
+//the linker for every caller.
+#include "SDFBatchKernels.h"
+
+namespace SDFBatchKernels
+{
+	const KernelSet* GetAVX2Kernels()
+	{
+#if SIMD_LANE_AVX2
+		static const KernelSet kernels = { &SphereKernel<AVX2Lane>, &BoxKernel<AVX2Lane>, &UnionKernel<AVX2Lane> };
+		return &kernels;
+#else
+		return nullptr;
+#endif
+	}
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include "SDFBatch.h"
+#include "SIMDLane.h"
+
+//Kernel templates shared by SDFBatch.cpp (SSE and scalar lanes) and SDFBatchAVX2.cpp (AVX2 lanes). Each lane type must only
+//be instantiated in one of the two files, or the linker may keep the AVX2 copy of a kernel for the whole program.
+namespace SDFBatchKernels
+{
+	using SphereFunction = int(*)(const glm::vec3& center, const float radius, const SDFBatchPoints& points, float* outDistances, SDFBatchGradients* outGradients, int pointIndex);
+	using BoxFunction = int(*)(const glm::vec3& center, const glm::vec3& halfExtents, const SDFBatchPoints& points, float* outDistances, SDFBatchGradients* outGradients, int pointIndex);
+	using UnionFunction = int(*)(const float* distances, const SDFBatchGradients* gradients, float* ioDistances, const SDFBatchGradients* ioGradients, const int count, int pointIndex);
+
+	struct KernelSet
+	{
+		SphereFunction sphere;
+		BoxFunction box;
+		UnionFunction unionMin;
+	};
+
+	//Defined in SDFBatchAVX2.cpp, nullptr if that file was built without AVX2. Only call the kernels if CPUFeatures::HasAVX2().
+	const KernelSet* GetAVX2Kernels();
+
+	//Length of a vector, summed in the same order as glm::length
+	template<typename Lane>
+	typename Lane::Float Length(const typename Lane::Float x, const typename Lane::Float y, const typename Lane::Float z)
+	{
+		return Lane::Sqrt(Lane::Add(Lane::Add(Lane::Mul(x, x), Lane::Mul(y, y)), Lane::Mul(z, z)));
+	}
+
+	//Each kernel processes whole lanes starting at pointIndex and returns the index of the first point it did not process
+
+	template<typename Lane>
+	int SphereKernel(const glm::vec3& center, const float radius, const SDFBatchPoints& points, float* outDistances, SDFBatchGradients* outGradients, int pointIndex)
+	{
+		using Float = typename Lane::Float;
+		const Float centerX = Lane::Set(center.x), centerY = Lane::Set(center.y), centerZ = Lane::Set(center.z);
+		const Float sphereRadius = Lane::Set(radius);
+		const Float zero = Lane::Set(0.f), one = Lane::Set(1.f);
+
+		for (; pointIndex + Lane::Width <= points.count; pointIndex += Lane::Width)
+		{
+			const Float offsetX = Lane::Sub(Lane::Load(points.x + pointIndex), centerX);
+			const Float offsetY = Lane::Sub(Lane::Load(points.y + pointIndex), centerY);
+			const Float offsetZ = Lane::Sub(Lane::Load(points.z + pointIndex), centerZ);
+			const Float offsetLength = Length<Lane>(offsetX, offsetY, offsetZ);
+
+			Lane::Store(outDistances + pointIndex, Lane::Sub(offsetLength, sphereRadius));
+
+			if (outGradients)
+			{
+				//Gradient is undefined at the center, pick +y like the scalar version
+				const typename Lane::Mask bHasDirection = Lane::Less(zero, offsetLength);
+				Lane::Store(outGradients->x + pointIndex, Lane::Select(bHasDirection, Lane::Div(offsetX, offsetLength), zero));
+				Lane::Store(outGradients->y + pointIndex, Lane::Select(bHasDirection, Lane::Div(offsetY, offsetLength), one));
+				Lane::Store(outGradients->z + pointIndex, Lane::Select(bHasDirection, Lane::Div(offsetZ, offsetLength), zero));
+			}
+		}
+
+		return pointIndex;
+	}
+
+	template<typename Lane>
+	int BoxKernel(const glm::vec3& center, const glm::vec3& halfExtents, const SDFBatchPoints& points, float* outDistances, SDFBatchGradients* outGradients, int pointIndex)
+	{
+		using Float = typename Lane::Float;
+		using Mask = typename Lane::Mask;
+		const Float centerX = Lane::Set(center.x), centerY = Lane::Set(center.y), centerZ = Lane::Set(center.z);
+		const Float extentX = Lane::Set(halfExtents.x), extentY = Lane::Set(halfExtents.y), extentZ = Lane::Set(halfExtents.z);
+		const Float zero = Lane::Set(0.f), one = Lane::Set(1.f), minusOne = Lane::Set(-1.f);
+
+		for (; pointIndex + Lane::Width <= points.count; pointIndex += Lane::Width)
+		{
+			const Float offsetX = Lane::Sub(Lane::Load(points.x + pointIndex), centerX);
+			const Float offsetY = Lane::Sub(Lane::Load(points.y + pointIndex), centerY);
+			const Float offsetZ = Lane::Sub(Lane::Load(points.z + pointIndex), centerZ);
+
+			const Float qX = Lane::Sub(Lane::Abs(offsetX), extentX);
+			const Float qY = Lane::Sub(Lane::Abs(offsetY), extentY);
+			const Float qZ = Lane::Sub(Lane::Abs(offsetZ), extentZ);
+
+			const Float outsideX = Lane::Max(qX, zero);
+			const Float outsideY = Lane::Max(qY, zero);
+			const Float outsideZ = Lane::Max(qZ, zero);
+			const Float outsideDistance = Length<Lane>(outsideX, outsideY, outsideZ);
+			const Float maxComponent = Lane::Max(qX, Lane::Max(qY, qZ));
+
+			Lane::Store(outDistances + pointIndex, Lane::Add(outsideDistance, Lane::Min(maxComponent, zero)));
+
+			if (outGradients)
+			{
+				//Mirror the gradient back into the octant of the query point
+				const Float signX = Lane::Select(Lane::Less(offsetX, zero), minusOne, one);
+				const Float signY = Lane::Select(Lane::Less(offsetY, zero), minusOne, one);
+				const Float signZ = Lane::Select(Lane::Less(offsetZ, zero), minusOne, one);
+
+				//Inside: normal of the closest face
+				const Mask bClosestX = Lane::And(Lane::GreaterEqual(qX, qY), Lane::GreaterEqual(qX, qZ));
+				const Mask bClosestY = Lane::AndNot(bClosestX, Lane::GreaterEqual(qY, qZ));
+				const Float insideX = Lane::Select(bClosestX, signX, zero);
+				const Float insideY = Lane::Select(bClosestY, signY, zero);
+				const Float insideZ = Lane::Select(Lane::Or(bClosestX, bClosestY), zero, signZ);
+
+				//Outside: direction away from the closest point on the box
+				const Mask bIsOutside = Lane::Less(zero, maxComponent);
+				Lane::Store(outGradients->x + pointIndex, Lane::Select(bIsOutside, Lane::Mul(signX, Lane::Div(outsideX, outsideDistance)), insideX));
+				Lane::Store(outGradients->y + pointIndex, Lane::Select(bIsOutside, Lane::Mul(signY, Lane::Div(outsideY, outsideDistance)), insideY));
+				Lane::Store(outGradients->z + pointIndex, Lane::Select(bIsOutside, Lane::Mul(signZ, Lane::Div(outsideZ, outsideDistance)), insideZ));
+			}
+		}
+
+		return pointIndex;
+	}
+
+	template<typename Lane>
+	int UnionKernel(const float* distances, const SDFBatchGradients* gradients, float* ioDistances, const SDFBatchGradients* ioGradients, const int count, int pointIndex)
+	{
+		for (; pointIndex + Lane::Width <= count; pointIndex += Lane::Width)
+		{
+			const typename Lane::Float distance = Lane::Load(distances + pointIndex);
+			const typename Lane::Float currentDistance = Lane::Load(ioDistances + pointIndex);
+
+			//Strictly closer wins, so ties keep the earlier primitive
+			const typename Lane::Mask bIsCloser = Lane::Less(distance, currentDistance);
+			Lane::Store(ioDistances + pointIndex, Lane::Select(bIsCloser, distance, currentDistance));
+
+			if (gradients)
+			{
+				Lane::Store(ioGradients->x + pointIndex, Lane::Select(bIsCloser, Lane::Load(gradients->x + pointIndex), Lane::Load(ioGradients->x + pointIndex)));
+				Lane::Store(ioGradients->y + pointIndex, Lane::Select(bIsCloser, Lane::Load(gradients->y + pointIndex), Lane::Load(ioGradients->y + pointIndex)));
+				Lane::Store(ioGradients->z + pointIndex, Lane::Select(bIsCloser, Lane::Load(gradients->z + pointIndex), Lane::Load(ioGradients->z + pointIndex)));
+			}
+		}
+
+		return pointIndex;
+	}
+}
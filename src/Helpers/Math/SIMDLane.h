@@ -0,0 +1,108 @@
+#pragma once
+#include <cmath>
+
+//MSVC only defines __AVX2__ under /arch:AVX2, which the project only sets on the *AVX2.cpp kernel files. Their kernels are
+//called after a CPUFeatures::HasAVX2() check, so the rest of the program still runs on CPUs without AVX2.
+#if defined(__AVX2__)
+#define SIMD_LANE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_LANE_SSE 1
+#include <emmintrin.h>
+#endif
+
+//Lane types wrapping one instruction set each, so batch kernels are written once as templates over the lane type.
+//Run the widest lane first, then the narrower ones on the remainder, ending with ScalarLane.
+
+struct ScalarLane
+{
+	using Float = float;
+	using Mask = bool;
+	static constexpr int Width = 1;
+
+	static Float Load(const float* source) { return *source; }
+	static void Store(float* destination, const Float value) { *destination = value; }
+	static Float Set(const float value) { return value; }
+
+	static Float Add(const Float a, const Float b) { return a + b; }
+	static Float Sub(const Float a, const Float b) { return a - b; }
+	static Float Mul(const Float a, const Float b) { return a * b; }
+	static Float Div(const Float a, const Float b) { return a / b; }
+	static Float Sqrt(const Float a) { return std::sqrt(a); }
+	static Float Abs(const Float a) { return std::fabs(a); }
+	static Float Min(const Float a, const Float b) { return b < a ? b : a; }
+	static Float Max(const Float a, const Float b) { return a < b ? b : a; }
+
+	static Mask Less(const Float a, const Float b) { return a < b; }
+	static Mask GreaterEqual(const Float a, const Float b) { return a >= b; }
+	static Mask And(const Mask a, const Mask b) { return a && b; }
+	static Mask Or(const Mask a, const Mask b) { return a || b; }
+	static Mask AndNot(const Mask a, const Mask b) { return !a && b; }
+	//Picks a where the mask is set, b otherwise
+	static Float Select(const Mask mask, const Float a, const Float b) { return mask ? a : b; }
+	//Bit i is set if lane i of the mask is set
+	static int MaskBits(const Mask mask) { return mask ? 1 : 0; }
+};
+
+#if SIMD_LANE_SSE
+struct SSELane
+{
+	using Float = __m128;
+	using Mask = __m128;
+	static constexpr int Width = 4;
+
+	static Float Load(const float* source) { return _mm_loadu_ps(source); }
+	static void Store(float* destination, const Float value) { _mm_storeu_ps(destination, value); }
+	static Float Set(const float value) { return _mm_set1_ps(value); }
+
+	static Float Add(const Float a, const Float b) { return _mm_add_ps(a, b); }
+	static Float Sub(const Float a, const Float b) { return _mm_sub_ps(a, b); }
+	static Float Mul(const Float a, const Float b) { return _mm_mul_ps(a, b); }
+	static Float Div(const Float a, const Float b) { return _mm_div_ps(a, b); }
+	static Float Sqrt(const Float a) { return _mm_sqrt_ps(a); }
+	static Float Abs(const Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+	static Float Min(const Float a, const Float b) { return _mm_min_ps(a, b); }
+	static Float Max(const Float a, const Float b) { return _mm_max_ps(a, b); }
+
+	static Mask Less(const Float a, const Float b) { return _mm_cmplt_ps(a, b); }
+	static Mask GreaterEqual(const Float a, const Float b) { return _mm_cmpge_ps(a, b); }
+	static Mask And(const Mask a, const Mask b) { return _mm_and_ps(a, b); }
+	static Mask Or(const Mask a, const Mask b) { return _mm_or_ps(a, b); }
+	static Mask AndNot(const Mask a, const Mask b) { return _mm_andnot_ps(a, b); }
+	//SSE2 has no blend instruction
+	static Float Select(const Mask mask, const Float a, const Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	static int MaskBits(const Mask mask) { return _mm_movemask_ps(mask); }
+};
+#endif
+
+#if SIMD_LANE_AVX2
+struct AVX2Lane
+{
+	using Float = __m256;
+	using Mask = __m256;
+	static constexpr int Width = 8;
+
+	static Float Load(const float* source) { return _mm256_loadu_ps(source); }
+	static void Store(float* destination, const Float value) { _mm256_storeu_ps(destination, value); }
+	static Float Set(const float value) { return _mm256_set1_ps(value); }
+
+	static Float Add(const Float a, const Float b) { return _mm256_add_ps(a, b); }
+	static Float Sub(const Float a, const Float b) { return _mm256_sub_ps(a, b); }
+	static Float Mul(const Float a, const Float b) { return _mm256_mul_ps(a, b); }
+	static Float Div(const Float a, const Float b) { return _mm256_div_ps(a, b); }
+	static Float Sqrt(const Float a) { return _mm256_sqrt_ps(a); }
+	static Float Abs(const Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+	static Float Min(const Float a, const Float b) { return _mm256_min_ps(a, b); }
+	static Float Max(const Float a, const Float b) { return _mm256_max_ps(a, b); }
+
+	static Mask Less(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static Mask GreaterEqual(const Float a, const Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	static Mask And(const Mask a, const Mask b) { return _mm256_and_ps(a, b); }
+	static Mask Or(const Mask a, const Mask b) { return _mm256_or_ps(a, b); }
+	static Mask AndNot(const Mask a, const Mask b) { return _mm256_andnot_ps(a, b); }
+	static Float Select(const Mask mask, const Float a, const Float b) { return _mm256_blendv_ps(b, a, mask); }
+	static int MaskBits(const Mask mask) { return _mm256_movemask_ps(mask); }
+};
+#endif
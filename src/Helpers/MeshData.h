@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+//Read-only view of a contiguous array, it does not own the data (std::span is C++20)
+template<typename T>
+class ArrayView
+{
+public:
+	ArrayView() = default;
+	ArrayView(const T* data, const size_t size) : m_data(data), m_size(size) {}
+	ArrayView(const std::vector<T>& vector) : m_data(vector.data()), m_size(vector.size()) {}
+
+	const T* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	const T* begin() const { return m_data; }
+	const T* end() const { return m_data + m_size; }
+
+	const T& operator[](const size_t index) const { return m_data[index]; }
+
+private:
+	const T* m_data = nullptr;
+	size_t m_size = 0;
+};
+
+//Render-ready mesh arrays. Positions, normals and colors are 3 floats per vertex, an empty index array means the
+//vertices are drawn as a triangle list.
+struct MeshData
+{
+	std::vector<float> vertices;
+	std::vector<float> normals;
+	std::vector<float> colors;
+	std::vector<unsigned int> indices;
+};
+
+//Meshes are immutable while shared, so the mesher, the mesh component and its actor can share one without copying.
+//The mesher only patches a mesh again once it holds the last reference.
+using SharedMeshData = std::shared_ptr<const MeshData>;
@@ -1,7 +1,7 @@
 #pragma once
 #include "ISignedDistanceField.h"
 
-class BoxSDF : public ISignedDistanceField
+class BoxSDF final : public ISignedDistanceField
 {
 public:
     glm::vec3 center;
@@ -15,6 +15,47 @@ public:
         return glm::length(glm::max(q, glm::vec3(0.0f))) + glm::min(glm::max(q.x, glm::max(q.y, q.z)), 0.0f);
     }
 
-    SDFType GetType() const override { return SDFType::Box; }
+    float EvaluateWithGradient(const glm::vec3 queryPoint, glm::vec3& outGradient) const override
+    {
+        const glm::vec3 offset = queryPoint - center;
+        const glm::vec3 q = glm::abs(offset) - halfExtents;
+        //Mirror the gradient back into the octant of the query point
+        const glm::vec3 octantSign(offset.x < 0.f ? -1.f : 1.f, offset.y < 0.f ? -1.f : 1.f, offset.z < 0.f ? -1.f : 1.f);
+
+        const float maxComponent = glm::max(q.x, glm::max(q.y, q.z));
+        if (maxComponent > 0.f)
+        {
+            //Outside: gradient points away from the closest point on the box
+            const glm::vec3 outsideOffset = glm::max(q, glm::vec3(0.0f));
+            const float outsideDistance = glm::length(outsideOffset);
+            outGradient = octantSign * (outsideOffset / outsideDistance);
+            return outsideDistance;
+        }
+
+        //Inside: gradient is the normal of the closest face
+        const int closestAxis = (q.x >= q.y && q.x >= q.z) ? 0 : (q.y >= q.z ? 1 : 2);
+        outGradient = glm::vec3(0.f);
+        outGradient[closestAxis] = octantSign[closestAxis];
+        return maxComponent;
+    }
+
+    void EvaluateBatch(const SDFBatchPoints& points, float* outDistances) const override
+    {
+        SDFBatch::EvaluateBox(center, halfExtents, points, outDistances);
+    }
+
+    void EvaluateWithGradientBatch(const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients& outGradients) const override
+    {
+        SDFBatch::EvaluateBoxWithGradient(center, halfExtents, points, outDistances, outGradients);
+    }
+
+    static SDFType StaticType() { return SDFType::Box; }
+    SDFType GetType() const override { return StaticType(); }
+
+    void GetBounds(glm::vec3& outMin, glm::vec3& outMax) const override
+    {
+        outMin = center - halfExtents;
+        outMax = center + halfExtents;
+    }
 
 };
@@ -0,0 +1,67 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ISignedDistanceField.h"
+
+enum class ECSGOperation { Primitive, Union, Subtract, Intersect, SmoothUnion, Transform };
+
+//Node of a CSG expression tree over the primitives of a USDFComponent. The tree is only used for editing,
+//evaluation runs the flat program it compiles to (see CSGProgram).
+struct CSGNode
+{
+	ECSGOperation operation = ECSGOperation::Union;
+
+	//Primitive nodes: the primitive to evaluate
+	SDFHandle primitive{ SDFType::Sphere, 0 };
+
+	//SmoothUnion nodes: blend radius
+	float smoothness = 0.5f;
+
+	//Transform nodes: placement of the children (applied as scale, then rotation in XYZ order, then translation)
+	glm::vec3 translation = glm::vec3(0.f);
+	glm::vec3 rotationDegrees = glm::vec3(0.f);
+	float scale = 1.f;
+
+	//Union, Intersect and SmoothUnion combine all children, Subtract removes children[1..] from children[0],
+	//Transform unions its children in the transformed space
+	std::vector<std::shared_ptr<CSGNode>> children;
+
+	static std::shared_ptr<CSGNode> MakePrimitive(const SDFHandle handle)
+	{
+		std::shared_ptr<CSGNode> node = std::make_shared<CSGNode>();
+		node->operation = ECSGOperation::Primitive;
+		node->primitive = handle;
+		return node;
+	}
+
+	static std::shared_ptr<CSGNode> MakeOperation(const ECSGOperation operation, const std::vector<std::shared_ptr<CSGNode>>& children)
+	{
+		std::shared_ptr<CSGNode> node = std::make_shared<CSGNode>();
+		node->operation = operation;
+		node->children = children;
+		return node;
+	}
+
+	//Copy of the node and all of its descendants
+	std::shared_ptr<CSGNode> Clone() const
+	{
+		std::shared_ptr<CSGNode> node = std::make_shared<CSGNode>(*this);
+		for (std::shared_ptr<CSGNode>& child : node->children)
+		{
+			if (child)
+				child = child->Clone();
+		}
+		return node;
+	}
+
+	static std::shared_ptr<CSGNode> MakeTransform(const std::shared_ptr<CSGNode>& child, const glm::vec3& translation, const glm::vec3& rotationDegrees, const float scale)
+	{
+		std::shared_ptr<CSGNode> node = MakeOperation(ECSGOperation::Transform, { child });
+		node->translation = translation;
+		node->rotationDegrees = rotationDegrees;
+		node->scale = scale;
+		return node;
+	}
+};
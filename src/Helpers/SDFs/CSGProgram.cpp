@@ -0,0 +1,429 @@
+#include "CSGProgram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "CSGNode.h"
+
+//Points are processed in blocks of this size so the registers stay in cache
+static constexpr int BLOCK_SIZE = 64;
+//Register indices are stored in 8 bits
+static constexpr int MAX_REGISTERS = 255;
+
+namespace
+{
+	//Per-thread register file, grown on demand and reused across calls
+	struct CSGRegisters
+	{
+		std::vector<float> distances;
+		std::vector<float> gradientX;
+		std::vector<float> gradientY;
+		std::vector<float> gradientZ;
+		std::vector<float> pointX;
+		std::vector<float> pointY;
+		std::vector<float> pointZ;
+	};
+
+	CSGRegisters& GetRegisters(const int distanceRegisterCount, const int pointRegisterCount, const bool bWithGradients)
+	{
+		static thread_local CSGRegisters registers;
+
+		const size_t distanceSize = static_cast<size_t>(distanceRegisterCount) * BLOCK_SIZE;
+		if (registers.distances.size() < distanceSize)
+			registers.distances.resize(distanceSize);
+
+		if (bWithGradients && registers.gradientX.size() < distanceSize)
+		{
+			registers.gradientX.resize(distanceSize);
+			registers.gradientY.resize(distanceSize);
+			registers.gradientZ.resize(distanceSize);
+		}
+
+		const size_t pointSize = static_cast<size_t>(pointRegisterCount) * BLOCK_SIZE;
+		if (registers.pointX.size() < pointSize)
+		{
+			registers.pointX.resize(pointSize);
+			registers.pointY.resize(pointSize);
+			registers.pointZ.resize(pointSize);
+		}
+
+		return registers;
+	}
+
+	//Rotation matrix for XYZ euler angles (applied X first)
+	glm::mat3 GetRotationMatrix(const glm::vec3& rotationDegrees)
+	{
+		const float cx = std::cos(glm::radians(rotationDegrees.x)), sx = std::sin(glm::radians(rotationDegrees.x));
+		const float cy = std::cos(glm::radians(rotationDegrees.y)), sy = std::sin(glm::radians(rotationDegrees.y));
+		const float cz = std::cos(glm::radians(rotationDegrees.z)), sz = std::sin(glm::radians(rotationDegrees.z));
+
+		const glm::mat3 rotationX(glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, cx, sx), glm::vec3(0.f, -sx, cx));
+		const glm::mat3 rotationY(glm::vec3(cy, 0.f, -sy), glm::vec3(0.f, 1.f, 0.f), glm::vec3(sy, 0.f, cy));
+		const glm::mat3 rotationZ(glm::vec3(cz, sz, 0.f), glm::vec3(-sz, cz, 0.f), glm::vec3(0.f, 0.f, 1.f));
+
+		return rotationZ * rotationY * rotationX;
+	}
+
+	void StoreMatrix(const glm::mat3& matrix, const float scale, std::array<float, 12>& constants)
+	{
+		for (int column = 0; column < 3; ++column)
+		{
+			for (int row = 0; row < 3; ++row)
+			{
+				constants[column * 3 + row] = matrix[column][row] * scale;
+			}
+		}
+	}
+
+	CSGInstruction MakeInstruction(const ECSGOpCode opCode, const int destination, const int operand, const int points, const int destinationPoints)
+	{
+		CSGInstruction instruction;
+		instruction.opCode = opCode;
+		instruction.destination = static_cast<uint8_t>(destination);
+		instruction.operand = static_cast<uint8_t>(operand);
+		instruction.points = static_cast<uint8_t>(points);
+		instruction.destinationPoints = static_cast<uint8_t>(destinationPoints);
+		instruction.constants.fill(0.f);
+		return instruction;
+	}
+}
+
+bool CSGProgram::Compile(const CSGNode& root, const SDFPrimitiveArray<SphereSDF>& spheres, const SDFPrimitiveArray<BoxSDF>& boxes)
+{
+	Clear();
+
+	//Point register 0 is the input, the result ends up in distance register 0
+	pointRegisterCount = 1;
+	if (!CompileNode(root, 0, 0, spheres, boxes))
+	{
+		Clear();
+		return false;
+	}
+
+	return true;
+}
+
+void CSGProgram::Clear()
+{
+	instructions.clear();
+	distanceRegisterCount = 0;
+	pointRegisterCount = 0;
+}
+
+bool CSGProgram::CompileNode(const CSGNode& node, const int destination, const int points, const SDFPrimitiveArray<SphereSDF>& spheres, const SDFPrimitiveArray<BoxSDF>& boxes)
+{
+	if (destination >= MAX_REGISTERS || points >= MAX_REGISTERS)
+	{
+		std::cout << "\nCSG tree is too deep to compile";
+		return false;
+	}
+
+	distanceRegisterCount = std::max(distanceRegisterCount, destination + 1);
+
+	switch (node.operation)
+	{
+		case ECSGOperation::Primitive:
+		{
+			//Primitive parameters are baked into the program, edits recompile it
+			CSGInstruction instruction = MakeInstruction(node.primitive.type == SDFType::Sphere ? ECSGOpCode::Sphere : ECSGOpCode::Box, destination, 0, points, 0);
+
+			if (node.primitive.type == SDFType::Sphere)
+			{
+				const SphereSDF* sphere = spheres.Get(node.primitive.id);
+				if (!sphere)
+				{
+					std::cout << "\nCSG tree references a removed sphere";
+					return false;
+				}
+
+				instruction.constants[0] = sphere->center.x;
+				instruction.constants[1] = sphere->center.y;
+				instruction.constants[2] = sphere->center.z;
+				instruction.constants[3] = sphere->radius;
+			}
+			else
+			{
+				const BoxSDF* box = boxes.Get(node.primitive.id);
+				if (!box)
+				{
+					std::cout << "\nCSG tree references a removed box";
+					return false;
+				}
+
+				instruction.constants[0] = box->center.x;
+				instruction.constants[1] = box->center.y;
+				instruction.constants[2] = box->center.z;
+				instruction.constants[3] = box->halfExtents.x;
+				instruction.constants[4] = box->halfExtents.y;
+				instruction.constants[5] = box->halfExtents.z;
+			}
+
+			instructions.push_back(instruction);
+			return true;
+		}
+		case ECSGOperation::Union: return CompileChildren(node, ECSGOpCode::Union, destination, points, spheres, boxes);
+		case ECSGOperation::Subtract: return CompileChildren(node, ECSGOpCode::Subtract, destination, points, spheres, boxes);
+		case ECSGOperation::Intersect: return CompileChildren(node, ECSGOpCode::Intersect, destination, points, spheres, boxes);
+		case ECSGOperation::SmoothUnion: return CompileChildren(node, ECSGOpCode::SmoothUnion, destination, points, spheres, boxes);
+		case ECSGOperation::Transform:
+		{
+			//Children are evaluated at local = R^T * (p - t) / s, and their distance scaled back by s
+			const float scale = std::max(node.scale, 1e-4f);
+			const glm::mat3 rotation = GetRotationMatrix(node.rotationDegrees);
+			const int localPoints = points + 1;
+			pointRegisterCount = std::max(pointRegisterCount, localPoints + 1);
+
+			CSGInstruction transformPoints = MakeInstruction(ECSGOpCode::TransformPoints, destination, 0, points, localPoints);
+			StoreMatrix(glm::transpose(rotation), 1.f / scale, transformPoints.constants);
+			transformPoints.constants[9] = node.translation.x;
+			transformPoints.constants[10] = node.translation.y;
+			transformPoints.constants[11] = node.translation.z;
+			instructions.push_back(transformPoints);
+
+			if (!CompileChildren(node, ECSGOpCode::Union, destination, localPoints, spheres, boxes))
+				return false;
+
+			CSGInstruction transformDistance = MakeInstruction(ECSGOpCode::TransformDistance, destination, 0, 0, 0);
+			StoreMatrix(rotation, 1.f, transformDistance.constants);
+			transformDistance.constants[9] = scale;
+			instructions.push_back(transformDistance);
+			return true;
+		}
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+bool CSGProgram::CompileChildren(const CSGNode& node, const ECSGOpCode combineOpCode, const int destination, const int points, const SDFPrimitiveArray<SphereSDF>& spheres, const SDFPrimitiveArray<BoxSDF>& boxes)
+{
+	if (node.children.empty())
+	{
+		instructions.push_back(MakeInstruction(ECSGOpCode::Empty, destination, 0, 0, 0));
+		return true;
+	}
+
+	//First child goes straight into the destination, each following child is combined into it
+	for (size_t childIndex = 0; childIndex < node.children.size(); ++childIndex)
+	{
+		const int childDestination = childIndex == 0 ? destination : destination + 1;
+		if (!node.children[childIndex] || !CompileNode(*node.children[childIndex], childDestination, points, spheres, boxes))
+			return false;
+
+		if (childIndex > 0)
+		{
+			CSGInstruction combine = MakeInstruction(combineOpCode, destination, destination + 1, 0, 0);
+			combine.constants[0] = std::max(node.smoothness, 1e-4f);
+			instructions.push_back(combine);
+		}
+	}
+
+	return true;
+}
+
+void CSGProgram::Execute(const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients* outGradients) const
+{
+	for (int blockStart = 0; blockStart < points.count; blockStart += BLOCK_SIZE)
+	{
+		const SDFBatchPoints blockPoints{ points.x + blockStart, points.y + blockStart, points.z + blockStart, std::min(BLOCK_SIZE, points.count - blockStart) };
+
+		if (outGradients)
+		{
+			const SDFBatchGradients blockGradients{ outGradients->x + blockStart, outGradients->y + blockStart, outGradients->z + blockStart };
+			ExecuteBlock(blockPoints, outDistances + blockStart, &blockGradients);
+		}
+		else
+		{
+			ExecuteBlock(blockPoints, outDistances + blockStart, nullptr);
+		}
+	}
+}
+
+float CSGProgram::Execute(const glm::vec3& queryPoint, glm::vec3* outGradient) const
+{
+	const SDFBatchPoints point{ &queryPoint.x, &queryPoint.y, &queryPoint.z, 1 };
+	float distance = 0.f;
+
+	if (outGradient)
+	{
+		const SDFBatchGradients gradient{ &outGradient->x, &outGradient->y, &outGradient->z };
+		ExecuteBlock(point, &distance, &gradient);
+	}
+	else
+	{
+		ExecuteBlock(point, &distance, nullptr);
+	}
+
+	return distance;
+}
+
+void CSGProgram::ExecuteBlock(const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients* outGradients) const
+{
+	const int count = points.count;
+	const bool bWithGradients = outGradients != nullptr;
+	CSGRegisters& registers = GetRegisters(distanceRegisterCount, pointRegisterCount, bWithGradients);
+
+	auto distanceRegister = [&](const int index) { return registers.distances.data() + index * BLOCK_SIZE; };
+	auto gradientRegister = [&](const int index)
+	{
+		return SDFBatchGradients{ registers.gradientX.data() + index * BLOCK_SIZE, registers.gradientY.data() + index * BLOCK_SIZE, registers.gradientZ.data() + index * BLOCK_SIZE };
+	};
+	//Point register 0 reads the input directly
+	auto pointRegister = [&](const int index)
+	{
+		if (index == 0)
+			return points;
+		return SDFBatchPoints{ registers.pointX.data() + index * BLOCK_SIZE, registers.pointY.data() + index * BLOCK_SIZE, registers.pointZ.data() + index * BLOCK_SIZE, count };
+	};
+
+	for (const CSGInstruction& instruction : instructions)
+	{
+		float* distances = distanceRegister(instruction.destination);
+		const std::array<float, 12>& constants = instruction.constants;
+
+		switch (instruction.opCode)
+		{
+			case ECSGOpCode::Sphere:
+			{
+				const glm::vec3 center(constants[0], constants[1], constants[2]);
+				if (bWithGradients)
+					SDFBatch::EvaluateSphereWithGradient(center, constants[3], pointRegister(instruction.points), distances, gradientRegister(instruction.destination));
+				else
+					SDFBatch::EvaluateSphere(center, constants[3], pointRegister(instruction.points), distances);
+				break;
+			}
+			case ECSGOpCode::Box:
+			{
+				const glm::vec3 center(constants[0], constants[1], constants[2]);
+				const glm::vec3 halfExtents(constants[3], constants[4], constants[5]);
+				if (bWithGradients)
+					SDFBatch::EvaluateBoxWithGradient(center, halfExtents, pointRegister(instruction.points), distances, gradientRegister(instruction.destination));
+				else
+					SDFBatch::EvaluateBox(center, halfExtents, pointRegister(instruction.points), distances);
+				break;
+			}
+			case ECSGOpCode::Union:
+			{
+				if (bWithGradients)
+					SDFBatch::UnionMinWithGradient(distanceRegister(instruction.operand), gradientRegister(instruction.operand), distances, gradientRegister(instruction.destination), count);
+				else
+					SDFBatch::UnionMin(distanceRegister(instruction.operand), distances, count);
+				break;
+			}
+			case ECSGOpCode::Subtract:
+			case ECSGOpCode::Intersect:
+			{
+				//Both are a max, subtract negates the operand (and its gradient)
+				const float operandSign = instruction.opCode == ECSGOpCode::Subtract ? -1.f : 1.f;
+				const float* operandDistances = distanceRegister(instruction.operand);
+				const SDFBatchGradients destinationGradients = bWithGradients ? gradientRegister(instruction.destination) : SDFBatchGradients{ nullptr, nullptr, nullptr };
+				const SDFBatchGradients operandGradients = bWithGradients ? gradientRegister(instruction.operand) : SDFBatchGradients{ nullptr, nullptr, nullptr };
+
+				for (int i = 0; i < count; ++i)
+				{
+					const float operandDistance = operandSign * operandDistances[i];
+					if (operandDistance > distances[i])
+					{
+						distances[i] = operandDistance;
+						if (bWithGradients)
+						{
+							destinationGradients.x[i] = operandSign * operandGradients.x[i];
+							destinationGradients.y[i] = operandSign * operandGradients.y[i];
+							destinationGradients.z[i] = operandSign * operandGradients.z[i];
+						}
+					}
+				}
+				break;
+			}
+			case ECSGOpCode::SmoothUnion:
+			{
+				//Polynomial smooth min, its gradient is exactly the blend of the operand gradients
+				const float smoothness = constants[0];
+				const float* operandDistances = distanceRegister(instruction.operand);
+				const SDFBatchGradients destinationGradients = bWithGradients ? gradientRegister(instruction.destination) : SDFBatchGradients{ nullptr, nullptr, nullptr };
+				const SDFBatchGradients operandGradients = bWithGradients ? gradientRegister(instruction.operand) : SDFBatchGradients{ nullptr, nullptr, nullptr };
+
+				for (int i = 0; i < count; ++i)
+				{
+					const float a = distances[i];
+					const float b = operandDistances[i];
+					const float h = glm::clamp(0.5f + 0.5f * (b - a) / smoothness, 0.f, 1.f);
+					distances[i] = b + (a - b) * h - smoothness * h * (1.f - h);
+
+					if (bWithGradients)
+					{
+						destinationGradients.x[i] = operandGradients.x[i] + (destinationGradients.x[i] - operandGradients.x[i]) * h;
+						destinationGradients.y[i] = operandGradients.y[i] + (destinationGradients.y[i] - operandGradients.y[i]) * h;
+						destinationGradients.z[i] = operandGradients.z[i] + (destinationGradients.z[i] - operandGradients.z[i]) * h;
+					}
+				}
+				break;
+			}
+			case ECSGOpCode::TransformPoints:
+			{
+				const SDFBatchPoints source = pointRegister(instruction.points);
+				const SDFBatchPoints destination = pointRegister(instruction.destinationPoints);
+				float* destinationX = const_cast<float*>(destination.x);
+				float* destinationY = const_cast<float*>(destination.y);
+				float* destinationZ = const_cast<float*>(destination.z);
+
+				for (int i = 0; i < count; ++i)
+				{
+					const float x = source.x[i] - constants[9];
+					const float y = source.y[i] - constants[10];
+					const float z = source.z[i] - constants[11];
+					destinationX[i] = constants[0] * x + constants[3] * y + constants[6] * z;
+					destinationY[i] = constants[1] * x + constants[4] * y + constants[7] * z;
+					destinationZ[i] = constants[2] * x + constants[5] * y + constants[8] * z;
+				}
+				break;
+			}
+			case ECSGOpCode::TransformDistance:
+			{
+				const float scale = constants[9];
+				const SDFBatchGradients gradients = bWithGradients ? gradientRegister(instruction.destination) : SDFBatchGradients{ nullptr, nullptr, nullptr };
+
+				for (int i = 0; i < count; ++i)
+				{
+					distances[i] *= scale;
+
+					if (bWithGradients)
+					{
+						//Back to world space, the scale cancels out
+						const float x = gradients.x[i], y = gradients.y[i], z = gradients.z[i];
+						gradients.x[i] = constants[0] * x + constants[3] * y + constants[6] * z;
+						gradients.y[i] = constants[1] * x + constants[4] * y + constants[7] * z;
+						gradients.z[i] = constants[2] * x + constants[5] * y + constants[8] * z;
+					}
+				}
+				break;
+			}
+			case ECSGOpCode::Empty:
+			default:
+			{
+				std::fill(distances, distances + count, std::numeric_limits<float>::max());
+				if (bWithGradients)
+				{
+					const SDFBatchGradients gradients = gradientRegister(instruction.destination);
+					std::fill(gradients.x, gradients.x + count, 0.f);
+					std::fill(gradients.y, gradients.y + count, 1.f);
+					std::fill(gradients.z, gradients.z + count, 0.f);
+				}
+				break;
+			}
+		}
+	}
+
+	//The result is in register 0
+	std::copy(distanceRegister(0), distanceRegister(0) + count, outDistances);
+	if (bWithGradients)
+	{
+		const SDFBatchGradients result = gradientRegister(0);
+		std::copy(result.x, result.x + count, outGradients->x);
+		std::copy(result.y, result.y + count, outGradients->y);
+		std::copy(result.z, result.z + count, outGradients->z);
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "BoxSDF.h"
+#include "SphereSDF.h"
+#include "SDFPrimitiveArray.h"
+#include "Helpers/Math/SDFBatch.h"
+
+struct CSGNode;
+
+enum class ECSGOpCode : uint8_t
+{
+	//distance[destination] = primitive(points[points])
+	Sphere,
+	Box,
+	//distance[destination] = op(distance[destination], distance[operand])
+	Union,
+	Subtract,
+	Intersect,
+	SmoothUnion,
+	//points[destinationPoints] = matrix * (points[points] - translation)
+	TransformPoints,
+	//distance[destination] *= scale, gradient[destination] = rotation * gradient[destination]
+	TransformDistance,
+	//distance[destination] = max float, for operations without children
+	Empty
+};
+
+struct CSGInstruction
+{
+	ECSGOpCode opCode;
+	uint8_t destination;
+	uint8_t operand;
+	uint8_t points;
+	uint8_t destinationPoints;
+	//Primitive parameters, blend radius, or a 3x3 matrix (column-major) followed by a translation or scale
+	std::array<float, 12> constants;
+};
+
+//A CSG tree compiled to a linear, register-based instruction stream. Each instruction runs over a whole block of points,
+//so dispatch is paid once per block instead of once per point and primitives reuse the SIMD batch kernels.
+class CSGProgram
+{
+public:
+
+	//Returns false and leaves the program empty if the tree references a removed primitive or is too deep
+	bool Compile(const CSGNode& root, const SDFPrimitiveArray<SphereSDF>& spheres, const SDFPrimitiveArray<BoxSDF>& boxes);
+	void Clear();
+	bool Empty() const { return instructions.empty(); }
+	const std::vector<CSGInstruction>& GetInstructions() const { return instructions; }
+
+	//Gradients are only computed if outGradients is not null
+	void Execute(const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients* outGradients) const;
+	float Execute(const glm::vec3& queryPoint, glm::vec3* outGradient) const;
+
+private:
+
+	std::vector<CSGInstruction> instructions;
+	int distanceRegisterCount = 0;
+	int pointRegisterCount = 0;
+
+	bool CompileNode(const CSGNode& node, const int destination, const int points, const SDFPrimitiveArray<SphereSDF>& spheres, const SDFPrimitiveArray<BoxSDF>& boxes);
+	//Compiles the children into destination and combines them with the given combine op code
+	bool CompileChildren(const CSGNode& node, const ECSGOpCode combineOpCode, const int destination, const int points, const SDFPrimitiveArray<SphereSDF>& spheres, const SDFPrimitiveArray<BoxSDF>& boxes);
+	void ExecuteBlock(const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients* outGradients) const;
+};
@@ -1,9 +1,19 @@
 #pragma once
 
+#include <cstdint>
 #include <glm/glm.hpp>
 
+#include "Helpers/Math/SDFBatch.h"
+
 enum class SDFType { Box, Sphere};
 
+//Stable handle to a primitive stored in a USDFComponent
+struct SDFHandle
+{
+	SDFType type;
+	uint32_t id;
+};
+
 
 class ISignedDistanceField
 {
@@ -11,5 +21,30 @@ public:
 	virtual ~ISignedDistanceField() = default;
 
 	virtual float EvaluateSDF(const glm::vec3 queryPoint) const = 0;
+	//Evaluates the distance and its exact gradient (unit length where the field is differentiable) in one pass
+	virtual float EvaluateWithGradient(const glm::vec3 queryPoint, glm::vec3& outGradient) const = 0;
+
+	//Evaluates a batch of points, primitives override this with SIMD kernels
+	virtual void EvaluateBatch(const SDFBatchPoints& points, float* outDistances) const
+	{
+		for (int i = 0; i < points.count; ++i)
+		{
+			outDistances[i] = EvaluateSDF(glm::vec3(points.x[i], points.y[i], points.z[i]));
+		}
+	}
+
+	virtual void EvaluateWithGradientBatch(const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients& outGradients) const
+	{
+		for (int i = 0; i < points.count; ++i)
+		{
+			glm::vec3 gradient;
+			outDistances[i] = EvaluateWithGradient(glm::vec3(points.x[i], points.y[i], points.z[i]), gradient);
+			outGradients.x[i] = gradient.x;
+			outGradients.y[i] = gradient.y;
+			outGradients.z[i] = gradient.z;
+		}
+	}
 	virtual SDFType GetType() const = 0; 
+	//Conservative world-space bounds of the solid, the SDF is at least the distance to these bounds outside them
+	virtual void GetBounds(glm::vec3& outMin, glm::vec3& outMax) const = 0;
 };
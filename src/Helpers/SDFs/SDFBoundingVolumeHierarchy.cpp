@@ -0,0 +1,115 @@
+#include "SDFBoundingVolumeHierarchy.h"
+
+#include <algorithm>
+
+//Leaves hold at most this many primitives
+static constexpr int MAX_LEAF_PRIMITIVES = 4;
+//Splits stop here so QueryMin's fixed stack cannot overflow
+static constexpr int MAX_TREE_DEPTH = 48;
+
+void SDFBoundingVolumeHierarchy::Build(const std::vector<SDFPrimitiveRef>& primitives, const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax)
+{
+	nodes.clear();
+	orderedPrimitives.clear();
+	orderedBoundsIndices.clear();
+
+	if (primitives.empty())
+		return;
+
+	std::vector<int> primitiveIndices(primitives.size());
+	for (size_t i = 0; i < primitives.size(); ++i)
+	{
+		primitiveIndices[i] = static_cast<int>(i);
+	}
+
+	nodes.reserve(primitives.size() * 2);
+	nodes.push_back(Node());
+	BuildNode(0, 0, static_cast<int>(primitives.size()), boundsMin, boundsMax, primitiveIndices, 0);
+
+	//Leaves reference contiguous runs of the reordered primitives
+	orderedPrimitives.reserve(primitives.size());
+	for (const int primitiveIndex : primitiveIndices)
+	{
+		orderedPrimitives.push_back(primitives[primitiveIndex]);
+	}
+	orderedBoundsIndices = primitiveIndices;
+}
+
+void SDFBoundingVolumeHierarchy::Refit(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax)
+{
+	if (!nodes.empty())
+		RefitNode(0, boundsMin, boundsMax);
+}
+
+void SDFBoundingVolumeHierarchy::BuildNode(const int nodeIndex, const int first, const int count, const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax, std::vector<int>& primitiveIndices, const int depth)
+{
+	//Bounds of the primitives and of their centers
+	glm::vec3 nodeMin(std::numeric_limits<float>::max());
+	glm::vec3 nodeMax(-std::numeric_limits<float>::max());
+	glm::vec3 centerMin(std::numeric_limits<float>::max());
+	glm::vec3 centerMax(-std::numeric_limits<float>::max());
+	for (int i = first; i < first + count; ++i)
+	{
+		const int primitiveIndex = primitiveIndices[i];
+		nodeMin = glm::min(nodeMin, boundsMin[primitiveIndex]);
+		nodeMax = glm::max(nodeMax, boundsMax[primitiveIndex]);
+
+		const glm::vec3 center = (boundsMin[primitiveIndex] + boundsMax[primitiveIndex]) * 0.5f;
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+
+	nodes[nodeIndex].boundsMin = nodeMin;
+	nodes[nodeIndex].boundsMax = nodeMax;
+
+	if (count <= MAX_LEAF_PRIMITIVES || depth >= MAX_TREE_DEPTH)
+	{
+		nodes[nodeIndex].firstPrimitiveOrLeftChild = first;
+		nodes[nodeIndex].primitiveCount = count;
+		return;
+	}
+
+	//Median split along the widest axis of the primitive centers
+	const glm::vec3 centerExtent = centerMax - centerMin;
+	const int splitAxis = (centerExtent.x >= centerExtent.y && centerExtent.x >= centerExtent.z) ? 0 : (centerExtent.y >= centerExtent.z ? 1 : 2);
+	const int middle = first + count / 2;
+	std::nth_element(primitiveIndices.begin() + first, primitiveIndices.begin() + middle, primitiveIndices.begin() + first + count,
+		[&](const int a, const int b)
+		{
+			return (boundsMin[a][splitAxis] + boundsMax[a][splitAxis]) < (boundsMin[b][splitAxis] + boundsMax[b][splitAxis]);
+		});
+
+	//Children are stored next to each other, nodes is indexed rather than referenced since it grows during the recursion
+	const int leftChild = static_cast<int>(nodes.size());
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+	nodes[nodeIndex].firstPrimitiveOrLeftChild = leftChild;
+	nodes[nodeIndex].primitiveCount = 0;
+
+	BuildNode(leftChild, first, middle - first, boundsMin, boundsMax, primitiveIndices, depth + 1);
+	BuildNode(leftChild + 1, middle, first + count - middle, boundsMin, boundsMax, primitiveIndices, depth + 1);
+}
+
+void SDFBoundingVolumeHierarchy::RefitNode(const int nodeIndex, const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax)
+{
+	Node& node = nodes[nodeIndex];
+
+	if (node.primitiveCount > 0)
+	{
+		node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		for (int i = node.firstPrimitiveOrLeftChild; i < node.firstPrimitiveOrLeftChild + node.primitiveCount; ++i)
+		{
+			node.boundsMin = glm::min(node.boundsMin, boundsMin[orderedBoundsIndices[i]]);
+			node.boundsMax = glm::max(node.boundsMax, boundsMax[orderedBoundsIndices[i]]);
+		}
+		return;
+	}
+
+	const int leftChild = node.firstPrimitiveOrLeftChild;
+	RefitNode(leftChild, boundsMin, boundsMax);
+	RefitNode(leftChild + 1, boundsMin, boundsMax);
+
+	nodes[nodeIndex].boundsMin = glm::min(nodes[leftChild].boundsMin, nodes[leftChild + 1].boundsMin);
+	nodes[nodeIndex].boundsMax = glm::max(nodes[leftChild].boundsMax, nodes[leftChild + 1].boundsMax);
+}
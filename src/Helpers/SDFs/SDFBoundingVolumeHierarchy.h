@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ISignedDistanceField.h"
+
+//Primitive referenced by a BVH leaf, slot indexes the component's array of that type
+struct SDFPrimitiveRef
+{
+	SDFType type;
+	uint32_t slot;
+};
+
+//Bounding volume hierarchy over SDF primitive bounds. A query only evaluates primitives whose bounds could
+//still beat the closest distance found so far, so a union of many primitives costs roughly O(log n) per point.
+class SDFBoundingVolumeHierarchy
+{
+public:
+
+	//Builds the tree from scratch, bounds[i] belong to primitives[i]
+	void Build(const std::vector<SDFPrimitiveRef>& primitives, const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax);
+	//Recomputes node bounds bottom-up, for when primitives moved but none were added or removed
+	void Refit(const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax);
+
+	bool Empty() const { return nodes.empty(); }
+
+	//Calls evaluate(const SDFPrimitiveRef&) -> float on candidate primitives, nearest node first, and returns the min distance.
+	//onCloser(const SDFPrimitiveRef&, float) is called whenever a primitive beats the current minimum.
+	template<typename EvaluateFunc, typename OnCloserFunc>
+	float QueryMin(const glm::vec3& queryPoint, EvaluateFunc evaluate, OnCloserFunc onCloser) const
+	{
+		float closestDistance = std::numeric_limits<float>::max();
+		if (nodes.empty())
+			return closestDistance;
+
+		//Fixed-size stack, the tree depth is bounded by the median split
+		int nodeStack[64];
+		int stackSize = 0;
+		nodeStack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const Node& node = nodes[nodeStack[--stackSize]];
+
+			//Nothing inside this node can be closer
+			if (GetLowerBound(node, queryPoint) >= closestDistance)
+				continue;
+
+			if (node.primitiveCount > 0)
+			{
+				for (int i = 0; i < node.primitiveCount; ++i)
+				{
+					const SDFPrimitiveRef& primitive = orderedPrimitives[node.firstPrimitiveOrLeftChild + i];
+					const float distance = evaluate(primitive);
+					if (distance < closestDistance)
+					{
+						closestDistance = distance;
+						onCloser(primitive, distance);
+					}
+				}
+				continue;
+			}
+
+			//Visit the nearer child first so the far one is more likely to be pruned
+			const int leftChild = node.firstPrimitiveOrLeftChild;
+			const int rightChild = leftChild + 1;
+			const bool bLeftIsNearer = GetLowerBound(nodes[leftChild], queryPoint) <= GetLowerBound(nodes[rightChild], queryPoint);
+			nodeStack[stackSize++] = bLeftIsNearer ? rightChild : leftChild;
+			nodeStack[stackSize++] = bLeftIsNearer ? leftChild : rightChild;
+		}
+
+		return closestDistance;
+	}
+
+private:
+
+	struct Node
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		//Leaf: first entry in orderedPrimitives, inner node: index of the left child (right child follows it)
+		int firstPrimitiveOrLeftChild;
+		//0 for inner nodes
+		int primitiveCount;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<SDFPrimitiveRef> orderedPrimitives;
+	//Index into the build input for each entry of orderedPrimitives, used by Refit
+	std::vector<int> orderedBoundsIndices;
+
+	void BuildNode(const int nodeIndex, const int first, const int count, const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax, std::vector<int>& primitiveIndices, const int depth);
+	void RefitNode(const int nodeIndex, const std::vector<glm::vec3>& boundsMin, const std::vector<glm::vec3>& boundsMax);
+
+	//Distance from the point to the node bounds. Bounds contain the primitive, so the SDF can be no smaller outside them,
+	//inside the bounds the SDF can be negative and nothing can be pruned.
+	static float GetLowerBound(const Node& node, const glm::vec3& queryPoint)
+	{
+		const glm::vec3 outside = glm::max(glm::max(node.boundsMin - queryPoint, queryPoint - node.boundsMax), glm::vec3(0.f));
+		const float outsideDistance = glm::length(outside);
+		return outsideDistance > 0.f ? outsideDistance : -std::numeric_limits<float>::max();
+	}
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+//Contiguous storage for one primitive type. Primitives are addressed through stable ids,
+//removal moves the last primitive into the freed slot so the array stays packed.
+template<typename T>
+class SDFPrimitiveArray
+{
+public:
+
+	//Returns the id of the new primitive
+	uint32_t Add(const T& primitive)
+	{
+		uint32_t id;
+		if (!freeIds.empty())
+		{
+			id = freeIds.back();
+			freeIds.pop_back();
+		}
+		else
+		{
+			id = static_cast<uint32_t>(idToSlot.size());
+			idToSlot.push_back(-1);
+		}
+
+		idToSlot[id] = static_cast<int>(primitives.size());
+		primitives.push_back(primitive);
+		slotToId.push_back(id);
+
+		return id;
+	}
+
+	bool Remove(const uint32_t id)
+	{
+		T* primitive = Get(id);
+		if (!primitive)
+			return false;
+
+		const int slot = idToSlot[id];
+		const int lastSlot = static_cast<int>(primitives.size()) - 1;
+
+		//Move the last primitive into the freed slot
+		if (slot != lastSlot)
+		{
+			primitives[slot] = primitives[lastSlot];
+			slotToId[slot] = slotToId[lastSlot];
+			idToSlot[slotToId[slot]] = slot;
+		}
+
+		primitives.pop_back();
+		slotToId.pop_back();
+		idToSlot[id] = -1;
+		freeIds.push_back(id);
+
+		return true;
+	}
+
+	//Returns nullptr if the id was removed or never added
+	T* Get(const uint32_t id)
+	{
+		if (id >= idToSlot.size() || idToSlot[id] < 0)
+			return nullptr;
+
+		return &primitives[idToSlot[id]];
+	}
+
+	const T* Get(const uint32_t id) const
+	{
+		if (id >= idToSlot.size() || idToSlot[id] < 0)
+			return nullptr;
+
+		return &primitives[idToSlot[id]];
+	}
+
+	uint32_t GetId(const size_t slot) const { return slotToId[slot]; }
+
+	size_t Size() const { return primitives.size(); }
+	bool Empty() const { return primitives.empty(); }
+
+	T& operator[](const size_t slot) { return primitives[slot]; }
+	const T& operator[](const size_t slot) const { return primitives[slot]; }
+
+	typename std::vector<T>::iterator begin() { return primitives.begin(); }
+	typename std::vector<T>::iterator end() { return primitives.end(); }
+	typename std::vector<T>::const_iterator begin() const { return primitives.begin(); }
+	typename std::vector<T>::const_iterator end() const { return primitives.end(); }
+
+private:
+
+	std::vector<T> primitives;
+	//Id of the primitive in each slot
+	std::vector<uint32_t> slotToId;
+	//Slot of each id, -1 if the id is free
+	std::vector<int> idToSlot;
+	std::vector<uint32_t> freeIds;
+};
@@ -1,7 +1,7 @@
 #pragma once
 #include "ISignedDistanceField.h"
 
-class SphereSDF : public ISignedDistanceField
+class SphereSDF final : public ISignedDistanceField
 {
 public:
 
@@ -15,6 +15,33 @@ public:
         return glm::length(queryPoint - center) - radius;
     }
 
-    SDFType GetType() const override { return SDFType::Sphere; }
+    float EvaluateWithGradient(const glm::vec3 queryPoint, glm::vec3& outGradient) const override
+    {
+        const glm::vec3 offset = queryPoint - center;
+        const float offsetLength = glm::length(offset);
+
+        //Gradient is undefined at the center, pick any direction
+        outGradient = offsetLength > 0.f ? offset / offsetLength : glm::vec3(0.f, 1.f, 0.f);
+        return offsetLength - radius;
+    }
+
+    void EvaluateBatch(const SDFBatchPoints& points, float* outDistances) const override
+    {
+        SDFBatch::EvaluateSphere(center, radius, points, outDistances);
+    }
+
+    void EvaluateWithGradientBatch(const SDFBatchPoints& points, float* outDistances, const SDFBatchGradients& outGradients) const override
+    {
+        SDFBatch::EvaluateSphereWithGradient(center, radius, points, outDistances, outGradients);
+    }
+
+    static SDFType StaticType() { return SDFType::Sphere; }
+    SDFType GetType() const override { return StaticType(); }
+
+    void GetBounds(glm::vec3& outMin, glm::vec3& outMax) const override
+    {
+        outMin = center - glm::vec3(radius);
+        outMax = center + glm::vec3(radius);
+    }
 
 };
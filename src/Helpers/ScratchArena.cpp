@@ -0,0 +1,72 @@
+#include "ScratchArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+//Smallest block the arena allocates, enough for the row buffers of a few hundred voxels wide grid
+static constexpr size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+void ScratchArena::Rewind(const Marker& marker)
+{
+	m_blockIndex = marker.blockIndex;
+	m_offset = marker.offset;
+
+	//Once the arena is empty, merge the blocks so the next pass of the same size fits in one block
+	if (m_blockIndex == 0 && m_offset == 0 && m_blocks.size() > 1)
+	{
+		size_t totalCapacity = 0;
+		for (const Block& block : m_blocks)
+			totalCapacity += block.capacity;
+
+		m_blocks.clear();
+
+		Block mergedBlock;
+		mergedBlock.memory.reset(new unsigned char[totalCapacity]);
+		mergedBlock.capacity = totalCapacity;
+		m_blocks.push_back(std::move(mergedBlock));
+	}
+}
+
+ScratchArena& ScratchArena::GetThreadArena()
+{
+	thread_local ScratchArena threadArena;
+	return threadArena;
+}
+
+void* ScratchArena::AllocateBytes(const size_t size, const size_t alignment)
+{
+	while (true)
+	{
+		if (m_blockIndex < m_blocks.size())
+		{
+			Block& block = m_blocks[m_blockIndex];
+			const uintptr_t blockStart = reinterpret_cast<uintptr_t>(block.memory.get());
+			const uintptr_t alignedStart = (blockStart + m_offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+			const size_t alignedOffset = static_cast<size_t>(alignedStart - blockStart);
+
+			if (alignedOffset + size <= block.capacity)
+			{
+				m_offset = alignedOffset + size;
+				return block.memory.get() + alignedOffset;
+			}
+
+			//Does not fit, the rest of this block stays unused until the arena is rewound
+			if (m_blockIndex + 1 < m_blocks.size())
+			{
+				++m_blockIndex;
+				m_offset = 0;
+				continue;
+			}
+		}
+
+		//Grow geometrically so a pass needs few blocks before they are merged
+		const size_t previousCapacity = m_blocks.empty() ? 0 : m_blocks.back().capacity;
+		Block newBlock;
+		newBlock.capacity = std::max(std::max(size + alignment, previousCapacity * 2), MIN_BLOCK_SIZE);
+		newBlock.memory.reset(new unsigned char[newBlock.capacity]);
+		m_blocks.push_back(std::move(newBlock));
+
+		m_blockIndex = m_blocks.size() - 1;
+		m_offset = 0;
+	}
+}
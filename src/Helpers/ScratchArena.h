@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+//Bump allocator for the temporary buffers of a meshing pass. Memory is handed out linearly and released all at once by
+//rewinding to a marker, the blocks are kept so later passes of the same size do not touch the heap.
+class ScratchArena
+{
+public:
+	//Position in the arena, everything allocated after it is released by Rewind
+	struct Marker
+	{
+		size_t blockIndex = 0;
+		size_t offset = 0;
+	};
+
+	ScratchArena() = default;
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	//Value-initialized array, only for types that need no destructor since nothing is destroyed on rewind
+	template<typename T>
+	T* Allocate(const size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Scratch arena memory is released without calling destructors");
+
+		T* memory = static_cast<T*>(AllocateBytes(sizeof(T) * count, alignof(T)));
+		for (size_t i = 0; i < count; ++i)
+			new (memory + i) T();
+		return memory;
+	}
+
+	Marker GetMarker() const { return Marker{ m_blockIndex, m_offset }; }
+	void Rewind(const Marker& marker);
+
+	//Arena of the calling thread, pool workers keep theirs between passes
+	static ScratchArena& GetThreadArena();
+
+private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> memory;
+		size_t capacity = 0;
+	};
+
+	void* AllocateBytes(const size_t size, const size_t alignment);
+
+	std::vector<Block> m_blocks;
+	//Block currently allocated from and the used bytes in it
+	size_t m_blockIndex = 0;
+	size_t m_offset = 0;
+};
+
+//Rewinds an arena to where it was when the scope started
+class ScratchScope
+{
+public:
+	explicit ScratchScope(ScratchArena& arena) : m_arena(arena), m_marker(arena.GetMarker()) {}
+	~ScratchScope() { m_arena.Rewind(m_marker); }
+
+	ScratchScope(const ScratchScope&) = delete;
+	ScratchScope& operator=(const ScratchScope&) = delete;
+
+	template<typename T>
+	T* Allocate(const size_t count) { return m_arena.Allocate<T>(count); }
+
+	ScratchArena& GetArena() const { return m_arena; }
+
+private:
+	ScratchArena& m_arena;
+	const ScratchArena::Marker m_marker;
+};
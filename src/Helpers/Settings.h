@@ -15,4 +15,19 @@ public:
 	//TODO: Eventually move to actor class
 	bool bViewMesh = true;
 
+	//Number of threads used for meshing, 0 uses all hardware threads
+	int meshingThreadCount = 0;
+	//Only remesh the region touched by brush edits instead of the whole grid
+	bool bUseIncrementalRemesh = true;
+	//Collapse octree cells whose merged QEF error is below the tolerance instead of emitting one vertex per voxel
+	bool bUseOctreeSimplification = false;
+	//Largest QEF error (sum of squared distances to the hermite planes, in world units) of a collapsed cell
+	float octreeErrorTolerance = 0.001f;
+	//Memory the lattices of chunks outside the clipmap may take, beyond it the least recently used ones are swapped to disk
+	int chunkCacheBudgetMB = 256;
+	//Chunks the camera would reach within this many seconds at its current velocity are loaded before they enter the clipmap
+	float chunkPrefetchSeconds = 1.f;
+	//Most chunks prefetched after each view change
+	int chunkPrefetchLimit = 64;
+
 };
\ No newline at end of file
@@ -0,0 +1,605 @@
+#include "TerrainChunkManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include "ChunkResidencyCache.h"
+#include "DualContouring.h"
+#include "Settings.h"
+#include "VoxelWorldFile.h"
+#include "Components/USDFComponent.h"
+#include "Math/QEFSolver.h"
+
+//Rounds towards negative infinity, unlike integer division
+static int FloorDivide(const int value, const int divisor)
+{
+	const int quotient = value / divisor;
+	return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+}
+
+static glm::ivec3 FloorDivide(const glm::ivec3& value, const int divisor)
+{
+	return glm::ivec3(FloorDivide(value.x, divisor), FloorDivide(value.y, divisor), FloorDivide(value.z, divisor));
+}
+
+//True if a coordinate lies in a range (inclusive) on every axis
+static bool IsInRange(const glm::ivec3& coord, const glm::ivec3& rangeMin, const glm::ivec3& rangeMax)
+{
+	return coord.x >= rangeMin.x && coord.y >= rangeMin.y && coord.z >= rangeMin.z
+		&& coord.x <= rangeMax.x && coord.y <= rangeMax.y && coord.z <= rangeMax.z;
+}
+
+static size_t GetResidencyBudgetBytes(const Settings& settings)
+{
+	return static_cast<size_t>(std::max(settings.chunkCacheBudgetMB, 0)) << 20;
+}
+
+TerrainChunkManager::TerrainChunkManager(const int chunkVoxelCount, const float& voxelSize, const glm::vec3& worldOrigin, const int lodLevelCount, const int ringChunkCount,
+	const std::string& swapFilePath)
+	: m_chunkVoxelCount(std::max(chunkVoxelCount, 1)), m_voxelResolution(voxelSize), m_worldOrigin(worldOrigin),
+	m_lodLevelCount(std::max(lodLevelCount, 1)), m_ringChunkCount(std::max(ringChunkCount, 1)), m_boxChunkCount(4 * m_ringChunkCount + 2)
+{
+	m_chunkSlots.resize(static_cast<size_t>(m_lodLevelCount) * m_boxChunkCount * m_boxChunkCount * m_boxChunkCount);
+	m_prefetchGrids.resize(static_cast<size_t>(m_lodLevelCount));
+
+	//One voxel below the chunk provides the vertices of the faces on its low border. Next to a coarser chunk the faces
+	//reach 2 voxels further down and 1 voxel past the high border, so the finer mesh always overlaps the coarser one.
+	if (m_lodLevelCount > 1)
+	{
+		m_lowMarginVoxels = 3;
+		m_highMarginVoxels = 1;
+	}
+
+	m_residencyCache = std::make_unique<ChunkResidencyCache>(swapFilePath, GetWorldLayout(), GetResidencyBudgetBytes(Settings()));
+}
+
+TerrainChunkManager::~TerrainChunkManager() = default;
+
+bool TerrainChunkManager::SetViewCenter(const glm::vec3& viewPosition)
+{
+	const glm::ivec3 viewChunk = GetChunkCoord(viewPosition, 0);
+	if (m_bHasViewCenter && viewChunk == m_viewChunk)
+		return false;
+
+	m_bHasViewCenter = true;
+	m_viewChunk = viewChunk;
+
+	//Visits every slot once, the slots the box left behind wrap around to the chunks it moved onto
+	for (int lodLevel = 0; lodLevel < m_lodLevelCount; ++lodLevel)
+	{
+		glm::ivec3 chunkMin, chunkMax;
+		GetLevelBox(m_viewChunk, lodLevel, chunkMin, chunkMax);
+
+		for (int z = chunkMin.z; z <= chunkMax.z; ++z)
+		{
+			for (int y = chunkMin.y; y <= chunkMax.y; ++y)
+			{
+				for (int x = chunkMin.x; x <= chunkMax.x; ++x)
+				{
+					const ChunkKey key{ glm::ivec3(x, y, z), lodLevel };
+					TerrainChunk& chunk = m_chunkSlots[GetChunkSlotIndex(key)];
+					const bool bIsInClipmap = IsInClipmap(key);
+					if (chunk.bIsActive && chunk.key == key && bIsInClipmap)
+						continue;
+
+					//The slot's chunk left the box or is covered by the finer level now, handed out as removed by the next pass
+					if (chunk.bIsActive)
+						DeactivateChunk(chunk);
+
+					if (bIsInClipmap)
+						ActivateChunk(chunk, key);
+				}
+			}
+		}
+	}
+
+	//The LOD transitions moved with the rings
+	for (TerrainChunk& chunk : m_chunkSlots)
+	{
+		if (chunk.bIsActive)
+			UpdateChunkBorders(chunk);
+	}
+
+	return true;
+}
+
+glm::ivec3 TerrainChunkManager::GetChunkCoord(const glm::vec3& worldPosition, const int lodLevel) const
+{
+	return glm::ivec3(glm::floor((worldPosition - m_worldOrigin) / GetChunkSize(lodLevel)));
+}
+
+bool TerrainChunkManager::GenerateMesh(const std::weak_ptr<USDFComponent> sdfComponent, const Settings& settings, std::vector<ChunkMesh>& outMeshes, const CancellationToken& cancellation)
+{
+	outMeshes.clear();
+	const std::shared_ptr<USDFComponent> sdf = sdfComponent.lock();
+	if (!sdf)
+		return false;
+
+	//Chunks are meshed in parallel, so bring the BVH and CSG program up to date once before any of them evaluates the SDF
+	sdf->PrepareForEvaluation();
+	m_sdfComponent = sdf;
+	m_sdfFingerprint = sdf->CalculateFingerprint();
+	//Brush edits only live in the lattice, resampling it from the SDF drops them
+	m_brushStrokes.clear();
+	//Kept lattices were sampled from the old SDF
+	m_residencyCache->Clear();
+	m_residencyCache->SetMemoryBudget(GetResidencyBudgetBytes(settings));
+
+	m_passChunks.clear();
+	for (TerrainChunk& chunk : m_chunkSlots)
+	{
+		if (!chunk.bIsActive)
+			continue;
+
+		chunk.bNeedsGenerate = true;
+		chunk.bCanRestoreLattice = false;
+		m_passChunks.push_back(&chunk);
+	}
+
+	return MeshPassChunks(settings, outMeshes, cancellation);
+}
+
+void TerrainChunkManager::ApplyBrush(const float& sphereRadius, const glm::vec3& sphereCenter, EBrushType brushType)
+{
+	const BrushStroke stroke{ sphereRadius, sphereCenter, brushType };
+	m_brushStrokes.push_back(stroke);
+
+	for (int lodLevel = 0; lodLevel < m_lodLevelCount; ++lodLevel)
+	{
+		glm::ivec3 chunkMin, chunkMax;
+		GetBrushChunkRange(stroke, lodLevel, chunkMin, chunkMax);
+
+		for (int z = chunkMin.z; z <= chunkMax.z; ++z)
+		{
+			for (int y = chunkMin.y; y <= chunkMax.y; ++y)
+			{
+				for (int x = chunkMin.x; x <= chunkMax.x; ++x)
+				{
+					//Chunks not sampled yet get the stroke replayed once they are
+					TerrainChunk* chunk = FindChunk(ChunkKey{ glm::ivec3(x, y, z), lodLevel });
+					if (!chunk || chunk->bNeedsGenerate)
+						continue;
+
+					chunk->dualContouring->ApplyBrushToVoxels(sphereRadius, sphereCenter, brushType);
+					if (chunk->dualContouring->HasPendingEdits())
+						chunk->bNeedsRemesh = true;
+				}
+			}
+		}
+	}
+}
+
+bool TerrainChunkManager::UpdateMesh(const Settings& settings, const bool bRemeshAll, std::vector<ChunkMesh>& outMeshes, const CancellationToken& cancellation)
+{
+	outMeshes.clear();
+	m_residencyCache->SetMemoryBudget(GetResidencyBudgetBytes(settings));
+
+	//Untouched chunks keep the mesh they have
+	m_passChunks.clear();
+	for (TerrainChunk& chunk : m_chunkSlots)
+	{
+		if (chunk.bIsActive && (bRemeshAll || chunk.bNeedsGenerate || chunk.bNeedsRemesh))
+			m_passChunks.push_back(&chunk);
+	}
+
+	return MeshPassChunks(settings, outMeshes, cancellation);
+}
+
+bool TerrainChunkManager::SaveWorld(const std::string& path)
+{
+	//Written next to the old file and moved over it once complete, a failed save leaves the old one intact
+	const std::string tempPath = path + ".tmp";
+	bool bIsWritten = false;
+	{
+		VoxelWorldFile worldFile;
+		if (!worldFile.Create(tempPath, GetWorldLayout(), m_sdfFingerprint))
+			return false;
+
+		bIsWritten = m_residencyCache->ExportLattices(worldFile);
+
+		//Written after the cached lattices, which may hold an older lattice of a chunk that is active again. Chunks not
+		//sampled yet are left to the SDF and the stroke log.
+		LatticeSnapshot snapshot;
+		for (TerrainChunk& chunk : m_chunkSlots)
+		{
+			if (chunk.bIsActive && !chunk.bNeedsGenerate && chunk.dualContouring->SaveLattice(snapshot))
+				bIsWritten &= worldFile.WriteChunk(chunk.key, snapshot, m_brushStrokes.size());
+		}
+
+		worldFile.SetBrushStrokes(m_brushStrokes);
+		bIsWritten &= worldFile.Flush();
+	}
+
+	if (!bIsWritten)
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	return m_residencyCache->ReplaceFile(tempPath, path);
+}
+
+bool TerrainChunkManager::LoadWorld(const std::string& path, const std::weak_ptr<USDFComponent> sdfComponent, const Settings& settings, std::vector<ChunkMesh>& outMeshes, const CancellationToken& cancellation)
+{
+	outMeshes.clear();
+	if (sdfComponent.expired())
+		return false;
+
+	//Compiled first, the program is part of the fingerprint the file has to match
+	const std::shared_ptr<USDFComponent> sdf = sdfComponent.lock();
+	sdf->PrepareForEvaluation();
+	const uint64_t sdfFingerprint = sdf->CalculateFingerprint();
+
+	//The terrain stays as it is if the file can't be read
+	std::vector<BrushStroke> brushStrokes;
+	if (!m_residencyCache->OpenWorldFile(path, sdfFingerprint, brushStrokes))
+		return false;
+
+	m_sdfComponent = sdf;
+	m_sdfFingerprint = sdfFingerprint;
+	m_brushStrokes = std::move(brushStrokes);
+	m_residencyCache->SetMemoryBudget(GetResidencyBudgetBytes(settings));
+
+	//Chunks stored in the file are decompressed, the others are sampled and get the strokes replayed
+	m_passChunks.clear();
+	for (TerrainChunk& chunk : m_chunkSlots)
+	{
+		if (!chunk.bIsActive)
+			continue;
+
+		chunk.bNeedsGenerate = true;
+		chunk.bCanRestoreLattice = true;
+		m_passChunks.push_back(&chunk);
+	}
+
+	return MeshPassChunks(settings, outMeshes, cancellation);
+}
+
+void TerrainChunkManager::GetLevelBox(const glm::ivec3& viewChunk, const int lodLevel, glm::ivec3& outChunkMin, glm::ivec3& outChunkMax) const
+{
+	//Starts on an even chunk so the box is made of whole chunks of the next level, which cut it out of their own box
+	const glm::ivec3 levelViewChunk = FloorDivide(viewChunk, 1 << lodLevel);
+	outChunkMin = FloorDivide(levelViewChunk, 2) * 2 - glm::ivec3(2 * m_ringChunkCount);
+	outChunkMax = outChunkMin + glm::ivec3(4 * m_ringChunkCount + 1);
+}
+
+bool TerrainChunkManager::IsInClipmap(const ChunkKey& key, const glm::ivec3& viewChunk) const
+{
+	if (!m_bHasViewCenter || key.lodLevel < 0 || key.lodLevel >= m_lodLevelCount)
+		return false;
+
+	glm::ivec3 chunkMin, chunkMax;
+	GetLevelBox(viewChunk, key.lodLevel, chunkMin, chunkMax);
+	if (!IsInRange(key.coord, chunkMin, chunkMax))
+		return false;
+
+	if (key.lodLevel == 0)
+		return true;
+
+	//The finer level covers the chunks its box lies in
+	GetLevelBox(viewChunk, key.lodLevel - 1, chunkMin, chunkMax);
+	return !IsInRange(key.coord, FloorDivide(chunkMin, 2), FloorDivide(chunkMax, 2));
+}
+
+void TerrainChunkManager::GetBrushChunkRange(const BrushStroke& stroke, const int lodLevel, glm::ivec3& outChunkMin, glm::ivec3& outChunkMax) const
+{
+	//Lattice points of the level the brush may change
+	const float voxelSize = GetVoxelSize(lodLevel);
+	const float influenceRadius = DualContouring::GetBrushInfluenceRadius(stroke.sphereRadius, stroke.brushType, voxelSize);
+	const glm::ivec3 latticeMin(glm::ceil((stroke.sphereCenter - glm::vec3(influenceRadius) - m_worldOrigin) / voxelSize));
+	const glm::ivec3 latticeMax(glm::floor((stroke.sphereCenter + glm::vec3(influenceRadius) - m_worldOrigin) / voxelSize));
+
+	//Chunk c holds the lattice points c * C - lowMargin to c * C + C + highMargin, every chunk sharing an edited point edits it too
+	outChunkMin = FloorDivide(latticeMin - glm::ivec3(m_highMarginVoxels + 1), m_chunkVoxelCount);
+	outChunkMax = FloorDivide(latticeMax + glm::ivec3(m_lowMarginVoxels), m_chunkVoxelCount);
+}
+
+size_t TerrainChunkManager::GetChunkSlotIndex(const ChunkKey& key) const
+{
+	//The box of a level spans m_boxChunkCount chunks per axis, so chunk coordinates modulo it never collide inside the box
+	const glm::ivec3 wrappedCoord = key.coord - FloorDivide(key.coord, m_boxChunkCount) * m_boxChunkCount;
+	const size_t slotsPerLevel = static_cast<size_t>(m_boxChunkCount) * m_boxChunkCount * m_boxChunkCount;
+	return static_cast<size_t>(key.lodLevel) * slotsPerLevel + static_cast<size_t>(wrappedCoord.x + m_boxChunkCount * (wrappedCoord.y + m_boxChunkCount * wrappedCoord.z));
+}
+
+TerrainChunkManager::TerrainChunk* TerrainChunkManager::FindChunk(const ChunkKey& key)
+{
+	if (key.lodLevel < 0 || key.lodLevel >= m_lodLevelCount)
+		return nullptr;
+
+	TerrainChunk& chunk = m_chunkSlots[GetChunkSlotIndex(key)];
+	return (chunk.bIsActive && chunk.key == key) ? &chunk : nullptr;
+}
+
+VoxelWorldLayout TerrainChunkManager::GetWorldLayout() const
+{
+	VoxelWorldLayout layout;
+	layout.chunkVoxelCount = m_chunkVoxelCount;
+	layout.gridVoxelCount = m_chunkVoxelCount + m_lowMarginVoxels + m_highMarginVoxels;
+	layout.voxelSize = m_voxelResolution;
+	layout.worldOrigin = m_worldOrigin;
+	return layout;
+}
+
+glm::ivec3 TerrainChunkManager::GetLatticeOrigin(const ChunkKey& key) const
+{
+	return key.coord * m_chunkVoxelCount - glm::ivec3(m_lowMarginVoxels);
+}
+
+std::unique_ptr<DualContouring> TerrainChunkManager::CreateChunkGrid(const ChunkKey& key) const
+{
+	//Normals come from the shared lattice, so chunks holding the same voxel solve the same vertex for it
+	const glm::ivec3 voxelCount(m_chunkVoxelCount + m_lowMarginVoxels + m_highMarginVoxels);
+	return std::make_unique<DualContouring>(voxelCount, GetVoxelSize(key.lodLevel), m_worldOrigin, GetLatticeOrigin(key), true);
+}
+
+void TerrainChunkManager::ActivateChunk(TerrainChunk& chunk, const ChunkKey& key)
+{
+	if (chunk.dualContouring)
+	{
+		//Reuses the storage of the chunk the slot held before
+		chunk.dualContouring->SetLatticeOrigin(GetLatticeOrigin(key));
+	}
+	else
+	{
+		chunk.dualContouring = CreateChunkGrid(key);
+		//Only the chunk's own voxels emit faces until a LOD transition extends them
+		chunk.dualContouring->SetFaceRange(glm::ivec3(m_lowMarginVoxels), glm::ivec3(m_lowMarginVoxels + m_chunkVoxelCount - 1));
+	}
+
+	chunk.key = key;
+	chunk.bIsActive = true;
+	chunk.bNeedsGenerate = true;
+	chunk.bNeedsRemesh = true;
+	chunk.bCanRestoreLattice = true;
+	++m_activeChunkCount;
+}
+
+void TerrainChunkManager::DeactivateChunk(TerrainChunk& chunk)
+{
+	//A chunk whose lattice was never fully sampled is generated from the SDF if it comes back. Strokes are applied to
+	//sampled chunks right away, so the lattice already holds every logged stroke.
+	LatticeSnapshot snapshot;
+	if (!chunk.bNeedsGenerate && chunk.dualContouring->SaveLattice(snapshot))
+		m_residencyCache->Store(chunk.key, snapshot, m_brushStrokes.size());
+
+	//Handed out as removed by the next pass
+	m_removedChunks.push_back(chunk.key);
+	chunk.bIsActive = false;
+	--m_activeChunkCount;
+}
+
+void TerrainChunkManager::UpdateChunkBorders(TerrainChunk& chunk)
+{
+	const ChunkKey& key = chunk.key;
+	uint8_t finerSides = 0;
+	uint8_t coarserSides = 0;
+
+	for (int side = 0; side < 6; ++side)
+	{
+		glm::ivec3 neighbourCoord = key.coord;
+		neighbourCoord[side / 2] += (side & 1) ? 1 : -1;
+
+		//Boxes are aligned to the next level's chunks, so one child tells whether the neighbour was refined
+		if (IsInClipmap(ChunkKey{ neighbourCoord, key.lodLevel }))
+			continue;
+		if (IsInClipmap(ChunkKey{ neighbourCoord * 2, key.lodLevel - 1 }))
+			finerSides |= 1 << side;
+		else if (IsInClipmap(ChunkKey{ FloorDivide(neighbourCoord, 2), key.lodLevel + 1 }))
+			coarserSides |= 1 << side;
+	}
+
+	if (finerSides == chunk.finerSides && coarserSides == chunk.coarserSides)
+		return;
+
+	chunk.finerSides = finerSides;
+	chunk.coarserSides = coarserSides;
+
+	//Faces reach past the borders towards coarser chunks, see the margins in the constructor
+	glm::ivec3 faceVoxelMin(m_lowMarginVoxels);
+	glm::ivec3 faceVoxelMax(m_lowMarginVoxels + m_chunkVoxelCount - 1);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if ((coarserSides >> (axis * 2)) & 1)
+			faceVoxelMin[axis] -= 2;
+		if ((coarserSides >> (axis * 2 + 1)) & 1)
+			faceVoxelMax[axis] += 1;
+	}
+	chunk.dualContouring->SetFaceRange(faceVoxelMin, faceVoxelMax);
+
+	//Deep enough to cover how far the surfaces of both levels may differ, about a voxel of the coarser level
+	chunk.dualContouring->SetSkirts(finerSides | coarserSides, 2.f * GetVoxelSize(key.lodLevel));
+	chunk.bNeedsRemesh = true;
+}
+
+bool TerrainChunkManager::ReplayBrushStrokes(TerrainChunk& chunk, const size_t firstStroke) const
+{
+	for (size_t strokeIndex = firstStroke; strokeIndex < m_brushStrokes.size(); ++strokeIndex)
+	{
+		const BrushStroke& stroke = m_brushStrokes[strokeIndex];
+		glm::ivec3 chunkMin, chunkMax;
+		GetBrushChunkRange(stroke, chunk.key.lodLevel, chunkMin, chunkMax);
+		if (IsInRange(chunk.key.coord, chunkMin, chunkMax))
+			chunk.dualContouring->ApplyBrushToVoxels(stroke.sphereRadius, stroke.sphereCenter, stroke.brushType);
+	}
+
+	return chunk.dualContouring->HasPendingEdits();
+}
+
+bool TerrainChunkManager::MeshPassChunks(const Settings& settings, std::vector<ChunkMesh>& outMeshes, const CancellationToken& cancellation)
+{
+	const unsigned int threadCount = JobSystem::ResolveThreadCount(static_cast<unsigned int>(std::max(settings.meshingThreadCount, 0)));
+	m_passMeshes.assign(m_passChunks.size(), nullptr);
+
+	//The chunks are meshed in parallel, so the solver counters cover the whole pass rather than one chunk
+	if (!m_passChunks.empty())
+		QEFSolver::ResetStats();
+
+	//One task per chunk, the passes of each chunk spread over the remaining threads
+	JobSystem::GetShared().ParallelFor(static_cast<int>(m_passChunks.size()), [&](const int passIndex)
+	{
+		if (cancellation.IsCancelled())
+			return;
+
+		TerrainChunk& chunk = *m_passChunks[passIndex];
+		SharedMeshData mesh;
+		if (chunk.bNeedsGenerate)
+		{
+			if (!m_sdfComponent)
+				return;
+
+			mesh = GenerateChunkMesh(chunk, settings, cancellation);
+		}
+		else
+		{
+			mesh = chunk.dualContouring->UpdateMesh(settings, cancellation);
+		}
+
+		//A cancelled chunk stays flagged and is meshed by the next pass
+		if (!mesh)
+			return;
+
+		chunk.bNeedsGenerate = false;
+		chunk.bNeedsRemesh = false;
+		m_passMeshes[passIndex] = std::move(mesh);
+	}, threadCount);
+
+	//Removals first, so a chunk that left and re-entered the clipmap ends up with its new mesh
+	for (const ChunkKey& removedChunk : m_removedChunks)
+		outMeshes.push_back(ChunkMesh{ removedChunk, nullptr, settings.bShouldFlatShade });
+	m_removedChunks.clear();
+
+	//Chunks finished before a cancellation are handed out too, they are no longer flagged
+	for (size_t passIndex = 0; passIndex < m_passChunks.size(); ++passIndex)
+	{
+		if (m_passMeshes[passIndex])
+			outMeshes.push_back(ChunkMesh{ m_passChunks[passIndex]->key, std::move(m_passMeshes[passIndex]), settings.bShouldFlatShade });
+	}
+
+	return !cancellation.IsCancelled();
+}
+
+SharedMeshData TerrainChunkManager::GenerateChunkMesh(TerrainChunk& chunk, const Settings& settings, const CancellationToken& cancellation)
+{
+	const auto loadStart = std::chrono::steady_clock::now();
+
+	//A chunk entering the clipmap restores the lattice it left with or was prefetched. The pass only counts as stalled on
+	//it if it had to read it from disk or sample the SDF, regenerations don't count.
+	const bool bIsEntering = chunk.bCanRestoreLattice;
+	bool bIsStalled = false;
+	bool bIsRestored = false;
+	size_t restoredStrokeCount = 0;
+	if (bIsEntering)
+	{
+		chunk.bCanRestoreLattice = false;
+		bIsStalled = m_residencyCache->IsOnDisk(chunk.key);
+
+		LatticeSnapshot snapshot;
+		bIsRestored = m_residencyCache->Take(chunk.key, snapshot, restoredStrokeCount) && chunk.dualContouring->RestoreLattice(snapshot, m_sdfComponent);
+	}
+
+	SharedMeshData mesh;
+	if (bIsRestored)
+	{
+		//Strokes made while the chunk was outside the clipmap
+		ReplayBrushStrokes(chunk, restoredStrokeCount);
+		mesh = chunk.dualContouring->UpdateMesh(settings, cancellation);
+	}
+	else
+	{
+		bIsStalled = bIsEntering;
+		mesh = chunk.dualContouring->InitGenerateMesh(m_sdfComponent, settings, cancellation);
+		//Edits made before the chunk entered the clipmap
+		if (mesh && ReplayBrushStrokes(chunk, 0))
+			mesh = chunk.dualContouring->UpdateMesh(settings, cancellation);
+	}
+
+	if (mesh && bIsStalled)
+		m_residencyCache->RecordStall(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count());
+
+	return mesh;
+}
+
+bool TerrainChunkManager::PrefetchChunks(const glm::vec3& viewPosition, const glm::vec3& viewVelocity, const Settings& settings, const CancellationToken& cancellation)
+{
+	m_residencyCache->SetMemoryBudget(GetResidencyBudgetBytes(settings));
+	if (!m_bHasViewCenter || !m_sdfComponent)
+		return true;
+
+	const glm::ivec3 predictedViewChunk = GetChunkCoord(viewPosition + viewVelocity * settings.chunkPrefetchSeconds, 0);
+	if (predictedViewChunk == m_viewChunk)
+		return true;
+
+	//Chunks of the predicted clipmap that aren't in the current one or already in memory
+	m_prefetchCandidates.clear();
+	for (int lodLevel = 0; lodLevel < m_lodLevelCount; ++lodLevel)
+	{
+		glm::ivec3 chunkMin, chunkMax;
+		GetLevelBox(predictedViewChunk, lodLevel, chunkMin, chunkMax);
+
+		for (int z = chunkMin.z; z <= chunkMax.z; ++z)
+		{
+			for (int y = chunkMin.y; y <= chunkMax.y; ++y)
+			{
+				for (int x = chunkMin.x; x <= chunkMax.x; ++x)
+				{
+					const ChunkKey key{ glm::ivec3(x, y, z), lodLevel };
+					if (!IsInClipmap(key, predictedViewChunk) || FindChunk(key) || (m_residencyCache->Contains(key) && !m_residencyCache->IsOnDisk(key)))
+						continue;
+
+					const glm::vec3 chunkCenter = m_worldOrigin + (glm::vec3(key.coord) + glm::vec3(0.5f)) * GetChunkSize(lodLevel);
+					m_prefetchCandidates.push_back(std::make_pair(glm::length(chunkCenter - viewPosition), key));
+				}
+			}
+		}
+	}
+
+	//The nearest chunks enter the clipmap first
+	std::sort(m_prefetchCandidates.begin(), m_prefetchCandidates.end(), [](const std::pair<float, ChunkKey>& a, const std::pair<float, ChunkKey>& b) { return a.first < b.first; });
+	const size_t prefetchCount = std::min(m_prefetchCandidates.size(), static_cast<size_t>(std::max(settings.chunkPrefetchLimit, 0)));
+
+	//Prefetching more than the budget would swap out the nearest chunks again to make room for farther ones
+	const size_t prefetchBudgetBytes = GetResidencyBudgetBytes(settings);
+	size_t prefetchedBytes = 0;
+
+	LatticeSnapshot snapshot;
+	for (size_t candidateIndex = 0; candidateIndex < prefetchCount && prefetchedBytes < prefetchBudgetBytes; ++candidateIndex)
+	{
+		if (cancellation.IsCancelled())
+			return false;
+
+		const ChunkKey& key = m_prefetchCandidates[candidateIndex].second;
+		if (m_residencyCache->IsOnDisk(key))
+		{
+			size_t latticeByteSize = 0;
+			if (m_residencyCache->Prefetch(key, latticeByteSize))
+			{
+				m_residencyCache->RecordPrefetch();
+				prefetchedBytes += latticeByteSize;
+			}
+			continue;
+		}
+
+		//Sampled into a spare grid of the level, the chunk's strokes are all replayed once it enters the clipmap
+		std::unique_ptr<DualContouring>& prefetchGrid = m_prefetchGrids[key.lodLevel];
+		if (!prefetchGrid)
+			prefetchGrid = CreateChunkGrid(key);
+		prefetchGrid->SetLatticeOrigin(GetLatticeOrigin(key));
+
+		if (!prefetchGrid->InitSampleLattice(m_sdfComponent, settings, cancellation))
+			return false;
+		if (prefetchGrid->SaveLattice(snapshot))
+		{
+			prefetchedBytes += snapshot.GetByteSize();
+			m_residencyCache->Store(key, snapshot, 0);
+			m_residencyCache->RecordPrefetch();
+		}
+	}
+
+	return !cancellation.IsCancelled();
+}
+
+ChunkResidencyStats TerrainChunkManager::GetResidencyStats() const
+{
+	return m_residencyCache->GetStats();
+}
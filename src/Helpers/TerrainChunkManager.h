@@ -0,0 +1,204 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+#include "MeshData.h"
+
+enum class EBrushType;
+class ChunkResidencyCache;
+class DualContouring;
+class Settings;
+struct ChunkResidencyStats;
+struct LatticeSnapshot;
+struct VoxelWorldLayout;
+class USDFComponent;
+
+//Chunk of one LOD level, the voxels of level l are 2^l times the size of level 0 voxels
+struct ChunkKey
+{
+	glm::ivec3 coord = glm::ivec3(0);
+	int lodLevel = 0;
+
+	bool operator==(const ChunkKey& other) const { return coord == other.coord && lodLevel == other.lodLevel; }
+	bool operator!=(const ChunkKey& other) const { return !(*this == other); }
+};
+
+//Hash of a chunk key, for the chunk maps
+struct ChunkKeyHash
+{
+	size_t operator()(const ChunkKey& key) const
+	{
+		//Large primes spread neighbouring coordinates over the buckets
+		return static_cast<size_t>(key.coord.x) * 73856093u ^ static_cast<size_t>(key.coord.y) * 19349663u ^ static_cast<size_t>(key.coord.z) * 83492791u
+			^ static_cast<size_t>(key.lodLevel) * 2654435761u;
+	}
+};
+
+//Mesh of one chunk and the shading mode it was built with, replaces the previous mesh of the same chunk. A null mesh
+//means the chunk left the clipmap.
+struct ChunkMesh
+{
+	ChunkKey key;
+	SharedMeshData mesh;
+	bool bIsFlatShaded = false;
+};
+
+struct BrushStroke
+{
+	float sphereRadius;
+	glm::vec3 sphereCenter;
+	EBrushType brushType;
+};
+
+//Tiles space into cubic chunks of chunkVoxelCount voxels per axis, each meshed by its own DualContouring grid, so the
+//cost of an edit depends on the chunks it overlaps rather than on the size of the world.
+//A chunk's grid also holds the last voxel of the chunks below it on each axis. Those voxels only provide vertices to the
+//faces on the chunk's low border, which the chunk owns, so every face is emitted by exactly one chunk. Lattice positions
+//are computed from global lattice indices, so the vertices of a voxel held by two chunks are identical and the borders
+//close without seams.
+//The chunks form a clipmap around the view center: LOD level l is a box of (4 * ringChunkCount + 2)^3 chunks with the
+//box of level l - 1 cut out, so the triangle count stays about the same however far the terrain reaches. Boxes are
+//aligned to the chunks of the next level, so neighbouring chunks differ by one level at most. Across a LOD transition the
+//finer chunk's faces reach past the border into the coarser chunk and both chunks hang a skirt from their border, which
+//hides the cracks between the two resolutions.
+//Each level keeps one slot per chunk of its box, addressed by chunk coordinate modulo the box size like a toroidal ring
+//buffer. When the box moves, the slots of the chunks leaving it pass their storage on to the chunks entering on the
+//opposite side, so a camera step only samples and meshes the newly exposed slabs of chunks and allocates nothing.
+//The lattices of chunks leaving the clipmap are kept by a ChunkResidencyCache, so coming back restores them instead of
+//sampling the SDF. PrefetchChunks fills it ahead of the camera, the chunks then enter the clipmap without stalling a pass.
+//SaveWorld and LoadWorld keep the sculpted lattices across runs in a VoxelWorldFile.
+class TerrainChunkManager
+{
+public:
+	//Chunk (0,0,0) of every level starts at worldOrigin. Lattices swapped out of memory are written to the file at
+	//swapFilePath.
+	TerrainChunkManager(const int chunkVoxelCount, const float& voxelSize, const glm::vec3& worldOrigin, const int lodLevelCount = 1, const int ringChunkCount = 1,
+		const std::string& swapFilePath = "TerrainChunks.swap");
+	~TerrainChunkManager();
+
+	TerrainChunkManager(const TerrainChunkManager&) = delete;
+	TerrainChunkManager& operator=(const TerrainChunkManager&) = delete;
+
+	//Re-centres the clipmap on a world position. Chunks entering it are meshed and chunks leaving it handed out as removed
+	//by the next update. Returns false if the view stayed in the same level 0 chunk, nothing changes then.
+	bool SetViewCenter(const glm::vec3& viewPosition);
+	//Coordinate of the chunk of a LOD level containing a world position. Only reads the layout, so any thread may call it.
+	glm::ivec3 GetChunkCoord(const glm::vec3& worldPosition, const int lodLevel) const;
+	float GetChunkSize(const int lodLevel) const { return static_cast<float>(m_chunkVoxelCount) * GetVoxelSize(lodLevel); }
+	float GetVoxelSize(const int lodLevel) const { return m_voxelResolution * static_cast<float>(1 << lodLevel); }
+	size_t GetChunkCount() const { return m_activeChunkCount; }
+
+	//Samples and meshes every chunk from the SDF, brush edits made so far are dropped. Returns false if cancelled, the
+	//meshes of the chunks that finished are still returned and the others are generated again by the next update.
+	bool GenerateMesh(const std::weak_ptr<USDFComponent> sdfComponent, const Settings& settings, std::vector<ChunkMesh>& outMeshes, const CancellationToken& cancellation = CancellationToken());
+	//Applies a brush to the chunks whose lattice it overlaps. Chunks entering the clipmap later get it too.
+	void ApplyBrush(const float& sphereRadius, const glm::vec3& sphereCenter, EBrushType brushType);
+	//Remeshes the chunks that entered the clipmap or were edited since the last update, or every chunk if bRemeshAll
+	//(e.g. the shading mode changed). Returns false if cancelled, like GenerateMesh.
+	bool UpdateMesh(const Settings& settings, const bool bRemeshAll, std::vector<ChunkMesh>& outMeshes, const CancellationToken& cancellation = CancellationToken());
+	//Writes the lattices of every sampled chunk, in the clipmap or cached, and the stroke log to a world file
+	bool SaveWorld(const std::string& path);
+	//Replaces the terrain with a world file saved for the same SDF and chunk layout and meshes the clipmap. Its chunks
+	//are decompressed as they enter the clipmap, chunks it doesn't hold are sampled. Returns false and keeps the terrain
+	//if the file can't be read, and returns false if cancelled, like GenerateMesh.
+	bool LoadWorld(const std::string& path, const std::weak_ptr<USDFComponent> sdfComponent, const Settings& settings, std::vector<ChunkMesh>& outMeshes, const CancellationToken& cancellation = CancellationToken());
+	//Loads the lattices of the chunks the clipmap would gain if the view kept its velocity for settings.chunkPrefetchSeconds,
+	//or samples them from the SDF, nearest to the view first. Returns false if cancelled.
+	bool PrefetchChunks(const glm::vec3& viewPosition, const glm::vec3& viewVelocity, const Settings& settings, const CancellationToken& cancellation = CancellationToken());
+	//Counters of the residency cache, any thread may call it
+	ChunkResidencyStats GetResidencyStats() const;
+
+private:
+	struct TerrainChunk
+	{
+		ChunkKey key;
+		std::unique_ptr<DualContouring> dualContouring;
+		//Set until the lattice was sampled from the current SDF, a cancelled generation leaves it set
+		bool bNeedsGenerate = true;
+		//Set until the chunk's mesh matches its lattice, edits set it again
+		bool bNeedsRemesh = true;
+		//Sides (bit axis * 2, plus 1 for the high side) whose neighbour is one LOD level finer or coarser
+		uint8_t finerSides = 0;
+		uint8_t coarserSides = 0;
+		//Set while the slot holds a chunk of the clipmap, slots under the finer level's box stay empty
+		bool bIsActive = false;
+		//Set from entering the clipmap until the next pass looked for the chunk's lattice in the residency cache
+		bool bCanRestoreLattice = false;
+	};
+
+	//Range (inclusive) of the chunks of a LOD level in the clipmap box around a level 0 chunk, before the finer level is cut out
+	void GetLevelBox(const glm::ivec3& viewChunk, const int lodLevel, glm::ivec3& outChunkMin, glm::ivec3& outChunkMax) const;
+	bool IsInClipmap(const ChunkKey& key) const { return IsInClipmap(key, m_viewChunk); }
+	//True if the chunk would be in the clipmap centred on a level 0 chunk
+	bool IsInClipmap(const ChunkKey& key, const glm::ivec3& viewChunk) const;
+	//Range (inclusive) of the chunks of a LOD level whose lattice a brush may change
+	void GetBrushChunkRange(const BrushStroke& stroke, const int lodLevel, glm::ivec3& outChunkMin, glm::ivec3& outChunkMax) const;
+	//Wrapped index of the slot of a chunk, wherever the box of its level is the box maps onto the slots one to one
+	size_t GetChunkSlotIndex(const ChunkKey& key) const;
+	//Returns the chunk if its slot currently holds it
+	TerrainChunk* FindChunk(const ChunkKey& key);
+	//Chunk tiling of the files lattices are stored in
+	VoxelWorldLayout GetWorldLayout() const;
+	glm::ivec3 GetLatticeOrigin(const ChunkKey& key) const;
+	std::unique_ptr<DualContouring> CreateChunkGrid(const ChunkKey& key) const;
+	//Moves a slot to a chunk entering the clipmap, the chunk is generated by the next pass
+	void ActivateChunk(TerrainChunk& chunk, const ChunkKey& key);
+	//Hands the lattice of a chunk leaving the clipmap to the residency cache
+	void DeactivateChunk(TerrainChunk& chunk);
+	//Extends the faces of a chunk towards coarser neighbours and skirts its LOD transitions, flags it if they changed
+	void UpdateChunkBorders(TerrainChunk& chunk);
+	//Applies the logged strokes from firstStroke on overlapping a chunk whose lattice was just sampled or restored, returns
+	//false if none did
+	bool ReplayBrushStrokes(TerrainChunk& chunk, const size_t firstStroke) const;
+	//Restores or samples the lattice of a chunk flagged for generation and meshes it, returns nullptr if cancelled
+	SharedMeshData GenerateChunkMesh(TerrainChunk& chunk, const Settings& settings, const CancellationToken& cancellation);
+	//Meshes the chunks of m_passChunks in parallel, returns false if cancelled
+	bool MeshPassChunks(const Settings& settings, std::vector<ChunkMesh>& outMeshes, const CancellationToken& cancellation);
+
+private:
+	int m_chunkVoxelCount = 16;
+	float m_voxelResolution = 1.f;
+	glm::vec3 m_worldOrigin = glm::vec3(0.f);
+	int m_lodLevelCount = 1;
+	int m_ringChunkCount = 1;
+	//Chunks per axis of a level's box
+	int m_boxChunkCount = 6;
+	//Voxels a chunk's grid holds below and above the chunk on each axis
+	int m_lowMarginVoxels = 1;
+	int m_highMarginVoxels = 0;
+
+	//Level 0 chunk the clipmap is centred on
+	bool m_bHasViewCenter = false;
+	glm::ivec3 m_viewChunk = glm::ivec3(0);
+
+	//SDF of the last generation, chunks it didn't reach are generated from it by the next update. Kept alive here, the
+	//background mesher hands in snapshots nothing else holds on to.
+	std::shared_ptr<USDFComponent> m_sdfComponent;
+	//Fingerprint of that SDF, world files only hold lattices sampled from the same one
+	uint64_t m_sdfFingerprint = 0;
+	//Strokes since the last generation in the order they were made, replayed on chunks entering the clipmap
+	std::vector<BrushStroke> m_brushStrokes;
+
+	//m_boxChunkCount^3 slots per level, see GetChunkSlotIndex. Allocated once, so pointers to them stay valid.
+	std::vector<TerrainChunk> m_chunkSlots;
+	size_t m_activeChunkCount = 0;
+	//Chunks that left the clipmap since the last pass, handed out as removed by the next one
+	std::vector<ChunkKey> m_removedChunks;
+
+	//Chunks a pass works on and their meshes, reused across passes
+	std::vector<TerrainChunk*> m_passChunks;
+	std::vector<SharedMeshData> m_passMeshes;
+
+	//Lattices of chunks outside the clipmap
+	std::unique_ptr<ChunkResidencyCache> m_residencyCache;
+	//Chunks PrefetchChunks considers and their distance to the view, reused across calls
+	std::vector<std::pair<float, ChunkKey>> m_prefetchCandidates;
+	//Grid per LOD level that samples prefetched lattices, created on first use
+	std::vector<std::unique_ptr<DualContouring>> m_prefetchGrids;
+};
@@ -0,0 +1,861 @@
+#include "VoxelWorldFile.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	const char FileMagic[4] = { 'D', 'C', 'V', 'W' };
+	//Magic, version, layout, SDF fingerprint, directory and stroke log extents and checksums, header checksum
+	const size_t HeaderSize = 4 + 4 + 4 + 4 + 4 + 12 + 8 + 8 + 4 + 4 + 8 + 4 + 4 + 4;
+
+	//Quantized distances are steps of 1/DistanceStepsPerVoxel voxel, clamped to +-128 voxels
+	const float DistanceStepsPerVoxel = 256.f;
+	//Distances whose code is within this many steps of the surface (4 voxels) are kept exactly, and so are the points of
+	//lattice edges the surface crosses, however steep the field got from brush strokes
+	const int NearDistanceCode = 4 * 256;
+	//Octahedron code of a zero normal, e.g. the unused normals of pruned lattice points
+	const int16_t ZeroNormalCode = -32768;
+
+	//Shortest match the LZ compressor emits, and how far back a match may start
+	const size_t MinMatchLength = 4;
+	const size_t MaxMatchOffset = 65535;
+	const int MatchHashBits = 12;
+
+	template<typename T>
+	void AppendValue(std::vector<uint8_t>& bytes, const T& value)
+	{
+		const uint8_t* valueBytes = reinterpret_cast<const uint8_t*>(&value);
+		bytes.insert(bytes.end(), valueBytes, valueBytes + sizeof(T));
+	}
+
+	//Reads values from a byte buffer, every read fails once it ran past the end
+	class ByteReader
+	{
+	public:
+		ByteReader(const uint8_t* data, const size_t size) : m_data(data), m_size(size) {}
+
+		template<typename T>
+		bool Read(T& outValue)
+		{
+			return ReadBytes(&outValue, sizeof(T));
+		}
+
+		bool ReadBytes(void* outBytes, const size_t byteCount)
+		{
+			if (byteCount > m_size - m_position)
+				return false;
+			std::memcpy(outBytes, m_data + m_position, byteCount);
+			m_position += byteCount;
+			return true;
+		}
+
+		//Skips bytes the caller reads itself, returns nullptr if they run past the end
+		const uint8_t* TakeBytes(const size_t byteCount)
+		{
+			if (byteCount > m_size - m_position)
+				return nullptr;
+			const uint8_t* bytes = m_data + m_position;
+			m_position += byteCount;
+			return bytes;
+		}
+
+		bool IsAtEnd() const { return m_position == m_size; }
+
+	private:
+		const uint8_t* m_data;
+		size_t m_size;
+		size_t m_position = 0;
+	};
+
+	uint32_t CalculateChecksum(const uint8_t* bytes, const size_t byteCount)
+	{
+		//CRC-32 (IEEE), table built on first use
+		static const std::array<uint32_t, 256> crcTable = []()
+		{
+			std::array<uint32_t, 256> table;
+			for (uint32_t tableIndex = 0; tableIndex < 256; ++tableIndex)
+			{
+				uint32_t crc = tableIndex;
+				for (int bit = 0; bit < 8; ++bit)
+					crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+				table[tableIndex] = crc;
+			}
+			return table;
+		}();
+
+		uint32_t crc = 0xFFFFFFFFu;
+		for (size_t byteIndex = 0; byteIndex < byteCount; ++byteIndex)
+			crc = crcTable[(crc ^ bytes[byteIndex]) & 0xFF] ^ (crc >> 8);
+		return crc ^ 0xFFFFFFFFu;
+	}
+
+	uint32_t CalculateChecksum(const std::vector<uint8_t>& bytes)
+	{
+		return CalculateChecksum(bytes.data(), bytes.size());
+	}
+
+	// -- LZ COMPRESSION --
+	//Sequences of a token (literal count in the high nibble, match length - 4 in the low one, 15 continues in extra bytes
+	//of up to 255), the literals, and the 2 byte offset of the match. The last sequence only holds literals.
+
+	void AppendLength(std::vector<uint8_t>& bytes, size_t length)
+	{
+		while (length >= 255)
+		{
+			bytes.push_back(255);
+			length -= 255;
+		}
+		bytes.push_back(static_cast<uint8_t>(length));
+	}
+
+	void AppendSequence(std::vector<uint8_t>& outBytes, const uint8_t* literals, const size_t literalCount, const size_t matchOffset, const size_t matchLength)
+	{
+		const size_t matchCode = matchLength > 0 ? matchLength - MinMatchLength : 0;
+		outBytes.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15)));
+		if (literalCount >= 15)
+			AppendLength(outBytes, literalCount - 15);
+		outBytes.insert(outBytes.end(), literals, literals + literalCount);
+
+		if (matchLength == 0)
+			return;
+
+		outBytes.push_back(static_cast<uint8_t>(matchOffset & 0xFF));
+		outBytes.push_back(static_cast<uint8_t>(matchOffset >> 8));
+		if (matchCode >= 15)
+			AppendLength(outBytes, matchCode - 15);
+	}
+
+	void Compress(const std::vector<uint8_t>& bytes, std::vector<uint8_t>& outBytes)
+	{
+		outBytes.clear();
+		outBytes.reserve(bytes.size() / 2);
+
+		//Last position each hashed 4 byte sequence was seen at
+		std::vector<int64_t> matchTable(size_t(1) << MatchHashBits, -1);
+
+		const size_t byteCount = bytes.size();
+		size_t literalStart = 0;
+		size_t position = 0;
+		while (position + MinMatchLength <= byteCount)
+		{
+			uint32_t sequence;
+			std::memcpy(&sequence, &bytes[position], sizeof(sequence));
+			const uint32_t hash = (sequence * 2654435761u) >> (32 - MatchHashBits);
+			const int64_t candidate = matchTable[hash];
+			matchTable[hash] = static_cast<int64_t>(position);
+
+			if (candidate < 0 || position - static_cast<size_t>(candidate) > MaxMatchOffset || std::memcmp(&bytes[static_cast<size_t>(candidate)], &bytes[position], MinMatchLength) != 0)
+			{
+				++position;
+				continue;
+			}
+
+			//Matches may overlap the bytes they produce, which turns runs into a match at offset 1
+			const size_t matchStart = static_cast<size_t>(candidate);
+			size_t matchLength = MinMatchLength;
+			while (position + matchLength < byteCount && bytes[matchStart + matchLength] == bytes[position + matchLength])
+				++matchLength;
+
+			AppendSequence(outBytes, bytes.data() + literalStart, position - literalStart, position - matchStart, matchLength);
+			position += matchLength;
+			literalStart = position;
+		}
+
+		AppendSequence(outBytes, bytes.data() + literalStart, byteCount - literalStart, 0, 0);
+	}
+
+	bool ReadLength(ByteReader& reader, size_t& inOutLength)
+	{
+		uint8_t lengthByte = 255;
+		while (lengthByte == 255)
+		{
+			if (!reader.Read(lengthByte))
+				return false;
+			inOutLength += lengthByte;
+		}
+		return true;
+	}
+
+	bool Decompress(const std::vector<uint8_t>& bytes, const size_t rawSize, std::vector<uint8_t>& outBytes)
+	{
+		outBytes.resize(rawSize);
+		ByteReader reader(bytes.data(), bytes.size());
+		size_t outPosition = 0;
+
+		while (true)
+		{
+			uint8_t token;
+			if (!reader.Read(token))
+				return false;
+
+			size_t literalCount = token >> 4;
+			if (literalCount == 15 && !ReadLength(reader, literalCount))
+				return false;
+			if (literalCount > rawSize - outPosition || !reader.ReadBytes(outBytes.data() + outPosition, literalCount))
+				return false;
+			outPosition += literalCount;
+
+			if (reader.IsAtEnd())
+				return outPosition == rawSize;
+
+			uint8_t offsetBytes[2];
+			if (!reader.ReadBytes(offsetBytes, 2))
+				return false;
+			const size_t matchOffset = offsetBytes[0] | (static_cast<size_t>(offsetBytes[1]) << 8);
+
+			size_t matchLength = token & 0x0F;
+			if (matchLength == 15 && !ReadLength(reader, matchLength))
+				return false;
+			matchLength += MinMatchLength;
+
+			if (matchOffset == 0 || matchOffset > outPosition || matchLength > rawSize - outPosition)
+				return false;
+
+			//Byte by byte, the match may overlap the bytes it produces
+			for (size_t byteIndex = 0; byteIndex < matchLength; ++byteIndex, ++outPosition)
+				outBytes[outPosition] = outBytes[outPosition - matchOffset];
+		}
+	}
+
+	// -- LATTICE ENCODING --
+
+	int16_t QuantizeDistance(const float distance, const float distanceStep)
+	{
+		//Points inside the surface have a distance <= 0, rounding must not move a point outside onto it
+		float steps = std::round(distance / distanceStep);
+		if (distance > 0.f)
+			steps = std::max(steps, 1.f);
+		return static_cast<int16_t>(std::max(-32767.f, std::min(32767.f, steps)));
+	}
+
+	//Flags the points whose exact distance and normal are stored: near the surface or on an edge it crosses. Only reads
+	//the codes, which keep the sign of the distances, so the decoder finds the same points.
+	void FindExactPoints(const std::vector<int16_t>& distanceCodes, const int pointsPerAxis, std::vector<uint8_t>& outIsExact)
+	{
+		const size_t pointCount = distanceCodes.size();
+		const size_t rowSize = static_cast<size_t>(pointsPerAxis);
+		const size_t planeSize = rowSize * rowSize;
+
+		std::vector<uint8_t> isInside(pointCount);
+		outIsExact.resize(pointCount);
+		for (size_t pointIndex = 0; pointIndex < pointCount; ++pointIndex)
+		{
+			isInside[pointIndex] = distanceCodes[pointIndex] <= 0;
+			outIsExact[pointIndex] = std::abs(static_cast<int>(distanceCodes[pointIndex])) <= NearDistanceCode;
+		}
+
+		//Both points of an edge whose ends are on different sides, branch free so the loops vectorize
+		auto markCrossings = [&](const size_t firstPoint, const size_t endPoint, const size_t stride)
+		{
+			for (size_t pointIndex = firstPoint; pointIndex < endPoint; ++pointIndex)
+			{
+				const uint8_t bIsCrossed = isInside[pointIndex] ^ isInside[pointIndex + stride];
+				outIsExact[pointIndex] |= bIsCrossed;
+				outIsExact[pointIndex + stride] |= bIsCrossed;
+			}
+		};
+
+		for (size_t rowStart = 0; rowStart < pointCount; rowStart += rowSize)
+			markCrossings(rowStart, rowStart + rowSize - 1, 1);
+		for (size_t planeStart = 0; planeStart < pointCount; planeStart += planeSize)
+			markCrossings(planeStart, planeStart + planeSize - rowSize, rowSize);
+		markCrossings(0, pointCount - planeSize, planeSize);
+	}
+
+	float GetSign(const float value)
+	{
+		return value < 0.f ? -1.f : 1.f;
+	}
+
+	void EncodeOctahedral(const glm::vec3& normal, int16_t& outX, int16_t& outY)
+	{
+		const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+		if (!(length > 0.f))
+		{
+			outX = ZeroNormalCode;
+			outY = 0;
+			return;
+		}
+
+		//Project onto the octahedron, the lower half folds over the upper one
+		float x = normal.x / length;
+		float y = normal.y / length;
+		if (normal.z < 0.f)
+		{
+			const float foldedX = (1.f - std::abs(y)) * GetSign(x);
+			y = (1.f - std::abs(x)) * GetSign(y);
+			x = foldedX;
+		}
+
+		outX = static_cast<int16_t>(std::round(std::max(-1.f, std::min(1.f, x)) * 32767.f));
+		outY = static_cast<int16_t>(std::round(std::max(-1.f, std::min(1.f, y)) * 32767.f));
+	}
+
+	glm::vec3 DecodeOctahedral(const int16_t codeX, const int16_t codeY)
+	{
+		if (codeX == ZeroNormalCode)
+			return glm::vec3(0.f);
+
+		//Selects instead of branching, the lower and upper half alternate unpredictably
+		const float foldedX = codeX / 32767.f;
+		const float foldedY = codeY / 32767.f;
+		const float z = 1.f - std::abs(foldedX) - std::abs(foldedY);
+		const float unfoldedX = (1.f - std::abs(foldedY)) * GetSign(foldedX);
+		const float unfoldedY = (1.f - std::abs(foldedX)) * GetSign(foldedY);
+		const float x = z < 0.f ? unfoldedX : foldedX;
+		const float y = z < 0.f ? unfoldedY : foldedY;
+		const float inverseLength = 1.f / std::sqrt(x * x + y * y + z * z);
+		return glm::vec3(x * inverseLength, y * inverseLength, z * inverseLength);
+	}
+
+	bool EncodeLattice(const LatticeSnapshot& snapshot, const int pointsPerAxis, const float distanceStep, std::vector<uint8_t>& outBytes)
+	{
+		const size_t pointCount = snapshot.distances.size();
+		if (pointCount != static_cast<size_t>(pointsPerAxis) * pointsPerAxis * pointsPerAxis || snapshot.normals.size() != pointCount)
+			return false;
+
+		outBytes.clear();
+		AppendValue(outBytes, static_cast<uint32_t>(pointCount));
+		AppendValue(outBytes, static_cast<uint32_t>(snapshot.blockStates.size()));
+		AppendValue(outBytes, static_cast<uint32_t>(snapshot.blockDistanceBounds.size()));
+		AppendValue(outBytes, distanceStep);
+
+		std::vector<int16_t> distanceCodes(pointCount);
+		for (size_t pointIndex = 0; pointIndex < pointCount; ++pointIndex)
+			distanceCodes[pointIndex] = QuantizeDistance(snapshot.distances[pointIndex], distanceStep);
+
+		//Neighbouring points along x have similar distances, so the differences repeat far more than the codes. Low and
+		//high bytes go to separate planes, the high bytes are mostly 0x00 or 0xFF.
+		const size_t planeStart = outBytes.size();
+		outBytes.resize(planeStart + pointCount * 2);
+		uint16_t previousCode = 0;
+		for (size_t pointIndex = 0; pointIndex < pointCount; ++pointIndex)
+		{
+			const uint16_t distanceCode = static_cast<uint16_t>(distanceCodes[pointIndex]);
+			const uint16_t codeDelta = static_cast<uint16_t>(distanceCode - previousCode);
+			outBytes[planeStart + pointIndex] = static_cast<uint8_t>(codeDelta & 0xFF);
+			outBytes[planeStart + pointCount + pointIndex] = static_cast<uint8_t>(codeDelta >> 8);
+			previousCode = distanceCode;
+		}
+
+		//Exact distances and normals where the vertices and faces are built from them
+		std::vector<uint8_t> isExact;
+		FindExactPoints(distanceCodes, pointsPerAxis, isExact);
+		for (size_t pointIndex = 0; pointIndex < pointCount; ++pointIndex)
+		{
+			if (isExact[pointIndex])
+			{
+				AppendValue(outBytes, snapshot.distances[pointIndex]);
+				AppendValue(outBytes, snapshot.normals[pointIndex]);
+			}
+			else
+			{
+				int16_t codeX, codeY;
+				EncodeOctahedral(snapshot.normals[pointIndex], codeX, codeY);
+				AppendValue(outBytes, codeX);
+				AppendValue(outBytes, codeY);
+			}
+		}
+
+		const uint8_t* blockStateBytes = reinterpret_cast<const uint8_t*>(snapshot.blockStates.data());
+		outBytes.insert(outBytes.end(), blockStateBytes, blockStateBytes + snapshot.blockStates.size() * sizeof(ELatticeBlockState));
+		const uint8_t* boundBytes = reinterpret_cast<const uint8_t*>(snapshot.blockDistanceBounds.data());
+		outBytes.insert(outBytes.end(), boundBytes, boundBytes + snapshot.blockDistanceBounds.size() * sizeof(float));
+		return true;
+	}
+
+	bool DecodeLattice(const std::vector<uint8_t>& bytes, const int pointsPerAxis, LatticeSnapshot& outSnapshot)
+	{
+		ByteReader reader(bytes.data(), bytes.size());
+		uint32_t pointCount, blockCount, boundCount;
+		float distanceStep;
+		if (!reader.Read(pointCount) || !reader.Read(blockCount) || !reader.Read(boundCount) || !reader.Read(distanceStep)
+			|| pointCount != static_cast<size_t>(pointsPerAxis) * pointsPerAxis * pointsPerAxis)
+			return false;
+
+		const uint8_t* codePlanes = reader.TakeBytes(static_cast<size_t>(pointCount) * 2);
+		if (!codePlanes)
+			return false;
+
+		std::vector<int16_t> distanceCodes(pointCount);
+		uint16_t distanceCode = 0;
+		for (size_t pointIndex = 0; pointIndex < pointCount; ++pointIndex)
+		{
+			distanceCode = static_cast<uint16_t>(distanceCode + (codePlanes[pointIndex] | (codePlanes[pointCount + pointIndex] << 8)));
+			distanceCodes[pointIndex] = static_cast<int16_t>(distanceCode);
+		}
+
+		std::vector<uint8_t> isExact;
+		FindExactPoints(distanceCodes, pointsPerAxis, isExact);
+
+		//Sizes are checked once, the points are then read without checking every value
+		const size_t exactCount = static_cast<size_t>(std::count(isExact.begin(), isExact.end(), 1));
+		const size_t exactPointSize = sizeof(float) + sizeof(glm::vec3);
+		const size_t encodedPointSize = 2 * sizeof(int16_t);
+		const uint8_t* pointBytes = reader.TakeBytes(exactCount * exactPointSize + (pointCount - exactCount) * encodedPointSize);
+		if (!pointBytes)
+			return false;
+
+		outSnapshot.distances.resize(pointCount);
+		outSnapshot.normals.resize(pointCount);
+		for (size_t pointIndex = 0; pointIndex < pointCount; ++pointIndex)
+		{
+			if (isExact[pointIndex])
+			{
+				std::memcpy(&outSnapshot.distances[pointIndex], pointBytes, sizeof(float));
+				std::memcpy(&outSnapshot.normals[pointIndex], pointBytes + sizeof(float), sizeof(glm::vec3));
+				pointBytes += exactPointSize;
+			}
+			else
+			{
+				int16_t normalCode[2];
+				std::memcpy(normalCode, pointBytes, encodedPointSize);
+				outSnapshot.distances[pointIndex] = distanceCodes[pointIndex] * distanceStep;
+				outSnapshot.normals[pointIndex] = DecodeOctahedral(normalCode[0], normalCode[1]);
+				pointBytes += encodedPointSize;
+			}
+		}
+
+		outSnapshot.blockStates.resize(blockCount);
+		outSnapshot.blockDistanceBounds.resize(boundCount);
+		return reader.ReadBytes(outSnapshot.blockStates.data(), blockCount * sizeof(ELatticeBlockState))
+			&& reader.ReadBytes(outSnapshot.blockDistanceBounds.data(), boundCount * sizeof(float)) && reader.IsAtEnd();
+	}
+}
+
+const uint32_t VoxelWorldFile::Version;
+
+VoxelWorldFile::~VoxelWorldFile()
+{
+	Close();
+}
+
+bool VoxelWorldFile::Create(const std::string& path, const VoxelWorldLayout& layout, const uint64_t sdfFingerprint)
+{
+	Close();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_file.is_open())
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << path << ")::ERROR::FILE_NOT_CREATED" << '\n';
+		return false;
+	}
+
+	m_path = path;
+	m_layout = layout;
+	m_sdfFingerprint = sdfFingerprint;
+	m_fileEnd = HeaderSize;
+	m_flushedExtent = FreeExtent();
+	m_bIsDirty = true;
+	return true;
+}
+
+bool VoxelWorldFile::Open(const std::string& path, const VoxelWorldLayout& layout, const uint64_t sdfFingerprint)
+{
+	Close();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+	if (!m_file.is_open())
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << path << ")::ERROR::FILE_NOT_SUCCESFULLY_READ" << '\n';
+		return false;
+	}
+
+	m_path = path;
+	if (!ReadHeaderAndDirectory(layout, sdfFingerprint))
+	{
+		m_file.close();
+		m_path.clear();
+		m_directory.clear();
+		m_brushStrokes.clear();
+		return false;
+	}
+	return true;
+}
+
+void VoxelWorldFile::Close()
+{
+	if (!IsOpen())
+		return;
+
+	Flush();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_file.close();
+	m_path.clear();
+	m_directory.clear();
+	m_freeExtents.clear();
+	m_brushStrokes.clear();
+	m_fileEnd = 0;
+	m_bIsDirty = false;
+}
+
+bool VoxelWorldFile::IsOpen() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_file.is_open();
+}
+
+bool VoxelWorldFile::Flush()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_file.is_open() || !m_bIsDirty)
+		return true;
+
+	std::vector<uint8_t> directoryBytes;
+	for (const auto& directoryEntry : m_directory)
+	{
+		const ChunkKey& key = directoryEntry.first;
+		const DirectoryEntry& entry = directoryEntry.second;
+		AppendValue(directoryBytes, static_cast<int32_t>(key.coord.x));
+		AppendValue(directoryBytes, static_cast<int32_t>(key.coord.y));
+		AppendValue(directoryBytes, static_cast<int32_t>(key.coord.z));
+		AppendValue(directoryBytes, static_cast<int32_t>(key.lodLevel));
+		AppendValue(directoryBytes, entry.offset);
+		AppendValue(directoryBytes, entry.storedSize);
+		AppendValue(directoryBytes, entry.capacity);
+		AppendValue(directoryBytes, entry.rawSize);
+		AppendValue(directoryBytes, entry.checksum);
+		AppendValue(directoryBytes, entry.strokeCount);
+	}
+
+	std::vector<uint8_t> strokeBytes;
+	for (const BrushStroke& stroke : m_brushStrokes)
+	{
+		AppendValue(strokeBytes, stroke.sphereRadius);
+		AppendValue(strokeBytes, stroke.sphereCenter);
+		AppendValue(strokeBytes, static_cast<int32_t>(stroke.brushType));
+	}
+
+	//Appended after everything else, the header still points to the previous directory until it is rewritten
+	const uint64_t directoryOffset = m_fileEnd;
+	const uint64_t strokesOffset = directoryOffset + directoryBytes.size();
+	m_file.seekp(static_cast<std::streamoff>(directoryOffset));
+	m_file.write(reinterpret_cast<const char*>(directoryBytes.data()), directoryBytes.size());
+	m_file.write(reinterpret_cast<const char*>(strokeBytes.data()), strokeBytes.size());
+	m_fileEnd = strokesOffset + strokeBytes.size();
+
+	std::vector<uint8_t> headerBytes(FileMagic, FileMagic + 4);
+	AppendValue(headerBytes, Version);
+	AppendValue(headerBytes, static_cast<int32_t>(m_layout.chunkVoxelCount));
+	AppendValue(headerBytes, static_cast<int32_t>(m_layout.gridVoxelCount));
+	AppendValue(headerBytes, m_layout.voxelSize);
+	AppendValue(headerBytes, m_layout.worldOrigin);
+	AppendValue(headerBytes, m_sdfFingerprint);
+	AppendValue(headerBytes, directoryOffset);
+	AppendValue(headerBytes, static_cast<uint32_t>(m_directory.size()));
+	AppendValue(headerBytes, CalculateChecksum(directoryBytes));
+	AppendValue(headerBytes, strokesOffset);
+	AppendValue(headerBytes, static_cast<uint32_t>(m_brushStrokes.size()));
+	AppendValue(headerBytes, CalculateChecksum(strokeBytes));
+	AppendValue(headerBytes, CalculateChecksum(headerBytes));
+
+	m_file.seekp(0);
+	m_file.write(reinterpret_cast<const char*>(headerBytes.data()), headerBytes.size());
+	m_file.flush();
+
+	if (!m_file)
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << m_path << ")::ERROR::FILE_NOT_WRITTEN" << '\n';
+		m_file.clear();
+		return false;
+	}
+
+	//Nothing points to the previous directory any more
+	if (m_flushedExtent.capacity > 0)
+		m_freeExtents.push_back(m_flushedExtent);
+	m_flushedExtent = FreeExtent{ directoryOffset, static_cast<uint32_t>(m_fileEnd - directoryOffset) };
+
+	m_bIsDirty = false;
+	return true;
+}
+
+bool VoxelWorldFile::HasChunk(const ChunkKey& key) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_directory.find(key) != m_directory.end();
+}
+
+std::vector<VoxelChunkInfo> VoxelWorldFile::GetChunks() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<VoxelChunkInfo> chunks;
+	chunks.reserve(m_directory.size());
+	for (const auto& directoryEntry : m_directory)
+		chunks.push_back(VoxelChunkInfo{ directoryEntry.first, directoryEntry.second.strokeCount });
+	return chunks;
+}
+
+bool VoxelWorldFile::WriteChunk(const ChunkKey& key, const LatticeSnapshot& snapshot, const size_t strokeCount)
+{
+	//Encoded and compressed before taking the lock, so readers of other chunks don't wait for it
+	const float distanceStep = m_layout.voxelSize * static_cast<float>(1 << key.lodLevel) / DistanceStepsPerVoxel;
+	std::vector<uint8_t> rawBytes;
+	if (!EncodeLattice(snapshot, m_layout.gridVoxelCount + 1, distanceStep, rawBytes))
+		return false;
+
+	std::vector<uint8_t> payload;
+	Compress(rawBytes, payload);
+
+	DirectoryEntry entry;
+	entry.rawSize = static_cast<uint32_t>(rawBytes.size());
+	entry.checksum = CalculateChecksum(payload);
+	entry.strokeCount = static_cast<uint32_t>(strokeCount);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return WritePayload(key, payload, entry);
+}
+
+bool VoxelWorldFile::ReadChunk(const ChunkKey& key, LatticeSnapshot& outSnapshot, size_t& outStrokeCount) const
+{
+	std::vector<uint8_t> payload;
+	DirectoryEntry entry;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!ReadPayload(key, payload, entry))
+			return false;
+	}
+
+	//Decompressed without holding the lock, chunks are decoded in parallel
+	std::vector<uint8_t> rawBytes;
+	if (!Decompress(payload, entry.rawSize, rawBytes) || !DecodeLattice(rawBytes, m_layout.gridVoxelCount + 1, outSnapshot))
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << m_path << ")::ERROR::CHUNK_NOT_DECODED" << '\n';
+		return false;
+	}
+
+	outStrokeCount = entry.strokeCount;
+	return true;
+}
+
+bool VoxelWorldFile::CopyChunk(const VoxelWorldFile& sourceFile, const ChunkKey& key)
+{
+	std::vector<uint8_t> payload;
+	DirectoryEntry entry;
+	{
+		std::lock_guard<std::mutex> lock(sourceFile.m_mutex);
+		if (!sourceFile.ReadPayload(key, payload, entry))
+			return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return WritePayload(key, payload, entry);
+}
+
+void VoxelWorldFile::RemoveChunk(const ChunkKey& key)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const auto directoryEntry = m_directory.find(key);
+	if (directoryEntry == m_directory.end())
+		return;
+
+	FreeEntry(directoryEntry->second);
+	m_directory.erase(directoryEntry);
+	m_bIsDirty = true;
+}
+
+void VoxelWorldFile::SetBrushStrokes(const std::vector<BrushStroke>& brushStrokes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_brushStrokes = brushStrokes;
+	m_bIsDirty = true;
+}
+
+std::vector<BrushStroke> VoxelWorldFile::GetBrushStrokes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_brushStrokes;
+}
+
+bool VoxelWorldFile::ReadPayload(const ChunkKey& key, std::vector<uint8_t>& outPayload, DirectoryEntry& outEntry) const
+{
+	const auto directoryEntry = m_directory.find(key);
+	if (directoryEntry == m_directory.end() || !m_file.is_open())
+		return false;
+
+	outEntry = directoryEntry->second;
+	outPayload.resize(outEntry.storedSize);
+	m_file.seekg(static_cast<std::streamoff>(outEntry.offset));
+	m_file.read(reinterpret_cast<char*>(outPayload.data()), outPayload.size());
+
+	if (!m_file)
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << m_path << ")::ERROR::FILE_NOT_SUCCESFULLY_READ" << '\n';
+		m_file.clear();
+		return false;
+	}
+	if (CalculateChecksum(outPayload) != outEntry.checksum)
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << m_path << ")::ERROR::CHUNK_CHECKSUM_MISMATCH" << '\n';
+		return false;
+	}
+	return true;
+}
+
+bool VoxelWorldFile::WritePayload(const ChunkKey& key, const std::vector<uint8_t>& payload, DirectoryEntry entry)
+{
+	if (!m_file.is_open())
+		return false;
+
+	entry.storedSize = static_cast<uint32_t>(payload.size());
+
+	const auto directoryEntry = m_directory.find(key);
+	if (directoryEntry != m_directory.end() && directoryEntry->second.capacity >= entry.storedSize)
+	{
+		//Still fits the extent it had
+		entry.offset = directoryEntry->second.offset;
+		entry.capacity = directoryEntry->second.capacity;
+	}
+	else
+	{
+		if (directoryEntry != m_directory.end())
+			FreeEntry(directoryEntry->second);
+
+		//First freed extent it fits in, otherwise the end of the file
+		const auto freeExtent = std::find_if(m_freeExtents.begin(), m_freeExtents.end(), [&](const FreeExtent& extent) { return extent.capacity >= entry.storedSize; });
+		if (freeExtent != m_freeExtents.end())
+		{
+			entry.offset = freeExtent->offset;
+			entry.capacity = freeExtent->capacity;
+			m_freeExtents.erase(freeExtent);
+		}
+		else
+		{
+			entry.offset = m_fileEnd;
+			entry.capacity = entry.storedSize;
+			m_fileEnd += entry.storedSize;
+		}
+	}
+
+	m_file.seekp(static_cast<std::streamoff>(entry.offset));
+	m_file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+	m_bIsDirty = true;
+
+	if (!m_file)
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << m_path << ")::ERROR::FILE_NOT_WRITTEN" << '\n';
+		m_file.clear();
+		//The extent may hold part of the payload, it is no longer used by anything
+		FreeEntry(entry);
+		m_directory.erase(key);
+		return false;
+	}
+
+	m_directory[key] = entry;
+	return true;
+}
+
+void VoxelWorldFile::FreeEntry(const DirectoryEntry& entry)
+{
+	m_freeExtents.push_back(FreeExtent{ entry.offset, entry.capacity });
+}
+
+bool VoxelWorldFile::ReadHeaderAndDirectory(const VoxelWorldLayout& layout, const uint64_t sdfFingerprint)
+{
+	std::vector<uint8_t> headerBytes(HeaderSize);
+	m_file.seekg(0);
+	m_file.read(reinterpret_cast<char*>(headerBytes.data()), headerBytes.size());
+
+	ByteReader header(headerBytes.data(), headerBytes.size());
+	char magic[4] = {};
+	uint32_t version = 0;
+	int32_t chunkVoxelCount = 0, gridVoxelCount = 0;
+	uint64_t fileSDFFingerprint = 0, directoryOffset = 0, strokesOffset = 0;
+	uint32_t directoryCount = 0, directoryChecksum = 0, strokeCount = 0, strokesChecksum = 0, headerChecksum = 0;
+	VoxelWorldLayout fileLayout;
+
+	const bool bIsHeaderRead = m_file && header.ReadBytes(magic, 4) && header.Read(version) && header.Read(chunkVoxelCount) && header.Read(gridVoxelCount)
+		&& header.Read(fileLayout.voxelSize) && header.Read(fileLayout.worldOrigin) && header.Read(fileSDFFingerprint) && header.Read(directoryOffset) && header.Read(directoryCount)
+		&& header.Read(directoryChecksum) && header.Read(strokesOffset) && header.Read(strokeCount) && header.Read(strokesChecksum) && header.Read(headerChecksum);
+	//Checked before the checksum, the header of another version has another size
+	if (bIsHeaderRead && std::memcmp(magic, FileMagic, 4) == 0 && version != Version)
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << m_path << ")::ERROR::UNSUPPORTED_VERSION: " << version << '\n';
+		return false;
+	}
+	if (!bIsHeaderRead || std::memcmp(magic, FileMagic, 4) != 0 || headerChecksum != CalculateChecksum(headerBytes.data(), HeaderSize - sizeof(uint32_t)))
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << m_path << ")::ERROR::NOT_A_VOXEL_WORLD_FILE" << '\n';
+		return false;
+	}
+
+	fileLayout.chunkVoxelCount = chunkVoxelCount;
+	fileLayout.gridVoxelCount = gridVoxelCount;
+	if (fileLayout != layout)
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << m_path << ")::ERROR::LAYOUT_MISMATCH" << '\n';
+		return false;
+	}
+	//Lattices sampled from another SDF don't continue the surface of the chunks sampled from this one
+	if (fileSDFFingerprint != sdfFingerprint)
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << m_path << ")::ERROR::SDF_MISMATCH" << '\n';
+		return false;
+	}
+	m_layout = layout;
+	m_sdfFingerprint = sdfFingerprint;
+
+	//Key, offset, stored size, capacity, raw size, checksum, stroke count
+	const size_t directoryEntrySize = 4 * sizeof(int32_t) + sizeof(uint64_t) + 5 * sizeof(uint32_t);
+	//Radius, center, brush type
+	const size_t strokeSize = 4 * sizeof(float) + sizeof(int32_t);
+	std::vector<uint8_t> directoryBytes(directoryCount * directoryEntrySize);
+	std::vector<uint8_t> strokeBytes(strokeCount * strokeSize);
+	m_file.seekg(static_cast<std::streamoff>(directoryOffset));
+	m_file.read(reinterpret_cast<char*>(directoryBytes.data()), directoryBytes.size());
+	m_file.seekg(static_cast<std::streamoff>(strokesOffset));
+	m_file.read(reinterpret_cast<char*>(strokeBytes.data()), strokeBytes.size());
+	if (!m_file || CalculateChecksum(directoryBytes) != directoryChecksum || CalculateChecksum(strokeBytes) != strokesChecksum)
+	{
+		std::cout << "VOXEL_WORLD_FILE(" << m_path << ")::ERROR::DIRECTORY_CHECKSUM_MISMATCH" << '\n';
+		m_file.clear();
+		return false;
+	}
+
+	m_directory.clear();
+	ByteReader directory(directoryBytes.data(), directoryBytes.size());
+	for (uint32_t entryIndex = 0; entryIndex < directoryCount; ++entryIndex)
+	{
+		ChunkKey key;
+		DirectoryEntry entry;
+		directory.Read(key.coord.x);
+		directory.Read(key.coord.y);
+		directory.Read(key.coord.z);
+		directory.Read(key.lodLevel);
+		directory.Read(entry.offset);
+		directory.Read(entry.storedSize);
+		directory.Read(entry.capacity);
+		directory.Read(entry.rawSize);
+		directory.Read(entry.checksum);
+		directory.Read(entry.strokeCount);
+		m_directory[key] = entry;
+	}
+
+	m_brushStrokes.resize(strokeCount);
+	ByteReader strokes(strokeBytes.data(), strokeBytes.size());
+	for (BrushStroke& stroke : m_brushStrokes)
+	{
+		int32_t brushType = 0;
+		strokes.Read(stroke.sphereRadius);
+		strokes.Read(stroke.sphereCenter);
+		strokes.Read(brushType);
+		stroke.brushType = static_cast<EBrushType>(brushType);
+	}
+
+	//Appends go after everything, space that was already unused when the file was closed isn't tracked
+	m_file.seekg(0, std::ios::end);
+	m_fileEnd = static_cast<uint64_t>(m_file.tellg());
+	m_freeExtents.clear();
+	m_flushedExtent = FreeExtent{ directoryOffset, static_cast<uint32_t>(directoryBytes.size() + strokeBytes.size()) };
+	m_bIsDirty = false;
+	return true;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "DualContouring.h"
+#include "TerrainChunkManager.h"
+
+//Chunk tiling a file was written for, chunks only fit a grid of the same layout
+struct VoxelWorldLayout
+{
+	int chunkVoxelCount = 0;
+	//Voxels per axis of a chunk's grid, the chunk and its margins
+	int gridVoxelCount = 0;
+	float voxelSize = 0.f;
+	glm::vec3 worldOrigin = glm::vec3(0.f);
+
+	bool operator==(const VoxelWorldLayout& other) const
+	{
+		return chunkVoxelCount == other.chunkVoxelCount && gridVoxelCount == other.gridVoxelCount && voxelSize == other.voxelSize && worldOrigin == other.worldOrigin;
+	}
+	bool operator!=(const VoxelWorldLayout& other) const { return !(*this == other); }
+};
+
+//Chunk stored in a file and how many strokes of the file's stroke log its lattice already contains
+struct VoxelChunkInfo
+{
+	ChunkKey key;
+	size_t strokeCount = 0;
+};
+
+//Binary file of chunk lattices with random access to single chunks.
+//A fixed header names the layout and the SDF the lattices were sampled from, and points to a directory of the stored
+//chunks and to the brush stroke log. Each chunk's lattice is stored as
+//its own payload anywhere in the file, so a chunk is read or rewritten without touching the others: a payload that
+//still fits its old place is overwritten in place, otherwise it moves to a freed or appended extent. The directory and
+//stroke log are appended by Flush and the header is rewritten last, so the file stays readable if the process stops
+//between two flushes. Chunks rewritten since the last flush then fail their checksum rather than returning wrong data.
+//Distances within a few voxels of the surface or on a lattice edge it crosses are kept exactly, the faces and vertices
+//of a chunk only read those, so a chunk read back meshes the same as before. Farther distances are quantized to 1/256
+//voxel and their normals are octahedron encoded, a soft brush that later pulls them onto the surface sees them that
+//precisely. The payload is then LZ compressed and guarded by a CRC-32 checksum.
+//Numbers are stored little-endian, like the hosts the app runs on. Any thread may read chunks while another writes them.
+class VoxelWorldFile
+{
+public:
+	static const uint32_t Version = 2;
+
+	VoxelWorldFile() = default;
+	//Flushes the file if it is open
+	~VoxelWorldFile();
+
+	VoxelWorldFile(const VoxelWorldFile&) = delete;
+	VoxelWorldFile& operator=(const VoxelWorldFile&) = delete;
+
+	//Creates an empty file, replacing any existing one. The fingerprint (see USDFComponent::CalculateFingerprint) names
+	//the SDF the lattices are sampled from.
+	bool Create(const std::string& path, const VoxelWorldLayout& layout, const uint64_t sdfFingerprint);
+	//Opens an existing file for reading and writing. Returns false if it is missing, damaged, of another version, or
+	//written for another layout or SDF.
+	bool Open(const std::string& path, const VoxelWorldLayout& layout, const uint64_t sdfFingerprint);
+	//Flushes and closes the file
+	void Close();
+	bool IsOpen() const;
+	const std::string& GetPath() const { return m_path; }
+	uint64_t GetSDFFingerprint() const { return m_sdfFingerprint; }
+	//Writes the directory and stroke log if they changed, so the file can be opened again
+	bool Flush();
+
+	bool HasChunk(const ChunkKey& key) const;
+	std::vector<VoxelChunkInfo> GetChunks() const;
+	//Compresses and stores a chunk's lattice, replacing the chunk if it is already stored
+	bool WriteChunk(const ChunkKey& key, const LatticeSnapshot& snapshot, const size_t strokeCount);
+	//Reads and decompresses a chunk's lattice, returns false if it isn't stored or its checksum doesn't match
+	bool ReadChunk(const ChunkKey& key, LatticeSnapshot& outSnapshot, size_t& outStrokeCount) const;
+	//Stores a chunk of another file of the same layout, copying its compressed payload as it is
+	bool CopyChunk(const VoxelWorldFile& sourceFile, const ChunkKey& key);
+	//Forgets a chunk, its extent is reused by later writes
+	void RemoveChunk(const ChunkKey& key);
+
+	//Brush strokes the chunks' stroke counts refer to, written by the next flush
+	void SetBrushStrokes(const std::vector<BrushStroke>& brushStrokes);
+	std::vector<BrushStroke> GetBrushStrokes() const;
+
+private:
+	struct DirectoryEntry
+	{
+		uint64_t offset = 0;
+		//Bytes of the compressed payload and of the extent reserved for it
+		uint32_t storedSize = 0;
+		uint32_t capacity = 0;
+		//Bytes of the payload once decompressed
+		uint32_t rawSize = 0;
+		uint32_t checksum = 0;
+		uint32_t strokeCount = 0;
+	};
+
+	//Extent of the file no payload uses any more
+	struct FreeExtent
+	{
+		uint64_t offset = 0;
+		uint32_t capacity = 0;
+	};
+
+	//Reads a chunk's compressed payload. Expects m_mutex to be held.
+	bool ReadPayload(const ChunkKey& key, std::vector<uint8_t>& outPayload, DirectoryEntry& outEntry) const;
+	//Stores a compressed payload in place, in a free extent or at the end of the file. Expects m_mutex to be held.
+	bool WritePayload(const ChunkKey& key, const std::vector<uint8_t>& payload, DirectoryEntry entry);
+	//Expects m_mutex to be held
+	void FreeEntry(const DirectoryEntry& entry);
+	bool ReadHeaderAndDirectory(const VoxelWorldLayout& layout, const uint64_t sdfFingerprint);
+
+private:
+	std::string m_path;
+	VoxelWorldLayout m_layout;
+	uint64_t m_sdfFingerprint = 0;
+
+	//Guards the stream and everything below
+	mutable std::mutex m_mutex;
+	mutable std::fstream m_file;
+	std::unordered_map<ChunkKey, DirectoryEntry, ChunkKeyHash> m_directory;
+	std::vector<FreeExtent> m_freeExtents;
+	std::vector<BrushStroke> m_brushStrokes;
+	//End of everything written so far, appends never overwrite the last flushed directory
+	uint64_t m_fileEnd = 0;
+	//Directory and stroke log the header points to, freed once a flush wrote newer ones
+	FreeExtent m_flushedExtent;
+	bool m_bIsDirty = false;
+};